@@ -10,8 +10,12 @@ public:
   virtual int AddRef() =0;
   virtual int Release() =0;
   virtual int GetRefCt() = 0;
+  // make the object and the objects it holds safe to share between
+  // threads, see local_base
+  virtual void publish() = 0;
 };
 
+// both return the new value
 #if defined(_WINDOWS_)
 
 #define atomic_increment(p) InterlockedIncrement(p)
@@ -19,8 +23,8 @@ public:
   
 #elif defined(_MAC_) || defined(__linux__)
 
-#define atomic_increment(p) __sync_fetch_and_add(p, 1)
-#define atomic_decrement(p) __sync_fetch_and_sub(p, 1)
+#define atomic_increment(p) __sync_add_and_fetch(p, 1)
+#define atomic_decrement(p) __sync_sub_and_fetch(p, 1)
   
 #endif
 
@@ -83,6 +87,7 @@ private:
   critical_section* m_cs;
 };
 
+// atomic reference count, objects that need a lock carry their own
 template <class ClassName>
 class threadsafe_base : public ClassName
 {
@@ -110,12 +115,109 @@ public:
 
   virtual int GetRefCt() { return m_dwRef; }
 
-  void Lock() { m_critsec.lock(); }
-  void Unlock() { m_critsec.unlock(); }
+  // always shared
+  virtual void publish() {}
 
 protected:
   long m_dwRef;
-  critical_section m_critsec;
+};
+
+// debug builds check that unpublished objects stay on their thread
+#if defined(_DEBUG) && !defined(SINET_CHECK_PUBLISH)
+#define SINET_CHECK_PUBLISH
+#endif
+
+#ifdef SINET_CHECK_PUBLISH
+#include <stdlib.h>
+#if defined(_WINDOWS_)
+typedef DWORD thread_id;
+inline thread_id current_thread_id() { return ::GetCurrentThreadId(); }
+inline int same_thread(thread_id a, thread_id b) { return a == b; }
+#elif defined(_MAC_) || defined(__linux__)
+typedef pthread_t thread_id;
+inline thread_id current_thread_id() { return pthread_self(); }
+inline int same_thread(thread_id a, thread_id b) { return pthread_equal(a, b); }
+#endif
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  local_base class
+//
+//    Reference count with plain increments while the object belongs to
+//    the thread that built it, atomic ones once publish() was called.
+//    Requests, tasks, post data and configs are built this way, the
+//    pool publishes a task with everything it holds in execute(), and
+//    a published object publishes what is attached to it later.
+//
+//    An object handed to another thread by other means must be
+//    published first. With SINET_CHECK_PUBLISH (on in _DEBUG builds)
+//    touching the count of an unpublished object from another thread
+//    aborts.
+//
+template <class ClassName>
+class local_base : public ClassName
+{
+public:
+  local_base()
+  {
+    m_dwRef = 0L;
+    m_published = 0;
+#ifdef SINET_CHECK_PUBLISH
+    m_owner = current_thread_id();
+#endif
+  }
+  virtual ~local_base()
+  {
+  }
+
+  virtual int AddRef()
+  {
+    if (m_published)
+      return atomic_increment(&m_dwRef);
+    _check_owner();
+    return ++m_dwRef;
+  }
+
+  virtual int Release()
+  {
+    int retval;
+    if (m_published)
+      retval = atomic_decrement(&m_dwRef);
+    else
+    {
+      _check_owner();
+      retval = --m_dwRef;
+    }
+    if(retval == 0)
+      delete this;
+    return retval;
+  }
+
+  virtual int GetRefCt() { return m_dwRef; }
+
+  // the caller hands the object over with a lock or another barrier,
+  // so the flag needs none
+  virtual void publish() { m_published = 1; }
+
+protected:
+  int is_published() const { return m_published; }
+
+  long m_dwRef;
+
+private:
+  void _check_owner()
+  {
+#ifdef SINET_CHECK_PUBLISH
+    if (!same_thread(m_owner, current_thread_id()))
+      abort();
+#endif
+  }
+
+  int m_published;
+#ifdef SINET_CHECK_PUBLISH
+  thread_id m_owner;
+#endif
 };
 
 } // namespace sinet
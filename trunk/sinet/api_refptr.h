@@ -4,6 +4,10 @@
 namespace sinet
 {
 
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#define SINET_HAS_RVALUE_REFERENCES
+#endif
+
 template <class T>
 class refptr
 {
@@ -23,6 +27,13 @@ public:
       ptr_->AddRef();
   }
 
+#ifdef SINET_HAS_RVALUE_REFERENCES
+  // moving hands the reference over without touching the count
+  refptr(refptr<T>&& r) : ptr_(r.ptr_) {
+    r.ptr_ = NULL;
+  }
+#endif
+
   ~refptr() {
     if (ptr_)
       ptr_->Release();
@@ -46,6 +57,19 @@ public:
     return *this = r.ptr_;
   }
 
+#ifdef SINET_HAS_RVALUE_REFERENCES
+  refptr<T>& operator=(refptr<T>&& r) {
+    if (this != &r) {
+      T* p = ptr_;
+      ptr_ = r.ptr_;
+      r.ptr_ = NULL;
+      if (p)
+        p->Release();
+    }
+    return *this;
+  }
+#endif
+
   void swap(T** pp) {
     T* p = ptr_;
     ptr_ = *pp;
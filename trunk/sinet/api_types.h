@@ -13,6 +13,7 @@ enum postdataelem_type_t
 };
 
 typedef std::map<std::wstring,std::wstring> si_stringmap;
+typedef std::map<std::string,std::string>   si_stringmap_utf8;
 typedef std::vector<unsigned char>          si_buffer;
 
 }
@@ -9,6 +9,33 @@ namespace sinet
 
 #define CFG_STR_PROXY        1
 #define CFG_STR_AGENT        2
+// pool config only, directory of the disk cache, see pool.h
+#define CFG_STR_CACHE_DIR    3
+
+// integer vars, see pool.h for the defaults of pool limits
+#define CFG_INT_MAX_HOST_CONNECTIONS    1
+#define CFG_INT_MAX_TOTAL_CONNECTIONS   2
+#define CFG_INT_MAX_RUNNING_TASKS       3
+// rate limits, in a pool config they cap the whole pool and in a task
+// config that task only
+#define CFG_INT_MAX_RECV_SPEED          4   // bytes per second
+#define CFG_INT_MAX_SEND_SPEED          5   // bytes per second
+#define CFG_INT_MAX_REQUEST_RATE        6   // requests started per second
+// timeouts in milliseconds, a task config overrides the pool config
+// and a request overrides both, see request::set_timeouts
+#define CFG_INT_REQUEST_TIMEOUT         7   // deadline of each request
+#define CFG_INT_CONNECT_TIMEOUT         8
+#define CFG_INT_FIRST_BYTE_TIMEOUT      9
+#define CFG_INT_LOW_SPEED_LIMIT         10  // bytes per second
+#define CFG_INT_LOW_SPEED_TIME          11  // seconds
+#define CFG_INT_TASK_TIMEOUT            12  // deadline of a whole task
+// pool config only, 1 to let identical GETs running at the same time
+// share one transfer
+#define CFG_INT_COALESCE_GETS           13
+// pool config only, bytes of responses kept in memory, 0 for no cache
+#define CFG_INT_CACHE_SIZE              14
+// pool config only, bytes of bodies kept in CFG_STR_CACHE_DIR
+#define CFG_INT_DISK_CACHE_SIZE         15
 
 class config:
   public base
@@ -20,6 +47,15 @@ public:
   virtual int get_strvar(int id, std::wstring& strvarout) = 0;
   virtual void set_strvar(int id, std::wstring strvarin) = 0;
   virtual int remove_strvar(int id) = 0;
+
+  // UTF-8 string vars, this is the internal storage format
+  virtual int get_strvar_utf8(int id, std::string& strvarout) = 0;
+  virtual void set_strvar_utf8(int id, const std::string& strvarin) = 0;
+
+  // get / set / remove integer vars
+  virtual int get_intvar(int id, int& intvarout) = 0;
+  virtual void set_intvar(int id, int intvarin) = 0;
+  virtual int remove_intvar(int id) = 0;
 };
 
 } // namespace sinet
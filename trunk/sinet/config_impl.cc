@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "config_impl.h"
+#include "strings.h"
 
 using namespace sinet;
 
@@ -12,7 +13,22 @@ refptr<config> config::create_instance()
 
 int config_impl::get_strvar(int id, std::wstring& strvarout)
 {
-  std::map<int, std::wstring>::iterator it = m_strvar.find(id);
+  std::string strvar;
+  if (!get_strvar_utf8(id, strvar))
+    return 0;
+  strvarout = strings::utf8string_wstring(strvar);
+  return 1;
+}
+
+void config_impl::set_strvar(int id, std::wstring strvarin)
+{
+  set_strvar_utf8(id, strings::wstring_utf8string(strvarin));
+}
+
+int config_impl::get_strvar_utf8(int id, std::string& strvarout)
+{
+  auto_criticalsection acs(m_csconfig);
+  std::map<int, std::string>::iterator it = m_strvar.find(id);
   if (it != m_strvar.end())
   {
     strvarout = it->second;
@@ -21,20 +37,38 @@ int config_impl::get_strvar(int id, std::wstring& strvarout)
   return 0;
 }
 
-void config_impl::set_strvar(int id, std::wstring strvarin)
+void config_impl::set_strvar_utf8(int id, const std::string& strvarin)
 {
   auto_criticalsection acs(m_csconfig);
   m_strvar[id] = strvarin;
 }
 
-int config_impl::remove_strvar(int id)
+int config_impl::get_intvar(int id, int& intvarout)
 {
-  std::map<int, std::wstring>::iterator it = m_strvar.find(id);
-  if (it != m_strvar.end())
+  auto_criticalsection acs(m_csconfig);
+  std::map<int, int>::iterator it = m_intvar.find(id);
+  if (it != m_intvar.end())
   {
-    auto_criticalsection acs(m_csconfig);
-    m_strvar.erase(it);
+    intvarout = it->second;
     return 1;
   }
   return 0;
+}
+
+void config_impl::set_intvar(int id, int intvarin)
+{
+  auto_criticalsection acs(m_csconfig);
+  m_intvar[id] = intvarin;
+}
+
+int config_impl::remove_intvar(int id)
+{
+  auto_criticalsection acs(m_csconfig);
+  return m_intvar.erase(id) ? 1 : 0;
+}
+
+int config_impl::remove_strvar(int id)
+{
+  auto_criticalsection acs(m_csconfig);
+  return m_strvar.erase(id) ? 1 : 0;
 }
\ No newline at end of file
@@ -7,16 +7,24 @@ namespace sinet
 {
 
 class config_impl:
-  public threadsafe_base<config>
+  public local_base<config>
 {
 public:
   virtual int get_strvar(int id, std::wstring& strvarout);
   virtual void set_strvar(int id, std::wstring strvarin);
   virtual int remove_strvar(int id);
 
+  virtual int get_strvar_utf8(int id, std::string& strvarout);
+  virtual void set_strvar_utf8(int id, const std::string& strvarin);
+
+  virtual int get_intvar(int id, int& intvarout);
+  virtual void set_intvar(int id, int intvarin);
+  virtual int remove_intvar(int id);
+
 private:
   critical_section            m_csconfig;
-  std::map<int, std::wstring> m_strvar;
+  std::map<int, std::string>  m_strvar;
+  std::map<int, int>          m_intvar;
 };
 
 } // namespace sinet
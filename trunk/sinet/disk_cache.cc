@@ -0,0 +1,631 @@
+#include "pch.h"
+#include "disk_cache.h"
+#include "http_cache.h"
+#include "strings.h"
+#include <stdio.h>
+#include <ctype.h>
+#if defined(_WINDOWS_)
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+using namespace sinet;
+
+#define INDEX_MAGIC     "SICI"
+#define INDEX_VERSION   1
+#define META_MAGIC      "sinet-meta 1"
+
+#define FNV_OFFSET      14695981039346656037ULL
+#define FNV_PRIME       1099511628211ULL
+
+static unsigned long long fnv1a(const void* data, size_t size,
+                                unsigned long long hash = FNV_OFFSET)
+{
+  const unsigned char* p = (const unsigned char*)data;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= p[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// header names compare without case
+static int same_name(const std::string& a, const std::string& b)
+{
+  if (a.length() != b.length())
+    return 0;
+  for (size_t i = 0; i < a.length(); i++)
+    if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+      return 0;
+  return 1;
+}
+
+static FILE* open_file(const std::string& path, const char* mode)
+{
+#if defined(_WINDOWS_)
+  return ::_wfopen(strings::utf8string_wstring(path).c_str(),
+                   strings::utf8string_wstring(mode).c_str());
+#else
+  return ::fopen(path.c_str(), mode);
+#endif
+}
+
+static void remove_file(const std::string& path)
+{
+#if defined(_WINDOWS_)
+  ::_wremove(strings::utf8string_wstring(path).c_str());
+#else
+  ::remove(path.c_str());
+#endif
+}
+
+// move |from| over |to|, so readers never see a half written file
+static int replace_file(const std::string& from, const std::string& to)
+{
+#if defined(_WINDOWS_)
+  return ::MoveFileExW(strings::utf8string_wstring(from).c_str(),
+                       strings::utf8string_wstring(to).c_str(),
+                       MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return ::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static int make_directory(const std::string& path)
+{
+#if defined(_WINDOWS_)
+  std::wstring wpath = strings::utf8string_wstring(path);
+  ::_wmkdir(wpath.c_str());
+  DWORD attributes = ::GetFileAttributesW(wpath.c_str());
+  return attributes != INVALID_FILE_ATTRIBUTES &&
+    (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+  ::mkdir(path.c_str(), 0755);
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+// @returns 1 if the body file |path| holds the bytes of |body|, or of
+//          the file |other| when |body| is NULL. Equal hashes do not
+//          make equal bodies.
+static int same_body(const std::string& path, const si_buffer* body,
+                     const std::string& other)
+{
+  FILE* in = open_file(path, "rb");
+  if (!in)
+    return 0;
+  FILE* in_other = body ? NULL : open_file(other, "rb");
+  if (!body && !in_other)
+  {
+    fclose(in);
+    return 0;
+  }
+  char chunk[16384], chunk_other[16384];
+  size_t offset = 0, read;
+  int same = 1;
+  do
+  {
+    read = fread(chunk, 1, sizeof(chunk), in);
+    if (body)
+    {
+      size_t left = body->size() - offset;
+      same = read == (left < sizeof(chunk) ? left : sizeof(chunk)) &&
+        (read == 0 || memcmp(chunk, &(*body)[offset], read) == 0);
+    }
+    else
+      same = read == fread(chunk_other, 1, sizeof(chunk_other), in_other) &&
+        memcmp(chunk, chunk_other, read) == 0;
+    offset += read;
+  } while (same && read > 0);
+  same = same && !ferror(in) && !(in_other && ferror(in_other));
+  fclose(in);
+  if (in_other)
+    fclose(in_other);
+  return same;
+}
+
+// metadata strings are written as their length and bytes, header values
+// keep the line breaks curl hands over
+static void write_string(FILE* file, const std::string& s)
+{
+  fprintf(file, "%lu\n", (unsigned long)s.length());
+  fwrite(s.data(), 1, s.length(), file);
+}
+
+// |size| is the size of the file, a longer string means it is corrupt
+static int read_string(FILE* file, long size, std::string& s)
+{
+  unsigned long length;
+  if (fscanf(file, "%lu", &length) != 1 || fgetc(file) != '\n')
+    return 0;
+  long pos = ftell(file);
+  if (pos < 0 || pos > size || length > (unsigned long)(size - pos))
+    return 0;
+  s.resize(length);
+  return length == 0 || fread(&s[0], 1, length, file) == length;
+}
+
+static void write_map(FILE* file, const si_stringmap_utf8& map)
+{
+  fprintf(file, "%lu\n", (unsigned long)map.size());
+  for (si_stringmap_utf8::const_iterator it = map.begin(); it != map.end(); it++)
+  {
+    write_string(file, it->first);
+    write_string(file, it->second);
+  }
+}
+
+static int read_map(FILE* file, long size, si_stringmap_utf8& map)
+{
+  // a pair takes at least the 4 bytes of two empty strings
+  unsigned long count;
+  if (fscanf(file, "%lu", &count) != 1 || fgetc(file) != '\n' ||
+    count > (unsigned long)size / 4)
+    return 0;
+  map.clear();
+  for (unsigned long i = 0; i < count; i++)
+  {
+    std::string key, value;
+    if (!read_string(file, size, key) || !read_string(file, size, value))
+      return 0;
+    map[key] = value;
+  }
+  return 1;
+}
+
+disk_cache::disk_cache(void):
+  m_capacity(0),
+  m_bytes(0),
+  m_clock(0)
+{
+
+}
+
+disk_cache::~disk_cache(void)
+{
+  // keeps the recency of this run's lookups
+  if (!m_dir.empty())
+    _save_index();
+}
+
+int disk_cache::open(const std::string& dir)
+{
+  if (!m_dir.empty())
+    _save_index();
+  m_dir.clear();
+  m_records.clear();
+  m_contents.clear();
+  m_bytes = 0;
+  m_clock = 0;
+
+  if (dir.empty() || !make_directory(dir))
+    return 0;
+  m_dir = dir;
+  _load_index();
+  _evict();
+  return 1;
+}
+
+const std::string& disk_cache::get_directory() const
+{
+  return m_dir;
+}
+
+void disk_cache::set_capacity(long long capacity)
+{
+  if (capacity == m_capacity)
+    return;
+  m_capacity = capacity;
+  if (!m_dir.empty() && m_capacity > 0 && m_bytes > m_capacity)
+  {
+    _evict();
+    _save_index();
+  }
+}
+
+int disk_cache::lookup(const std::string& url, const si_stringmap_utf8& request_header,
+                       entry& out)
+{
+  if (m_dir.empty())
+    return 0;
+  int no_store, no_cache;
+  http_cache::get_request_directives(request_header, no_store, no_cache);
+  if (no_store)
+    return 0;
+
+  unsigned long long key = fnv1a(url.data(), url.length());
+  std::map<unsigned long long, index_record>::iterator it = m_records.find(key);
+  if (it == m_records.end())
+    return 0;
+  if (!_read_meta(key, out))
+  {
+    _erase(key);
+    _save_index();
+    return 0;
+  }
+  // a different url with the same hash
+  if (out.url != url || !http_cache::vary_matches(out.vary, request_header))
+    return 0;
+
+  index_record& record = it->second;
+  record.last_used = ++m_clock;
+  out.body_path = _path(record.content, ".body");
+  out.body_size = record.body_size;
+  out.expires = no_cache ? 0 : record.expires;
+  return 1;
+}
+
+void disk_cache::store(const std::string& url, const si_stringmap_utf8& request_header,
+                       const si_stringmap_utf8& response_header, const si_buffer* body,
+                       const std::string& body_file, long long now)
+{
+  if (m_dir.empty())
+    return;
+
+  entry e;
+  long long lifetime;
+  if (!http_cache::get_lifetime(request_header, response_header, now, lifetime) ||
+    !http_cache::get_vary(request_header, response_header, e.vary))
+    return;
+  // a response stale on arrival is only worth keeping to revalidate
+  std::vector<std::string> validators;
+  e.header = response_header;
+  if (lifetime <= 0 && !get_validators(e, validators))
+    return;
+
+  // hash the body, a body file is copied into the cache on the way
+  unsigned long long content = FNV_OFFSET;
+  long long size = 0;
+  std::string temp_path = m_dir + "/body.tmp";
+  if (body)
+  {
+    size = body->size();
+    if (size > 0)
+      content = fnv1a(&(*body)[0], body->size());
+  }
+  else
+  {
+    FILE* in = open_file(body_file, "rb");
+    if (!in)
+      return;
+    FILE* out = open_file(temp_path, "wb");
+    if (!out)
+    {
+      fclose(in);
+      return;
+    }
+    char chunk[65536];
+    size_t read;
+    int ok = 1;
+    while ((read = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    {
+      content = fnv1a(chunk, read, content);
+      size += read;
+      ok = ok && fwrite(chunk, 1, read, out) == read;
+    }
+    ok = ok && !ferror(in);
+    fclose(in);
+    if (fclose(out) != 0 || !ok)
+    {
+      remove_file(temp_path);
+      return;
+    }
+  }
+  content = fnv1a(&size, sizeof(size), content);
+
+  unsigned long long key = fnv1a(url.data(), url.length());
+  if (m_records.find(key) != m_records.end())
+    _erase(key);
+
+  // a body with the same hash is shared only if the bytes match, else
+  // the next free name is taken
+  std::string body_path = _path(content, ".body");
+  for (int probes = 0; m_contents.find(content) != m_contents.end() &&
+    !same_body(body_path, body, temp_path); probes++)
+  {
+    if (probes == 16)
+    {
+      if (!body)
+        remove_file(temp_path);
+      return;
+    }
+    content++;
+    body_path = _path(content, ".body");
+  }
+  if (m_contents.find(content) == m_contents.end())
+  {
+    if (body)
+    {
+      FILE* out = open_file(temp_path, "wb");
+      if (!out)
+        return;
+      int ok = size == 0 || fwrite(&(*body)[0], 1, body->size(), out) == body->size();
+      if (fclose(out) != 0 || !ok)
+      {
+        remove_file(temp_path);
+        return;
+      }
+    }
+    if (!replace_file(temp_path, body_path))
+    {
+      remove_file(temp_path);
+      return;
+    }
+  }
+  else if (!body)
+    remove_file(temp_path);
+
+  e.url = url;
+  if (!_write_meta(key, e))
+  {
+    if (m_contents.find(content) == m_contents.end())
+      remove_file(body_path);
+    return;
+  }
+
+  index_record record;
+  record.key = key;
+  record.content = content;
+  record.body_size = size;
+  record.expires = now + (lifetime > 0 ? lifetime : 0);
+  record.last_used = ++m_clock;
+  m_records[key] = record;
+  if (m_contents[content]++ == 0)
+    m_bytes += size;
+  _evict();
+  _save_index();
+}
+
+int disk_cache::refresh(const std::string& url, const si_stringmap_utf8& request_header,
+                        const si_stringmap_utf8& response_header, long long now,
+                        entry& out)
+{
+  if (m_dir.empty())
+    return 0;
+  unsigned long long key = fnv1a(url.data(), url.length());
+  std::map<unsigned long long, index_record>::iterator it = m_records.find(key);
+  if (it == m_records.end())
+    return 0;
+  if (!_read_meta(key, out))
+  {
+    _erase(key);
+    _save_index();
+    return 0;
+  }
+  if (out.url != url)
+    return 0;
+
+  // the 304 headers replace the stored ones, except the status line and
+  // the length of the body it did not send
+  for (si_stringmap_utf8::const_iterator hit = response_header.begin();
+    hit != response_header.end(); hit++)
+  {
+    if (hit->first.empty() || same_name(hit->first, "content-length"))
+      continue;
+    for (si_stringmap_utf8::iterator old = out.header.begin(); old != out.header.end(); old++)
+    {
+      if (same_name(old->first, hit->first))
+      {
+        out.header.erase(old);
+        break;
+      }
+    }
+    out.header[hit->first] = hit->second;
+  }
+
+  long long lifetime;
+  if (!http_cache::get_lifetime(request_header, out.header, now, lifetime))
+    lifetime = 0;
+  index_record& record = it->second;
+  record.expires = now + (lifetime > 0 ? lifetime : 0);
+  record.last_used = ++m_clock;
+  _write_meta(key, out);
+  _save_index();
+
+  out.body_path = _path(record.content, ".body");
+  out.body_size = record.body_size;
+  out.expires = record.expires;
+  return 1;
+}
+
+void disk_cache::get_stats(long long& entries, long long& bytes) const
+{
+  entries = (long long)m_records.size();
+  bytes = m_bytes;
+}
+
+int disk_cache::get_validators(const entry& cached, std::vector<std::string>& lines)
+{
+  lines.clear();
+  std::string value;
+  if (http_cache::find_header(cached.header, "etag", value))
+    lines.push_back("If-None-Match: " + value);
+  if (http_cache::find_header(cached.header, "last-modified", value))
+    lines.push_back("If-Modified-Since: " + value);
+  return !lines.empty();
+}
+
+int disk_cache::read_body(const entry& cached, const refptr<request>& req)
+{
+  FILE* in = open_file(cached.body_path, "rb");
+  if (!in)
+    return 0;
+  char chunk[65536];
+  size_t read;
+  long long total = 0;
+  while ((read = fread(chunk, 1, sizeof(chunk), in)) > 0)
+  {
+    req->set_appendbuffer(chunk, read);
+    total += read;
+  }
+  fclose(in);
+  return total == cached.body_size;
+}
+
+void disk_cache::_load_index()
+{
+  std::string path = m_dir + "/index";
+  const char* data = NULL;
+  size_t size = 0;
+#if defined(_WINDOWS_)
+  HANDLE file = ::CreateFileW(strings::utf8string_wstring(path).c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return;
+  HANDLE mapping = NULL;
+  LARGE_INTEGER file_size;
+  if (::GetFileSizeEx(file, &file_size) && file_size.QuadPart >= sizeof(index_header))
+    mapping = ::CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping)
+  {
+    data = (const char*)::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    size = (size_t)file_size.QuadPart;
+  }
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(index_header))
+  {
+    void* mapped = ::mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED)
+    {
+      data = (const char*)mapped;
+      size = st.st_size;
+    }
+  }
+#endif
+
+  // an index of another version or a torn one starts an empty cache
+  const index_header* header = (const index_header*)data;
+  if (data && memcmp(header->magic, INDEX_MAGIC, 4) == 0 &&
+    header->version == INDEX_VERSION && header->record_size == sizeof(index_record) &&
+    (size - sizeof(index_header)) / sizeof(index_record) >= header->count)
+  {
+    const index_record* records = (const index_record*)(data + sizeof(index_header));
+    for (unsigned int i = 0; i < header->count; i++)
+    {
+      const index_record& record = records[i];
+      m_records[record.key] = record;
+      if (m_contents[record.content]++ == 0)
+        m_bytes += record.body_size;
+      if (record.last_used > m_clock)
+        m_clock = record.last_used;
+    }
+  }
+
+#if defined(_WINDOWS_)
+  if (data)
+    ::UnmapViewOfFile(data);
+  if (mapping)
+    ::CloseHandle(mapping);
+  ::CloseHandle(file);
+#else
+  if (data)
+    ::munmap((void*)data, size);
+  ::close(fd);
+#endif
+}
+
+void disk_cache::_save_index()
+{
+  std::string path = m_dir + "/index";
+  std::string temp_path = path + ".tmp";
+  FILE* file = open_file(temp_path, "wb");
+  if (!file)
+    return;
+
+  index_header header;
+  memcpy(header.magic, INDEX_MAGIC, 4);
+  header.version = INDEX_VERSION;
+  header.record_size = sizeof(index_record);
+  header.count = (unsigned int)m_records.size();
+  int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (std::map<unsigned long long, index_record>::iterator it = m_records.begin();
+    ok && it != m_records.end(); it++)
+    ok = fwrite(&it->second, sizeof(index_record), 1, file) == 1;
+  if (fclose(file) != 0 || !ok || !replace_file(temp_path, path))
+    remove_file(temp_path);
+}
+
+void disk_cache::_erase(unsigned long long key)
+{
+  std::map<unsigned long long, index_record>::iterator it = m_records.find(key);
+  if (it == m_records.end())
+    return;
+  index_record record = it->second;
+  m_records.erase(it);
+  remove_file(_path(key, ".meta"));
+
+  std::map<unsigned long long, int>::iterator content = m_contents.find(record.content);
+  if (content != m_contents.end() && --content->second == 0)
+  {
+    m_contents.erase(content);
+    m_bytes -= record.body_size;
+    remove_file(_path(record.content, ".body"));
+  }
+}
+
+void disk_cache::_evict()
+{
+  while (m_capacity > 0 && m_bytes > m_capacity && !m_records.empty())
+  {
+    std::map<unsigned long long, index_record>::iterator oldest = m_records.begin();
+    for (std::map<unsigned long long, index_record>::iterator it = m_records.begin();
+      it != m_records.end(); it++)
+      if (it->second.last_used < oldest->second.last_used)
+        oldest = it;
+    _erase(oldest->first);
+  }
+}
+
+int disk_cache::_write_meta(unsigned long long key, const entry& e)
+{
+  std::string path = _path(key, ".meta");
+  std::string temp_path = path + ".tmp";
+  FILE* file = open_file(temp_path, "wb");
+  if (!file)
+    return 0;
+  fprintf(file, "%s\n", META_MAGIC);
+  write_string(file, e.url);
+  write_map(file, e.vary);
+  write_map(file, e.header);
+  int ok = !ferror(file);
+  if (fclose(file) != 0 || !ok || !replace_file(temp_path, path))
+  {
+    remove_file(temp_path);
+    return 0;
+  }
+  return 1;
+}
+
+int disk_cache::_read_meta(unsigned long long key, entry& e)
+{
+  FILE* file = open_file(_path(key, ".meta"), "rb");
+  if (!file)
+    return 0;
+  long size = -1;
+  if (fseek(file, 0, SEEK_END) == 0)
+    size = ftell(file);
+  char magic[sizeof(META_MAGIC) + 1];
+  int ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0 &&
+    fgets(magic, sizeof(magic), file) &&
+    strncmp(magic, META_MAGIC "\n", sizeof(magic)) == 0 &&
+    read_string(file, size, e.url) && read_map(file, size, e.vary) &&
+    read_map(file, size, e.header);
+  fclose(file);
+  return ok;
+}
+
+std::string disk_cache::_path(unsigned long long hash, const char* suffix) const
+{
+  char name[32];
+  sprintf(name, "/%016llx", hash);
+  return m_dir + name + suffix;
+}
@@ -0,0 +1,125 @@
+#ifndef SINET_DISK_CACHE_H
+#define SINET_DISK_CACHE_H
+
+#include "api_types.h"
+#include "request.h"
+
+namespace sinet
+{
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  disk_cache class
+//
+//    Cache of GET responses kept in a directory, so it survives restarts.
+//    Each url has one entry, a metadata file named after a hash of the
+//    url holding the response headers and Vary values. Bodies are
+//    content-addressed, stored once in a file named after a hash of
+//    their bytes however many urls share them. A body is only shared
+//    after its bytes are compared with the stored one.
+//
+//    The entries are listed in the index file: a header and fixed size
+//    records in host byte order, so the file is mapped and read in
+//    place when the directory is opened. It is rewritten after every
+//    change.
+//
+//    Stale entries that carry an ETag or Last-Modified stay, they are
+//    revalidated with a conditional request rather than fetched again.
+//    Least recently used entries go once the bodies exceed the capacity.
+//
+//    Not thread safe, the pool thread owns it.
+//
+class disk_cache
+{
+public:
+  typedef struct _entry{
+    std::string       url;
+    // lower-case request header names listed by Vary, and their values
+    si_stringmap_utf8 vary;
+    si_stringmap_utf8 header;
+    std::string       body_path;
+    long long         body_size;
+    // end of freshness, seconds since the epoch
+    long long         expires;
+  }entry;
+
+  disk_cache(void);
+  ~disk_cache(void);
+
+  // use the cache in |dir|, creating the directory if needed. An empty
+  // |dir| closes the cache.
+  // @returns 0 if the directory cannot be used
+  int open(const std::string& dir);
+  const std::string& get_directory() const;
+  // bytes of bodies to keep
+  void set_capacity(long long capacity);
+
+  // find the entry of |url| matching |request_header|, fresh or stale
+  // @returns 1 and the entry, 0 on a miss
+  int lookup(const std::string& url, const si_stringmap_utf8& request_header,
+             entry& out);
+  // store a 200 response if its headers allow it, the body is |body|,
+  // or the file |body_file| when |body| is NULL
+  void store(const std::string& url, const si_stringmap_utf8& request_header,
+             const si_stringmap_utf8& response_header, const si_buffer* body,
+             const std::string& body_file, long long now);
+  // a 304 confirmed the entry of |url|: take the headers it sent and
+  // start a new freshness lifetime
+  // @returns 1 and the updated entry, 0 if there is no entry
+  int refresh(const std::string& url, const si_stringmap_utf8& request_header,
+              const si_stringmap_utf8& response_header, long long now,
+              entry& out);
+
+  // @returns the number of entries and bytes of bodies
+  void get_stats(long long& entries, long long& bytes) const;
+
+  // conditional request headers that revalidate |cached|
+  // @returns 0 if it has neither ETag nor Last-Modified
+  static int get_validators(const entry& cached, std::vector<std::string>& lines);
+  // append the body of |cached| to the response of |req|
+  // @returns 0 if the body file cannot be read
+  static int read_body(const entry& cached, const refptr<request>& req);
+
+private:
+  // fixed size records of the index file, 8 byte aligned
+  typedef struct _index_header{
+    char          magic[4];
+    unsigned int  version;
+    unsigned int  record_size;
+    unsigned int  count;
+  }index_header;
+  typedef struct _index_record{
+    // hash of the url, names the metadata file
+    unsigned long long key;
+    // hash of the body, names the body file
+    unsigned long long content;
+    long long          body_size;
+    long long          expires;
+    long long          last_used;
+  }index_record;
+
+  void _load_index();
+  void _save_index();
+  // drop the entry of |key| and its body if nothing else uses it
+  void _erase(unsigned long long key);
+  void _evict();
+  // write |e| as the metadata of |key|
+  int _write_meta(unsigned long long key, const entry& e);
+  // @returns 0 if the metadata of |key| is missing or corrupt
+  int _read_meta(unsigned long long key, entry& e);
+  std::string _path(unsigned long long hash, const char* suffix) const;
+
+  std::string m_dir;
+  long long   m_capacity;
+  // bytes of distinct bodies
+  long long   m_bytes;
+  // bumped by lookups, orders the evictions
+  long long   m_clock;
+  std::map<unsigned long long, index_record> m_records;
+  // entries using each body
+  std::map<unsigned long long, int> m_contents;
+};
+
+} // namespace sinet
+
+#endif // SINET_DISK_CACHE_H
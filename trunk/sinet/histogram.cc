@@ -0,0 +1,70 @@
+#include "pch.h"
+#include "histogram.h"
+
+using namespace sinet;
+
+int sinet::histogram_bucket(long long value)
+{
+  if (value < HISTOGRAM_SUB_BUCKETS)
+    return value < 0 ? 0 : (int)value;
+  if (value >= (1LL << HISTOGRAM_MAX_BITS))
+    return HISTOGRAM_BUCKETS - 1;
+  int bits = HISTOGRAM_SUB_BITS;
+  while ((value >> (bits + 1)) != 0)
+    bits++;
+  // the top HISTOGRAM_SUB_BITS bits below the leading one pick the
+  // sub-bucket
+  int sub = (int)(value >> (bits - HISTOGRAM_SUB_BITS)) - HISTOGRAM_SUB_BUCKETS;
+  return (bits - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+void sinet::histogram_bucket_range(int index, long long& low, long long& high)
+{
+  if (index < HISTOGRAM_SUB_BUCKETS)
+  {
+    low = high = index;
+    return;
+  }
+  int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+  int sub = index % HISTOGRAM_SUB_BUCKETS;
+  low = (long long)(HISTOGRAM_SUB_BUCKETS + sub) << shift;
+  high = low + (1LL << shift) - 1;
+}
+
+void sinet::histogram_record(latency_histogram& histogram, long long value)
+{
+  if (value < 0)
+    value = 0;
+  if (histogram.count == 0 || value < histogram.min)
+    histogram.min = value;
+  if (value > histogram.max)
+    histogram.max = value;
+  histogram.count++;
+  histogram.sum += value;
+  histogram.buckets[histogram_bucket(value)]++;
+}
+
+long long sinet::histogram_percentile(const latency_histogram& histogram, double percentile)
+{
+  if (histogram.count == 0)
+    return 0;
+  if (percentile < 0)
+    percentile = 0;
+  if (percentile > 100)
+    percentile = 100;
+  long long rank = (long long)(percentile * histogram.count / 100 + 0.5);
+  if (rank < 1)
+    rank = 1;
+  long long seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    seen += histogram.buckets[i];
+    if (seen >= rank)
+    {
+      long long low, high;
+      histogram_bucket_range(i, low, high);
+      return high < histogram.max ? high : histogram.max;
+    }
+  }
+  return histogram.max;
+}
@@ -0,0 +1,45 @@
+#ifndef SINET_HISTOGRAM_H
+#define SINET_HISTOGRAM_H
+
+namespace sinet
+{
+
+// values below 2^HISTOGRAM_SUB_BITS are counted exactly, each power of
+// two above is split into 2^HISTOGRAM_SUB_BITS buckets
+#define HISTOGRAM_SUB_BITS      4
+#define HISTOGRAM_SUB_BUCKETS   (1 << HISTOGRAM_SUB_BITS)
+// values from 2^HISTOGRAM_MAX_BITS up share the last bucket
+#define HISTOGRAM_MAX_BITS      32
+#define HISTOGRAM_BUCKETS       \
+  ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  latency_histogram struct
+//
+//    Log-linear buckets in the manner of HdrHistogram, a value is known
+//    within 1/16 of itself. The pool keeps microseconds in them, up to
+//    about 71 minutes. Plain data of a fixed size, so snapshots are
+//    copied as they are. Not thread safe.
+//
+typedef struct _latency_histogram{
+  long long count;
+  long long sum;
+  long long min;
+  long long max;
+  long long buckets[HISTOGRAM_BUCKETS];
+}latency_histogram;
+
+// count |value|, a negative one as 0
+void histogram_record(latency_histogram& histogram, long long value);
+// @returns the value at or below which |percentile| (0 to 100) of the
+//          values are, to the precision of the buckets. 0 when empty.
+long long histogram_percentile(const latency_histogram& histogram, double percentile);
+// @returns the bucket of |value|
+int histogram_bucket(long long value);
+// the values bucket |index| holds, |high| included
+void histogram_bucket_range(int index, long long& low, long long& high);
+
+} // namespace sinet
+
+#endif // SINET_HISTOGRAM_H
@@ -0,0 +1,377 @@
+#include "pch.h"
+#include "http_cache.h"
+#include <stdio.h>
+
+using namespace sinet;
+
+static std::string to_lower(const std::string& s)
+{
+  std::string ret(s);
+  for (size_t i = 0; i < ret.length(); i++)
+    if (ret[i] >= 'A' && ret[i] <= 'Z')
+      ret[i] = ret[i] - 'A' + 'a';
+  return ret;
+}
+
+static std::string trim(const std::string& s)
+{
+  const char* ws = " \t\r\n";
+  size_t begin = s.find_first_not_of(ws);
+  if (begin == std::string::npos)
+    return std::string();
+  return s.substr(begin, s.find_last_not_of(ws) - begin + 1);
+}
+
+// Cache-Control directives the cache cares about
+typedef struct _cache_control{
+  int       no_store;
+  int       no_cache;
+  // -1 when absent
+  long long max_age;
+}cache_control;
+
+static void parse_cache_control(const si_stringmap_utf8& header, cache_control& cc)
+{
+  cc.no_store = 0;
+  cc.no_cache = 0;
+  cc.max_age = -1;
+
+  std::string value;
+  if (!http_cache::find_header(header, "cache-control", value))
+    return;
+  value = to_lower(value);
+  size_t pos = 0;
+  while (pos <= value.length())
+  {
+    size_t comma = value.find(',', pos);
+    if (comma == std::string::npos)
+      comma = value.length();
+    std::string directive = trim(value.substr(pos, comma - pos));
+    pos = comma + 1;
+
+    if (directive == "no-store")
+      cc.no_store = 1;
+    else if (directive.compare(0, 8, "no-cache") == 0)
+      cc.no_cache = 1;
+    else if (directive.compare(0, 8, "max-age=") == 0)
+    {
+      const char* num = directive.c_str() + 8;
+      if (*num == '"')
+        num++;
+      if (*num >= '0' && *num <= '9')
+        cc.max_age = strtol(num, 0, 10);
+    }
+  }
+}
+
+// days since 1970-01-01 of a proleptic Gregorian date
+static long long days_from_civil(long long y, int m, int d)
+{
+  y -= m <= 2;
+  long long era = (y >= 0 ? y : y - 399) / 400;
+  long long yoe = y - era * 400;
+  long long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+http_cache::http_cache(void):
+  m_capacity(0),
+  m_bytes(0),
+  m_hits(0),
+  m_misses(0),
+  m_stores(0),
+  m_evictions(0)
+{
+
+}
+
+void http_cache::set_capacity(size_t capacity)
+{
+  m_capacity = capacity;
+  _evict();
+}
+
+size_t http_cache::get_capacity() const
+{
+  return m_capacity;
+}
+
+const http_cache::entry* http_cache::lookup(const std::string& url,
+                                            const si_stringmap_utf8& request_header,
+                                            long long now)
+{
+  if (m_capacity == 0)
+    return NULL;
+
+  int no_store, no_cache;
+  get_request_directives(request_header, no_store, no_cache);
+  if (no_store || no_cache)
+  {
+    m_misses++;
+    return NULL;
+  }
+
+  typedef std::multimap<std::string, entry_list::iterator>::iterator index_iterator;
+  std::pair<index_iterator, index_iterator> range = m_index.equal_range(url);
+  for (index_iterator it = range.first; it != range.second; it++)
+  {
+    entry_list::iterator eit = it->second;
+    if (!vary_matches(eit->vary, request_header))
+      continue;
+    if (eit->expires <= now)
+      break;
+    m_entries.splice(m_entries.begin(), m_entries, eit);
+    m_hits++;
+    return &*eit;
+  }
+  m_misses++;
+  return NULL;
+}
+
+void http_cache::store(const std::string& url, const si_stringmap_utf8& request_header,
+                       int status, const si_stringmap_utf8& response_header,
+                       const si_buffer& body, long long now)
+{
+  if (m_capacity == 0 || status != 200)
+    return;
+
+  long long lifetime;
+  if (!get_lifetime(request_header, response_header, now, lifetime) || lifetime <= 0)
+    return;
+
+  entry e;
+  e.url = url;
+  if (!get_vary(request_header, response_header, e.vary))
+    return;
+  e.status = status;
+  e.header = response_header;
+  e.body = body;
+  e.expires = now + lifetime;
+  e.size = body.size() + url.length();
+  for (si_stringmap_utf8::const_iterator it = response_header.begin();
+    it != response_header.end(); it++)
+    e.size += it->first.length() + it->second.length();
+  if (e.size > m_capacity)
+    return;
+
+  // replace the variant this request would have matched
+  typedef std::multimap<std::string, entry_list::iterator>::iterator index_iterator;
+  std::pair<index_iterator, index_iterator> range = m_index.equal_range(url);
+  for (index_iterator it = range.first; it != range.second; it++)
+  {
+    if (vary_matches(it->second->vary, request_header))
+    {
+      _erase(it->second);
+      break;
+    }
+  }
+
+  m_entries.push_front(e);
+  m_index.insert(std::make_pair(url, m_entries.begin()));
+  m_bytes += e.size;
+  m_stores++;
+  _evict();
+}
+
+void http_cache::get_stats(cache_stats& stats) const
+{
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  stats.stores = m_stores;
+  stats.evictions = m_evictions;
+  stats.entries = (long long)m_entries.size();
+  stats.bytes = (long long)m_bytes;
+}
+
+void http_cache::get_request_directives(const si_stringmap_utf8& request_header,
+                                        int& no_store, int& no_cache)
+{
+  cache_control cc;
+  parse_cache_control(request_header, cc);
+  std::string pragma;
+  no_store = cc.no_store;
+  no_cache = cc.no_cache ||
+    (find_header(request_header, "pragma", pragma) && to_lower(pragma) == "no-cache");
+}
+
+int http_cache::get_lifetime(const si_stringmap_utf8& request_header,
+                             const si_stringmap_utf8& response_header,
+                             long long now, long long& lifetime)
+{
+  cache_control request_cc, response_cc;
+  parse_cache_control(request_header, request_cc);
+  parse_cache_control(response_header, response_cc);
+  if (request_cc.no_store || response_cc.no_store)
+    return 0;
+
+  // max-age wins over Expires, an invalid Expires means already expired
+  lifetime = 0;
+  std::string value;
+  long long expires_at, date;
+  if (response_cc.max_age >= 0)
+    lifetime = response_cc.max_age;
+  else if (find_header(response_header, "expires", value) &&
+    parse_http_date(value, expires_at))
+  {
+    if (!(find_header(response_header, "date", value) && parse_http_date(value, date)))
+      date = now;
+    lifetime = expires_at - date;
+  }
+  if (response_cc.no_cache || request_cc.no_cache)
+    lifetime = 0;
+  else if (lifetime > 0 && find_header(response_header, "age", value))
+    lifetime -= strtol(value.c_str(), 0, 10);
+  return 1;
+}
+
+int http_cache::get_vary(const si_stringmap_utf8& request_header,
+                         const si_stringmap_utf8& response_header,
+                         si_stringmap_utf8& vary)
+{
+  vary.clear();
+  std::string value;
+  if (!find_header(response_header, "vary", value))
+    return 1;
+  value = to_lower(value);
+  size_t pos = 0;
+  while (pos <= value.length())
+  {
+    size_t comma = value.find(',', pos);
+    if (comma == std::string::npos)
+      comma = value.length();
+    std::string name = trim(value.substr(pos, comma - pos));
+    pos = comma + 1;
+    if (name == "*")
+      return 0;
+    if (name.empty())
+      continue;
+    std::string request_value;
+    find_header(request_header, name.c_str(), request_value);
+    vary[name] = request_value;
+  }
+  return 1;
+}
+
+int http_cache::vary_matches(const si_stringmap_utf8& vary,
+                             const si_stringmap_utf8& request_header)
+{
+  for (si_stringmap_utf8::const_iterator it = vary.begin(); it != vary.end(); it++)
+  {
+    std::string value;
+    find_header(request_header, it->first.c_str(), value);
+    if (value != it->second)
+      return 0;
+  }
+  return 1;
+}
+
+int http_cache::find_header(const si_stringmap_utf8& header, const char* name,
+                            std::string& value)
+{
+  size_t name_len = strlen(name);
+  for (si_stringmap_utf8::const_iterator it = header.begin(); it != header.end(); it++)
+  {
+    const std::string& key = it->first;
+    if (key.length() != name_len)
+      continue;
+    size_t i = 0;
+    for (; i < name_len; i++)
+    {
+      char c = key[i];
+      if (c >= 'A' && c <= 'Z')
+        c = c - 'A' + 'a';
+      char n = name[i];
+      if (n >= 'A' && n <= 'Z')
+        n = n - 'A' + 'a';
+      if (c != n)
+        break;
+    }
+    if (i == name_len)
+    {
+      value = trim(it->second);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int http_cache::parse_http_date(const std::string& date, long long& seconds)
+{
+  static const char* months[] = {"jan", "feb", "mar", "apr", "may", "jun",
+                                 "jul", "aug", "sep", "oct", "nov", "dec"};
+  int day = -1, month = -1, hour = -1, minute = -1, second = -1;
+  long long year = -1;
+
+  // split on spaces, commas and the dashes of RFC 850 dates, then
+  // sort the tokens out by their shape
+  std::string token;
+  for (size_t i = 0; i <= date.length(); i++)
+  {
+    char c = i < date.length() ? date[i] : ' ';
+    if (c != ' ' && c != ',' && c != '-' && c != '\t')
+    {
+      token.push_back(c);
+      continue;
+    }
+    if (token.empty())
+      continue;
+
+    if (token.find(':') != std::string::npos)
+    {
+      if (sscanf(token.c_str(), "%d:%d:%d", &hour, &minute, &second) != 3)
+        return 0;
+    }
+    else if (token[0] >= '0' && token[0] <= '9')
+    {
+      long long value = strtol(token.c_str(), 0, 10);
+      if (day < 0 && token.length() <= 2)
+        day = (int)value;
+      else
+      {
+        year = value;
+        if (token.length() <= 2)
+          year += year < 70 ? 2000 : 1900;
+      }
+    }
+    else if (month < 0)
+    {
+      std::string lower = to_lower(token.substr(0, 3));
+      for (int m = 0; m < 12; m++)
+        if (lower == months[m])
+          month = m + 1;
+    }
+    token.clear();
+  }
+
+  if (day < 1 || day > 31 || month < 0 || year < 0 ||
+    hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60)
+    return 0;
+  seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+  return 1;
+}
+
+void http_cache::_erase(entry_list::iterator it)
+{
+  typedef std::multimap<std::string, entry_list::iterator>::iterator index_iterator;
+  std::pair<index_iterator, index_iterator> range = m_index.equal_range(it->url);
+  for (index_iterator iit = range.first; iit != range.second; iit++)
+  {
+    if (iit->second == it)
+    {
+      m_index.erase(iit);
+      break;
+    }
+  }
+  m_bytes -= it->size;
+  m_entries.erase(it);
+}
+
+void http_cache::_evict()
+{
+  while (!m_entries.empty() && m_bytes > m_capacity)
+  {
+    _erase(--m_entries.end());
+    m_evictions++;
+  }
+}
@@ -0,0 +1,109 @@
+#ifndef SINET_HTTP_CACHE_H
+#define SINET_HTTP_CACHE_H
+
+#include "api_types.h"
+#include "pool.h"
+#include <list>
+
+namespace sinet
+{
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  http_cache class
+//
+//    In-memory cache of GET responses, least recently used entries are
+//    evicted once the stored headers and bodies exceed the capacity.
+//
+//    Only 200 responses with an explicit lifetime are stored: max-age
+//    from Cache-Control, or Expires minus Date. no-store in the request
+//    or response keeps a response out, no-cache in either makes it
+//    stale right away, and Vary: * is never stored. Other Vary headers
+//    keep one variant per combination of the listed request headers.
+//
+//    Times are seconds since the epoch, passed in by the caller. Not
+//    thread safe, the pool thread owns it.
+//
+class http_cache
+{
+public:
+  typedef struct _entry{
+    std::string       url;
+    // lower-case request header names listed by Vary, and their values
+    si_stringmap_utf8 vary;
+    int               status;
+    si_stringmap_utf8 header;
+    si_buffer         body;
+    // end of freshness
+    long long         expires;
+    size_t            size;
+  }entry;
+
+  http_cache(void);
+
+  // bytes of headers and bodies to keep, 0 empties and disables the
+  // cache
+  void set_capacity(size_t capacity);
+  size_t get_capacity() const;
+
+  // @returns the fresh entry of |url| matching |request_header|, NULL
+  //          on a miss. It is valid until the next store.
+  const entry* lookup(const std::string& url,
+                      const si_stringmap_utf8& request_header, long long now);
+  // store a response if its headers allow it, replacing an older entry
+  // with the same url and Vary values
+  void store(const std::string& url, const si_stringmap_utf8& request_header,
+             int status, const si_stringmap_utf8& response_header,
+             const si_buffer& body, long long now);
+
+  void get_stats(cache_stats& stats) const;
+
+  // @returns 1 and the trimmed value of header |name|, compared
+  //          without case, 0 if it is missing
+  static int find_header(const si_stringmap_utf8& header, const char* name,
+                         std::string& value);
+  // Cache-Control and Pragma of a request: no-store keeps it away from
+  // the caches, no-cache wants a new or revalidated response
+  static void get_request_directives(const si_stringmap_utf8& request_header,
+                                     int& no_store, int& no_cache);
+  // freshness of a response
+  // @returns 0 if it must not be stored at all, else 1 and the seconds
+  //          it stays fresh, 0 or less if it is stale on arrival
+  static int get_lifetime(const si_stringmap_utf8& request_header,
+                          const si_stringmap_utf8& response_header,
+                          long long now, long long& lifetime);
+  // collect the lower-case names and request values of the headers
+  // listed by Vary
+  // @returns 0 for Vary: *, which is never stored
+  static int get_vary(const si_stringmap_utf8& request_header,
+                      const si_stringmap_utf8& response_header,
+                      si_stringmap_utf8& vary);
+  // @returns 1 if |request_header| has the values in |vary|
+  static int vary_matches(const si_stringmap_utf8& vary,
+                          const si_stringmap_utf8& request_header);
+  // parse an RFC 1123, RFC 850 or asctime date
+  // @returns 1 and the seconds since the epoch, 0 if |date| is invalid
+  static int parse_http_date(const std::string& date, long long& seconds);
+
+private:
+  typedef std::list<entry> entry_list;
+
+  void _erase(entry_list::iterator it);
+  void _evict();
+
+  size_t      m_capacity;
+  size_t      m_bytes;
+  // most recently used first
+  entry_list  m_entries;
+  // all variants of an url
+  std::multimap<std::string, entry_list::iterator> m_index;
+
+  long long   m_hits;
+  long long   m_misses;
+  long long   m_stores;
+  long long   m_evictions;
+};
+
+} // namespace sinet
+
+#endif // SINET_HTTP_CACHE_H
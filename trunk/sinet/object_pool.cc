@@ -0,0 +1,214 @@
+#include "pch.h"
+#include "object_pool.h"
+#include <new>
+
+using namespace sinet;
+
+#if defined(_WINDOWS_)
+// Fiber local storage calls back when a thread exits, thread local
+// storage does not. It is looked up at run time as Windows before
+// Server 2003 lacks it, there the blocks cached by a thread that exits
+// are not used again.
+typedef DWORD (WINAPI *fls_alloc_t)(void (WINAPI *callback)(void*));
+typedef PVOID (WINAPI *fls_get_value_t)(DWORD index);
+typedef BOOL (WINAPI *fls_set_value_t)(DWORD index, PVOID value);
+// set by the first pool constructed, before any thread allocates
+static int fls_checked = 0;
+static fls_alloc_t fls_alloc = NULL;
+static fls_get_value_t fls_get_value = NULL;
+static fls_set_value_t fls_set_value = NULL;
+#endif
+
+object_pool::object_pool(size_t size, size_t per_slab):
+  m_lock(new critical_section),
+  m_free(NULL),
+  m_size(size),
+  m_per_slab(per_slab),
+  m_has_key(0)
+{
+  // a free block holds the link to the next one, keep it aligned
+  if (m_size < sizeof(free_block))
+    m_size = sizeof(free_block);
+  m_size = (m_size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+
+#if defined(_WINDOWS_)
+  if (!fls_checked)
+  {
+    HMODULE kernel32 = ::GetModuleHandleA("kernel32.dll");
+    fls_alloc = (fls_alloc_t)::GetProcAddress(kernel32, "FlsAlloc");
+    fls_get_value = (fls_get_value_t)::GetProcAddress(kernel32, "FlsGetValue");
+    fls_set_value = (fls_set_value_t)::GetProcAddress(kernel32, "FlsSetValue");
+    if (!fls_alloc || !fls_get_value || !fls_set_value)
+      fls_alloc = NULL;
+    fls_checked = 1;
+  }
+  m_key = fls_alloc ? fls_alloc(_thread_exit) : ::TlsAlloc();
+  // FLS_OUT_OF_INDEXES has the same value
+  m_has_key = (m_key != TLS_OUT_OF_INDEXES);
+#elif defined(_MAC_) || defined(__linux__)
+  m_has_key = (::pthread_key_create(&m_key, _thread_exit) == 0);
+#endif
+}
+
+object_pool::~object_pool(void)
+{
+  // |m_lock| and the slabs are left alone on purpose, see object_pool.h.
+  // The key goes so that no thread exit calls into an unloaded module,
+  // the blocks still cached by other threads are lost with it and
+  // objects released from now on take the lock.
+  if (!m_has_key)
+    return;
+  m_has_key = 0;
+#if defined(_WINDOWS_)
+  if (fls_alloc)
+  {
+    typedef BOOL (WINAPI *fls_free_t)(DWORD index);
+    fls_free_t fls_free = (fls_free_t)::GetProcAddress(
+      ::GetModuleHandleA("kernel32.dll"), "FlsFree");
+    if (fls_free)
+      fls_free(m_key);
+  }
+  else
+    ::TlsFree(m_key);
+#elif defined(_MAC_) || defined(__linux__)
+  ::pthread_key_delete(m_key);
+#endif
+}
+
+void* object_pool::allocate(size_t size)
+{
+  // until the static pool is constructed |m_size| is 0, so objects
+  // created that early come from the heap
+  if (size > m_size)
+    return ::operator new(size);
+
+  thread_cache* cache = _get_cache();
+  if (!cache)
+  {
+    auto_criticalsection acs(*m_lock);
+    if (!m_free)
+      _grow();
+    free_block* block = m_free;
+    m_free = block->next;
+    return block;
+  }
+
+  if (!cache->free)
+    _refill(cache);
+  free_block* block = cache->free;
+  cache->free = block->next;
+  cache->count--;
+  return block;
+}
+
+void object_pool::deallocate(void* p, size_t size)
+{
+  if (!p)
+    return;
+  if (size > m_size)
+  {
+    ::operator delete(p);
+    return;
+  }
+
+  free_block* block = (free_block*)p;
+  thread_cache* cache = _get_cache();
+  if (!cache)
+  {
+    auto_criticalsection acs(*m_lock);
+    block->next = m_free;
+    m_free = block;
+    return;
+  }
+
+  block->next = cache->free;
+  cache->free = block;
+  if (++cache->count > 2 * OBJECT_POOL_CACHE_BATCH)
+    _drain(cache, OBJECT_POOL_CACHE_BATCH);
+}
+
+object_pool::thread_cache* object_pool::_get_cache()
+{
+  if (!m_has_key)
+    return NULL;
+#if defined(_WINDOWS_)
+  thread_cache* cache = (thread_cache*)(fls_alloc ? fls_get_value(m_key) :
+                                                    ::TlsGetValue(m_key));
+#elif defined(_MAC_) || defined(__linux__)
+  thread_cache* cache = (thread_cache*)::pthread_getspecific(m_key);
+#endif
+  if (cache)
+    return cache;
+
+  cache = new thread_cache;
+  cache->pool = this;
+  cache->free = NULL;
+  cache->count = 0;
+#if defined(_WINDOWS_)
+  if (fls_alloc)
+    fls_set_value(m_key, cache);
+  else
+    ::TlsSetValue(m_key, cache);
+#elif defined(_MAC_) || defined(__linux__)
+  ::pthread_setspecific(m_key, cache);
+#endif
+  return cache;
+}
+
+void object_pool::_refill(thread_cache* cache)
+{
+  auto_criticalsection acs(*m_lock);
+  for (size_t i = 0; i < OBJECT_POOL_CACHE_BATCH; i++)
+  {
+    if (!m_free)
+      _grow();
+    free_block* block = m_free;
+    m_free = block->next;
+    block->next = cache->free;
+    cache->free = block;
+    cache->count++;
+  }
+}
+
+void object_pool::_drain(thread_cache* cache, size_t count)
+{
+  if (!cache->free || count == 0)
+    return;
+  // cut the first |count| blocks off the cache, then splice them in
+  free_block* first = cache->free;
+  free_block* last = first;
+  size_t moved = 1;
+  for (; moved < count && last->next; moved++)
+    last = last->next;
+  cache->free = last->next;
+  cache->count -= moved;
+
+  auto_criticalsection acs(*m_lock);
+  last->next = m_free;
+  m_free = first;
+}
+
+void object_pool::_grow()
+{
+  char* slab = (char*)::operator new(m_size * m_per_slab);
+  // thread the new blocks in address order
+  for (size_t i = m_per_slab; i > 0; i--)
+  {
+    free_block* block = (free_block*)(slab + (i - 1) * m_size);
+    block->next = m_free;
+    m_free = block;
+  }
+}
+
+#if defined(_WINDOWS_)
+void WINAPI object_pool::_thread_exit(void* cache)
+#elif defined(_MAC_) || defined(__linux__)
+void object_pool::_thread_exit(void* cache)
+#endif
+{
+  if (!cache)
+    return;
+  thread_cache* real_cache = (thread_cache*)cache;
+  real_cache->pool->_drain(real_cache, real_cache->count);
+  delete real_cache;
+}
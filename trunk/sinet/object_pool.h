@@ -0,0 +1,98 @@
+#ifndef SINET_OBJECT_POOL_H
+#define SINET_OBJECT_POOL_H
+
+#include "api_base.h"
+
+namespace sinet
+{
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  object_pool class
+//
+//    Hands out fixed size blocks carved from slabs of |per_slab| blocks
+//    and keeps freed blocks on a free list, so creating and releasing
+//    requests, tasks and post data does not go through malloc. Slabs
+//    are never returned, the pool stays at its peak size.
+//
+//    Each impl class routes its operator new and delete here through a
+//    static pool in its .cc file. Blocks of another size, as asked for
+//    by a derived class, fall back to the global heap.
+//
+//    Thread safe. Each thread keeps a cache of up to twice
+//    OBJECT_POOL_CACHE_BATCH free blocks per pool and only takes the
+//    lock to move a batch between it and the shared free list, so
+//    threads creating and releasing objects do not contend. The cache
+//    of a thread goes back to the shared list when the thread exits.
+//
+//    The lock and the slabs outlive the pool object, so objects
+//    released while the process exits still find them.
+//
+#define OBJECT_POOL_CACHE_BATCH 32
+
+class object_pool
+{
+public:
+  object_pool(size_t size, size_t per_slab);
+  ~object_pool(void);
+
+  void* allocate(size_t size);
+  void deallocate(void* p, size_t size);
+
+private:
+  typedef struct _free_block{
+    struct _free_block* next;
+  }free_block;
+  // the free blocks of one thread, used without the lock
+  typedef struct _thread_cache{
+    object_pool*  pool;
+    free_block*   free;
+    size_t        count;
+  }thread_cache;
+
+  // @returns the cache of the calling thread, NULL if there is no
+  //          thread local storage left
+  thread_cache* _get_cache();
+  // move a batch of blocks from the shared list to |cache|
+  void _refill(thread_cache* cache);
+  // move |count| blocks of |cache| to the shared list
+  void _drain(thread_cache* cache, size_t count);
+  void _grow();
+#if defined(_WINDOWS_)
+  static void WINAPI _thread_exit(void* cache);
+#elif defined(_MAC_) || defined(__linux__)
+  static void _thread_exit(void* cache);
+#endif
+
+  critical_section* m_lock;
+  free_block*       m_free;
+  size_t            m_size;
+  size_t            m_per_slab;
+  int               m_has_key;
+#if defined(_WINDOWS_)
+  DWORD             m_key;
+#elif defined(_MAC_) || defined(__linux__)
+  pthread_key_t     m_key;
+#endif
+};
+
+// declare operator new and delete of |ClassName| on top of an
+// object_pool, SINET_POOLED_NEW_IMPL defines them in its .cc file
+#define SINET_POOLED_NEW(ClassName) \
+  static void* operator new(size_t size); \
+  static void operator delete(void* p, size_t size);
+
+#define SINET_POOLED_NEW_IMPL(ClassName, per_slab) \
+  static object_pool ClassName##_pool(sizeof(ClassName), per_slab); \
+  void* ClassName::operator new(size_t size) \
+  { \
+    return ClassName##_pool.allocate(size); \
+  } \
+  void ClassName::operator delete(void* p, size_t size) \
+  { \
+    ClassName##_pool.deallocate(p, size); \
+  }
+
+} // namespace sinet
+
+#endif // SINET_OBJECT_POOL_H
@@ -23,125 +23,15 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
 #include <string>
 #include <iterator>
 #include <stdexcept>
 #include <algorithm>
 
 #define _min(x,y) x<y?x:y
-// the template can be found in PeerBlock (https://code.google.com/p/peerblock/)
-  template<typename InputIterator>
-  static wchar_t decode_utf8(InputIterator &iter) 
-  {
-    wchar_t ret;
-
-    if(((*iter)&0x80) == 0) 
-    {
-       ret=*iter++;
-    }
-    else if(((*iter)&0x20) == 0) 
-    {
-        ret=(
-             (((wchar_t)((*iter++)&0x1F)) << 6) |
-             ((wchar_t)((*iter++)&0x3F))
-            );
-    }
-    else if(((*iter)&0x10) == 0) 
-    {
-        ret=(
-             (((wchar_t)((*iter++)&0x0F)) << 12) |
-             (((wchar_t)((*iter++)&0x3F)) << 6) |
-              ((wchar_t)((*iter++)&0x3F))
-             );
-    }
-    wprintf(L"%c\n", ret);
-    return ret;
-  }
-
-  template<typename InputIterator, typename OutputIterator>
-  static OutputIterator utf8_wchar(InputIterator first, InputIterator last, OutputIterator dest) 
-  {
-    for(; first!=last; ++dest)
-      *dest=decode_utf8(first);
-    return dest;
-  }
-
-  template<typename OutputIterator>
-  static void encode_wchar(wchar_t ch, OutputIterator &dest) 
-  {
-     if(ch <= 0x007F) 
-     {
-        *dest=(char)ch;
-        ++dest;
-     }
-     else if(ch <= 0x07FF) 
-     {
-        *dest = (char)(
-                        0xC0 |
-                        ((ch & 0x07C0) >> 6)
-                      );
-         ++dest;
-
-         *dest = (char)(
-                        0x80 |
-                        (ch & 0x003F)
-                       );
-         ++dest;
-     }
-     else 
-     {
-         *dest = (char)(
-                        0xE0 |
-                        ((ch & 0xF000) >> 12)
-                       );
-         ++dest;
 
-         *dest = (char)(
-                        0x80 |
-                        ((ch & 0x0FC0) >> 6)
-                       );
-         ++dest;
-
-         *dest = (char)(
-                        0x80 |
-                        (ch & 0x003F)
-                       );
-         ++dest;
-     }
-  }
-
-  template<typename InputIterator, typename OutputIterator>
-  static OutputIterator wchar_utf8(InputIterator first, InputIterator last, OutputIterator dest)
-  {
-     for(; first!=last; ++first)
-       encode_wchar(*first, dest);
-     return dest;
-  }
-  // wstring -> string
-  static void wchar_utf8(const std::wstring &wchar, std::string &utf8) 
-  {
-      utf8.clear();
-      wchar_utf8(wchar.begin(), wchar.end(), std::back_inserter(utf8));
-  }
-  static std::string wchar_utf8(const std::wstring &str)
-  {
-      std::string ret;
-      wchar_utf8(str, ret);
-      return ret;
-  }
-  // string -> wstring
-  static void utf8_wchar(const std::string &utf8, std::wstring &wchar) 
-  {
-      wchar.clear();
-      utf8_wchar(utf8.begin(), utf8.end(), std::back_inserter(wchar));
-  }
-   static std::wstring utf8_wchar(const std::string &str)
-  {
-      std::wstring ret;
-      utf8_wchar(str, ret);
-      return ret;
-  }
-  
 #endif // linux (litte endian)
 
 #ifdef _MAC_
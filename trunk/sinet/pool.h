@@ -4,6 +4,12 @@
 #include "api_base.h"
 #include "api_refptr.h"
 #include "task.h"
+#include "histogram.h"
+#if defined(WIN32)
+#include <stddef.h>
+#else
+#include <stdint.h>
+#endif
 
 namespace sinet
 {
@@ -11,6 +17,78 @@ namespace sinet
   // these defines are used for the request method
 #define   REQ_POST            L"POST"
 #define   REQ_GET             L"GET"
+#define   REQ_POST_UTF8       "POST"
+#define   REQ_GET_UTF8        "GET"
+
+// defaults for the limits read from the pool config, a value of 0 or
+// less set through the config means no limit
+#define   POOL_DEFAULT_MAX_HOST_CONNECTIONS   6
+#define   POOL_DEFAULT_MAX_TOTAL_CONNECTIONS  32
+#define   POOL_DEFAULT_MAX_RUNNING_TASKS      1
+// a connection that cannot be made in 30 seconds or a transfer below
+// 1 byte per second for 60 seconds fails instead of holding its task
+#define   POOL_DEFAULT_CONNECT_TIMEOUT        30000
+#define   POOL_DEFAULT_LOW_SPEED_LIMIT        1
+#define   POOL_DEFAULT_LOW_SPEED_TIME         60
+// identical GETs are sent separately unless CFG_INT_COALESCE_GETS is set
+#define   POOL_DEFAULT_COALESCE_GETS          0
+#define   POOL_DEFAULT_DISK_CACHE_SIZE        (256*1024*1024)
+
+// counters of the response cache, see pool::get_cache_stats
+typedef struct _cache_stats{
+  long long hits;
+  long long misses;
+  long long stores;
+  long long evictions;
+  // what the cache holds now
+  long long entries;
+  long long bytes;
+  // disk cache: fresh hits, stale copies a 304 confirmed, and what the
+  // directory holds
+  long long disk_hits;
+  long long revalidated;
+  long long disk_entries;
+  long long disk_bytes;
+}cache_stats;
+
+// what the pool did since it was created, see pool::get_stats
+typedef struct _pool_stats{
+  // tasks given to execute(), and those that completed or were canceled
+  long long tasks_executed;
+  long long tasks_completed;
+  long long tasks_canceled;
+  // tasks waiting in the queue and running now
+  int       tasks_queued;
+  int       tasks_running;
+  // transfers started, hedges and retries included, and the retries
+  long long transfers;
+  long long retries;
+  // transfers running now and waiting for a connection slot
+  int       transfers_active;
+  int       transfers_waiting;
+  // requests that ended, by REQ_ERR_* class, [REQ_ERR_NONE] succeeded
+  long long requests[REQ_ERR_COUNT];
+  // headers and bodies received, requests and uploads sent
+  long long bytes_received;
+  long long bytes_sent;
+  // transfers that opened a connection or reused one, the reuse ratio
+  // is connections_reused / (connections_opened + connections_reused).
+  // New connections may have resolved a name and made a TLS handshake.
+  long long connections_opened;
+  long long connections_reused;
+  long long dns_lookups;
+  long long tls_handshakes;
+  // in microseconds: queue_wait from execute() to the first attempt of
+  // each request, the others per attempt as curl timed them. ttfb runs
+  // from the request sent to the first response byte.
+  latency_histogram queue_wait;
+  latency_histogram dns;
+  latency_histogram connect;
+  latency_histogram tls;
+  latency_histogram ttfb;
+  latency_histogram total;
+}pool_stats;
+
 //////////////////////////////////////////////////////////////////////////
 //
 //  pool class
@@ -19,6 +97,37 @@ namespace sinet
 //    task is being executed at one time (requests inside this task
 //    might be executed simultaneously).
 //
+//    Requests are grouped by origin (scheme, host and port). At most
+//    CFG_INT_MAX_HOST_CONNECTIONS transfers run against one origin and
+//    CFG_INT_MAX_TOTAL_CONNECTIONS in total, the rest wait in per-origin
+//    queues that are served round-robin. CFG_INT_MAX_RUNNING_TASKS lets
+//    more than one task run at a time. The limits are read from the
+//    config given to use_config() and can be changed at any time.
+//
+//    CFG_INT_MAX_RECV_SPEED, CFG_INT_MAX_SEND_SPEED and
+//    CFG_INT_MAX_REQUEST_RATE are token buckets, set in the pool config
+//    they apply to all tasks together, set in a task config to that task
+//    alone. Byte rates are split evenly over the running transfers and
+//    handed to curl as per-transfer speed caps. No new transfer starts
+//    while a request or receive bucket is empty.
+//
+//    With CFG_INT_CACHE_SIZE set, GET responses that carry a lifetime
+//    are kept in memory and served while fresh without a transfer, see
+//    http_cache.h. Unlike the limits, the cache settings are read once
+//    when use_config() is called.
+//
+//    With CFG_STR_CACHE_DIR set, responses are also kept on disk across
+//    runs, up to CFG_INT_DISK_CACHE_SIZE bytes. A stale copy with an
+//    ETag or Last-Modified is revalidated, and on a 304 the request gets
+//    the body from disk, in buffer or file mode. See disk_cache.h.
+//
+//    get_stats() tells where the time goes: waiting in the pool, name
+//    lookups, connects, TLS handshakes or the server.
+//
+//    Tasks report to their observer and task_callbacks. Embedders with
+//    an event loop can also wait on get_event_fd() and check their
+//    tasks when it fires.
+//
 class pool:
   public base
 {
@@ -26,19 +135,38 @@ public:
   static refptr<pool> create_instance();
 
   // execute a task
-  virtual void execute(refptr<task> task_in) = 0;
+  virtual void execute(const refptr<task>& task_in) = 0;
   // cancel executing of a task
-  virtual void cancel(refptr<task> task_in) = 0;
+  virtual void cancel(const refptr<task>& task_in) = 0;
   // check if a task is running
-  virtual int is_running(refptr<task> task_in) = 0;
+  virtual int is_running(const refptr<task>& task_in) = 0;
   // check if a task is in queue
-  virtual int is_queued(refptr<task> task_in) = 0;
+  virtual int is_queued(const refptr<task>& task_in) = 0;
   // check if a task is running or in queue
   // this method puts two checks inside one lock, to avoid
   // race condition
-  virtual int is_running_or_queued(refptr<task> task_in) = 0;
+  virtual int is_running_or_queued(const refptr<task>& task_in) = 0;
   // cancel and erase all tasks
   virtual void clear_all() = 0;
+
+  // for config definition
+  virtual void use_config(const refptr<config>& config) = 0;
+  virtual refptr<config> get_config() = 0;
+
+  // counters of the response cache
+  virtual void get_cache_stats(cache_stats& stats) = 0;
+
+  // signaled when a task completes or is canceled, created on first
+  // call and owned by the pool. On Windows an auto-reset event HANDLE
+  // to wait on, elsewhere the read end of a non-blocking pipe that gets
+  // a byte per task, drain it before checking the tasks.
+  // @returns the fd or HANDLE, -1 if it could not be created
+  virtual intptr_t get_event_fd() = 0;
+
+  // counters, gauges and latency histograms of the pool. The pool
+  // thread publishes them after each pass, so the call does not wait
+  // for transfers in progress.
+  virtual void get_stats(pool_stats& stats) = 0;
 };
 
 } // namespace sinet
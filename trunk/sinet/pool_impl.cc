@@ -1,17 +1,42 @@
 #include "pch.h"
 #include "pool_impl.h"
 #include "strings.h"
+#include "trace.h"
+#include "url.h"
 #include <curl/curl.h>
+#include <stdio.h>
 #if defined(_WINDOWS_)
 #include <process.h>
 #include <algorithm>
 #include <ctype.h>
 #elif defined(_MAC_) || defined(__linux__)
 #include <pthread.h>
+#include <fcntl.h>
 #endif
 
 using namespace sinet;
 
+// session_curl::state
+#define SESSION_QUEUED    0
+#define SESSION_ACTIVE    1
+#define SESSION_DONE      2
+// neither queued nor running, e.g. waiting on a TIMER_RETRY
+#define SESSION_WAITING   3
+// waiting for the response of its coalescing leader
+#define SESSION_FOLLOWING 4
+
+// timer_entry::kind
+#define TIMER_ALL         -1
+#define TIMER_RETRY       0
+#define TIMER_DEADLINE    1
+#define TIMER_TASK_DEADLINE 2
+#define TIMER_FIRST_BYTE  3
+#define TIMER_HEDGE       4
+
+// first byte latencies kept per origin, and needed for a percentile
+#define LATENCY_WINDOW_SIZE     100
+#define LATENCY_MIN_SAMPLES     20
+
 refptr<pool> pool::create_instance()
 {
   refptr<pool> _pool(new pool_impl());
@@ -21,40 +46,43 @@ refptr<pool> pool::create_instance()
 static size_t write_header_callback(void* ptr, size_t size, size_t nmemb, void* data)
 {
   int ret = size*nmemb;
+  SINET_TRACE_SCOPE_ARG("header callback", ret);
 
-  refptr<request> request_in((request*)data);
-  si_stringmap header = request_in->get_response_header();
+  pool_impl::session_curl* session = (pool_impl::session_curl*)data;
+  if (!session->first_byte)
+  {
+    session->first_byte = 1;
+    session->pool->_record_first_byte(session);
+  }
+  refptr<request> request_in = session->req;
 
-  std::string str((char*)ptr);
-  std::wstring newstr = strings::utf8string_wstring(str);
+  std::string newstr((char*)ptr, ret);
   
   // the request header is end with '\r\n'
-  if (newstr == L"\r\n")
+  if (newstr == "\r\n")
    return ret;
 
-  std::wstring key, value;
-  std::wstring::size_type pos;
+  std::string key, value;
+  std::string::size_type pos;
 
   // format:
   // Connection: keep-alive
-  pos = newstr.find(L":");
+  pos = newstr.find(":");
   if (pos != std::string::npos)
   {
     key = newstr.substr(0, pos);
     value = newstr.substr(pos+1, newstr.max_size());
-    header[key] = value;
-    if (key == L"Content-Length")
-      request_in->set_response_size(wcstol(value.c_str(), 0, 10));
+    request_in->add_response_header_utf8(key, value);
+    if (key == "Content-Length")
+      request_in->set_response_size(strtol(value.c_str(), 0, 10));
   }
   else 
   {
     // save HTTP response status
-    header[L""] = newstr;  
-    std::wstring reqstatus = newstr.substr(newstr.find_first_of(L" ")+1, 3);
-    request_in->set_response_errcode(wcstol(reqstatus.c_str(), 0, 10));
+    request_in->add_response_header_utf8("", newstr);
+    std::string reqstatus = newstr.substr(newstr.find_first_of(" ")+1, 3);
+    request_in->set_response_errcode(strtol(reqstatus.c_str(), 0, 10));
   }
-  
-  request_in->set_response_header(header);
 
   return ret;
 }
@@ -62,21 +90,39 @@ static size_t write_header_callback(void* ptr, size_t size, size_t nmemb, void*
 static size_t write_mem_callback(void* ptr, size_t size, size_t nmemb, void* data)
 {
   size_t realsize = size * nmemb;
+  SINET_TRACE_SCOPE_ARG("write callback", realsize);
 
-  refptr<request> request_in = (request*)data;
-  request_in->set_appendbuffer(ptr, realsize);
+  pool_impl::session_curl* session = (pool_impl::session_curl*)data;
+  session->req->set_appendbuffer(ptr, realsize);
+  session->pool->_account_received(session, realsize);
+  session->pool->_data_received(session, ptr, realsize);
 
   return realsize;
 }
 
-pool_impl::pool_impl(void)
+pool_impl::pool_impl(void):
 #if defined(_WINDOWS_)
-  :m_stop_event(::CreateEvent(NULL, TRUE, FALSE, NULL))
+  m_stop_event(::CreateEvent(NULL, TRUE, FALSE, NULL)),
+  m_finished_event(NULL),
 #endif
+  m_hmaster(::curl_multi_init()),
+  m_active_total(0),
+  m_send_rate(0),
+  m_now_ms(0),
+  m_caps_dirty(0),
+  m_rand_seed((unsigned int)_now_ms()),
+  m_disk_hits(0),
+  m_revalidated(0),
+  m_stats_dirty(0)
 {
+  m_tasks_executed = 0;
+  memset(&m_stats, 0, sizeof(m_stats));
+  memset(&m_stats_published, 0, sizeof(m_stats_published));
 #if defined(_WINDOWS_)
   m_thread = (HANDLE)::_beginthread(_thread_dispatch, 0, (void*)this);
 #elif defined(_MAC_) || defined(__linux__)
+  m_stopping = 0;
+  m_finished_pipe[0] = m_finished_pipe[1] = -1;
   pthread_cond_init(&m_stop_event, NULL);
   ::pthread_create(&m_thread, NULL, _thread_dispatch, this);
 #endif
@@ -86,17 +132,25 @@ pool_impl::~pool_impl(void)
 {
   _stop_thread();
   clear_all();
+  ::curl_multi_cleanup(m_hmaster);
 #if defined(_WINDOWS_)
   ::CloseHandle(m_stop_event);
+  if (m_finished_event)
+    ::CloseHandle(m_finished_event);
 #elif defined(_MAC_) || defined(__linux__)
   pthread_cond_destroy(&m_stop_event);
+  if (m_finished_pipe[0] >= 0)
+  {
+    ::close(m_finished_pipe[0]);
+    ::close(m_finished_pipe[1]);
+  }
 #endif
   // when a thread created by _beginthread is gracefully closed, it'll
   // call CloseHandle automatically, so there's no need for additional
   // free up operation.
 }
 
-void pool_impl::execute(refptr<task> task_in)
+void pool_impl::execute(const refptr<task>& task_in)
 {
   if (!task_in)
     return;
@@ -106,26 +160,37 @@ void pool_impl::execute(refptr<task> task_in)
   // whenever possible.
 
   task_in->set_status(taskstatus_queued);
+  // the pool thread shares the task and all it holds from now on
+  task_in->publish();
 
   m_cstask_queue.lock();
   m_task_queue.push_back(task_in);
+  m_task_queue_times.push_back(_now_ms());
+  m_tasks_executed++;
   m_cstask_queue.unlock();
+
+  _notify_status(task_in, taskstatus_queued);
 }
 
-void pool_impl::cancel(refptr<task> task_in)
+void pool_impl::cancel(const refptr<task>& task_in)
 {
-  // stop task if it's running
-  m_cstasks_running.lock();
+  int canceled = 0;
+  // stop task if it's running, waits for a pass of the pool thread
+  {
+    SINET_TRACE_SCOPE("cancel lock wait");
+    m_cstasks_running.lock();
+  }
   m_cstask_queue.lock();
   std::map<refptr<task>, task_info>::iterator it = m_tasks_running.find(task_in);
   if (it != m_tasks_running.end())
   {
-    _cancel_running_task(it->second.hmaster, it->second.htasks);
+    _cancel_running_task(it->second);
     it->first->set_status(taskstatus_canceled);
     m_cstask_finished.lock();
     m_task_finished.push_back(it->first);
     m_cstask_finished.unlock();
     m_tasks_running.erase(it);
+    canceled = 1;
   }
   // clear task if it's queued
   for (std::vector<refptr<task> >::iterator it = m_task_queue.begin();
@@ -133,15 +198,26 @@ void pool_impl::cancel(refptr<task> task_in)
   {
     if (*it == task_in)
     {
+     task_in->set_status(taskstatus_canceled);
+     m_task_queue_times.erase(m_task_queue_times.begin() + (it - m_task_queue.begin()));
      m_task_queue.erase(it);            // Mod
+     canceled = 1;
      break;
     }
   }
+  if (canceled)
+  {
+    m_stats.tasks_canceled++;
+    m_stats_dirty = 1;
+  }
   m_cstask_queue.unlock();
   m_cstasks_running.unlock();
+
+  if (canceled)
+    _notify_status(task_in, taskstatus_canceled);
 }
 
-int pool_impl::is_running(refptr<task> task_in)
+int pool_impl::is_running(const refptr<task>& task_in)
 {
   int ret = 0;
   m_cstasks_running.lock();
@@ -152,7 +228,7 @@ int pool_impl::is_running(refptr<task> task_in)
   return ret;
 }
 
-int pool_impl::is_queued(refptr<task> task_in)
+int pool_impl::is_queued(const refptr<task>& task_in)
 {
   int ret = 0;
   m_cstask_queue.lock();
@@ -169,7 +245,7 @@ int pool_impl::is_queued(refptr<task> task_in)
   return ret;
 }
 
-int pool_impl::is_running_or_queued(refptr<task> task_in)
+int pool_impl::is_running_or_queued(const refptr<task>& task_in)
 {
   int ret = 0;
   m_cstasks_running.lock();
@@ -197,12 +273,13 @@ void pool_impl::clear_all()
   m_cstasks_running.lock();
   for (std::map<refptr<task>, task_info>::iterator it = m_tasks_running.begin();
     it != m_tasks_running.end(); it++)
-    _cancel_running_task(it->second.hmaster, it->second.htasks);
+    _cancel_running_task(it->second);
   m_tasks_running.clear();
   m_cstasks_running.unlock();
   // clear tasks in queue
   m_cstask_queue.lock();
   m_task_queue.resize(0);
+  m_task_queue_times.resize(0);
   m_cstask_queue.unlock();
   // clear finished tasks
   m_cstask_finished.lock();
@@ -210,6 +287,43 @@ void pool_impl::clear_all()
   m_cstask_finished.unlock();
 }
 
+void pool_impl::use_config(const refptr<config>& config)
+{
+  if (config)
+    config->publish();
+  {
+    auto_criticalsection acs(m_csconfig);
+    m_config = config;
+  }
+
+  // the caches belong to the pool pass, which holds |m_cstasks_running|
+  auto_criticalsection acs(m_cstasks_running);
+  int cache_size = _get_limit(config, CFG_INT_CACHE_SIZE, 0);
+  m_cache.set_capacity(cache_size > 0 ? cache_size : 0);
+  std::string cache_dir;
+  if (config)
+    config->get_strvar_utf8(CFG_STR_CACHE_DIR, cache_dir);
+  if (cache_dir != m_disk_cache.get_directory())
+    m_disk_cache.open(cache_dir);
+  m_disk_cache.set_capacity(_get_limit(config, CFG_INT_DISK_CACHE_SIZE,
+    POOL_DEFAULT_DISK_CACHE_SIZE));
+}
+
+refptr<config> pool_impl::get_config()
+{
+  auto_criticalsection acs(m_csconfig);
+  return m_config;
+}
+
+void pool_impl::get_cache_stats(cache_stats& stats)
+{
+  auto_criticalsection acs(m_cstasks_running);
+  m_cache.get_stats(stats);
+  stats.disk_hits = m_disk_hits;
+  stats.revalidated = m_revalidated;
+  m_disk_cache.get_stats(stats.disk_entries, stats.disk_bytes);
+}
+
 #if defined(_WINDOWS_)
 void pool_impl::_thread_dispatch(void* param)
 #elif defined(_MAC_) || defined(__linux__)
@@ -217,6 +331,9 @@ void* pool_impl::_thread_dispatch(void* param)
 #endif
 {
   static_cast<pool_impl*>(param)->_thread();
+#if defined(_MAC_) || defined(__linux__)
+  return NULL;
+#endif
 }
 
 void pool_impl::_thread()
@@ -233,6 +350,8 @@ void pool_impl::_thread()
   const size_t sleep_period_defined = 5;
   const size_t sleep_period_max = 500;
   int sleep_period = 5;
+
+  SINET_TRACE_THREAD_NAME("sinet pool");
   
 #if defined(_MAC_) || defined(__linux__)
   pthread_mutex_t mut_wait = PTHREAD_MUTEX_INITIALIZER;
@@ -250,80 +369,101 @@ void pool_impl::_thread()
 #if defined(_WINDOWS_)
   while (::WaitForSingleObject(m_stop_event, sleep_period) == WAIT_TIMEOUT)
 #elif defined(_MAC_) || defined(__linux__)
-  while (pthread_cond_timedwait(&m_stop_event, &mut_wait, &timeout) == ETIMEDOUT)
+  while (pthread_cond_timedwait(&m_stop_event, &mut_wait, &timeout) == ETIMEDOUT &&
+    !m_stopping)
 #endif
   {
     // printf("thread fired %d\n", (int)(future_us/1000));
     // thread loop procedure is as follows:
-    // 1. iterate through |m_tasks_running| and try curl_multi_perform
-    //    on all of them, if one's |ti.running_handles| equals 0, move
-    //    it to |m_tasks_finished|
-    // 2. if all tasks' |ti.running_handles| in |m_tasks_running|
-    //    equals 0, go to step 3, otherwise, go back to beginning
-    // 3. check |m_tasks_queued| to see if there are anything left
-    //    should be prepared for running
+    // 1. move tasks from |m_task_queue| to |m_tasks_running| while
+    //    fewer than CFG_INT_MAX_RUNNING_TASKS are running, their
+    //    sessions go into the per-origin queues
+    // 2. refresh the rate limits and start queued sessions within
+    //    the connection and rate limits, retries whose backoff is
+    //    over are queued again first
+    // 3. curl_multi_perform the shared multi handle and collect the
+    //    transfers that are done, failed ones may wait for a retry
+    // 4. move tasks with no session left to |m_task_finished|
+    // 5. report the status changes of the pass, unlocked so that the
+    //    observers may call the pool
+
+    SINET_TRACE_SCOPE("pool pass");
+    {
+      SINET_TRACE_SCOPE("pool lock wait");
+      m_cstasks_running.lock();
+    }
+    m_now_ms = _now_ms();
 
     // step 1.
-    int tasks_still_running = 0;
-    std::vector<std::map<refptr<task>, task_info>::iterator > its_running_toclear;
+    int max_tasks = _get_limit(CFG_INT_MAX_RUNNING_TASKS,
+                               POOL_DEFAULT_MAX_RUNNING_TASKS);
+    m_cstask_queue.lock();
+    while (!m_task_queue.empty() &&
+      (max_tasks <= 0 || (int)m_tasks_running.size() < max_tasks))
+    {
+      refptr<task> task_in = m_task_queue.front();
+      m_task_queue.erase(m_task_queue.begin());
+      task_info& taskinfo = m_tasks_running[task_in];
+      taskinfo.queued_ms = m_task_queue_times.front();
+      m_task_queue_times.erase(m_task_queue_times.begin());
+      _prepare_task(task_in, taskinfo);
+      task_in->set_status(taskstatus_running);
+      m_notices.push_back(std::make_pair(task_in, taskstatus_running));
+      m_stats_dirty = 1;
+    }
+    m_cstask_queue.unlock();
 
-    m_cstasks_running.lock();
-    for (std::map<refptr<task>, task_info>::iterator it = m_tasks_running.begin();
-      it != m_tasks_running.end(); it++)
+    // step 2.
+    _run_timers();
+    _update_rate_limits();
+    _dispatch_sessions();
+    _apply_speed_caps();
+
+    // step 3.
+    if (m_active_total > 0)
     {
-      sleep_period = sleep_period_defined;
-      ::curl_multi_perform(it->second.hmaster, &it->second.running_handle);
-      if (it->second.running_handle == 0)
+      int running_handles = 0;
       {
-        its_running_toclear.push_back(it);  // prepare to remove
-        m_cstask_finished.lock();
-        m_task_finished.push_back(it->first);
-        m_cstask_finished.unlock();
+        SINET_TRACE_SCOPE_ARG("curl_multi_perform", m_active_total);
+        ::curl_multi_perform(m_hmaster, &running_handles);
       }
-      else
-        tasks_still_running++;
+      _collect_finished();
+      // slots freed by finished transfers go to the queues right away
+      _dispatch_sessions();
+      _apply_speed_caps();
     }
-    for (std::vector<std::map<refptr<task>, task_info>::iterator >::iterator it = 
+
+    // step 4.
+    std::vector<std::map<refptr<task>, task_info>::iterator > its_running_toclear;
+    for (std::map<refptr<task>, task_info>::iterator it = m_tasks_running.begin();
+      it != m_tasks_running.end(); it++)
+      if (it->second.running_handle == 0)
+        its_running_toclear.push_back(it);
+    for (std::vector<std::map<refptr<task>, task_info>::iterator >::iterator it =
       its_running_toclear.begin(); it != its_running_toclear.end(); it++)
+      _finish_task(*it);
+
+    if (!m_tasks_running.empty())
+      sleep_period = sleep_period_defined;
+    else if (sleep_period < sleep_period_max)
     {
-      _cancel_running_task((*it)->second.hmaster, (*it)->second.htasks);
-      (*it)->first->set_status(taskstatus_completed);
-      std::vector<int> ids;
-      (*it)->first->get_request_ids(ids);
-      for (std::vector<int>::iterator iit = ids.begin(); iit != ids.end(); iit++)
-      {
-        refptr<request> req = (*it)->first->get_request((*iit));
-        req->close_outfile();
-      }
-      m_tasks_running.erase(*it);
+      sleep_period *= 2;
+      if (sleep_period > sleep_period_max)
+        sleep_period = sleep_period_max;
     }
+
+    if (m_stats_dirty || !m_tasks_running.empty())
+      _publish_stats();
+
+    std::vector<std::pair<refptr<task>, int> > notices;
+    notices.swap(m_notices);
     m_cstasks_running.unlock();
 
-    // step 2.
-    if (tasks_still_running == 0)
-    {
-      // step 3.
-      m_cstasks_running.lock();
-      m_cstask_queue.lock();
-      std::vector<refptr<task> >::iterator it = m_task_queue.begin();
-      if (it != m_task_queue.end())
-      {
-        task_info ti;
-        _prepare_task(*it, ti);
-        ti.running_handle = 1;
-        m_tasks_running[*it] = ti;
-        m_task_queue.erase(it);
-        sleep_period = sleep_period_defined;
-      }
-      else if (sleep_period < sleep_period_max)
-      {
-        sleep_period *= 2;
-        if (sleep_period > sleep_period_max)
-          sleep_period = sleep_period_max;
-      }
-      m_cstask_queue.unlock();
-      m_cstasks_running.unlock();
-    }
+    // step 5. a task canceled meanwhile has been reported by cancel()
+    for (std::vector<std::pair<refptr<task>, int> >::iterator it = notices.begin();
+      it != notices.end(); it++)
+      if (it->first->get_status() == it->second)
+        _notify_status(it->first, it->second);
 
 #if defined(_MAC_) || defined(__linux__)
     gettimeofday(&now, NULL);
@@ -338,141 +478,1361 @@ void pool_impl::_thread()
 #endif
 }
 
-void pool_impl::_prepare_task(refptr<task> task_in, task_info& taskinfo_in_out)
+void pool_impl::_prepare_task(const refptr<task>& task_in, task_info& taskinfo_in_out)
 {
   // things below are bogus curl calls for testing workflow
   // _prepare_task should iterator through all requests in refptr<task>
   // and make corresponding curl calls
+  SINET_TRACE_SCOPE("prepare task");
   std::vector<int> reqids(0);
   
   taskinfo_in_out.running_handle = 0;
+  taskinfo_in_out.active_handle = 0;
+  taskinfo_in_out.send_rate = 0;
+  taskinfo_in_out.owner = task_in.get();
+  task_in->get_callbacks(taskinfo_in_out.callbacks);
+  taskinfo_in_out.progress = -1;
 
-  taskinfo_in_out.hmaster = ::curl_multi_init();
-
-  std::wstring proxyurl, useragent;
+  std::string proxyurl, useragent;
   refptr<config> cfg = task_in->get_config();
   if (cfg)
   {
-    cfg->get_strvar(CFG_STR_PROXY, proxyurl);
-    cfg->get_strvar(CFG_STR_AGENT, useragent);
+    cfg->get_strvar_utf8(CFG_STR_PROXY, proxyurl);
+    cfg->get_strvar_utf8(CFG_STR_AGENT, useragent);
   }
-  
+  refptr<config> pool_cfg = get_config();
+  int task_deadline = _get_timeout(0, cfg, pool_cfg, CFG_INT_TASK_TIMEOUT, 0);
+  int coalesce = _get_limit(pool_cfg, CFG_INT_COALESCE_GETS, POOL_DEFAULT_COALESCE_GETS);
  
   task_in->get_request_ids(reqids);
   
   for (std::vector<int>::iterator it = reqids.begin(); it != reqids.end(); it++)
   {
     refptr<request> req = task_in->get_request(*it);
+    req->set_attempts(0);
+    req->set_request_error(REQ_ERR_NONE);
+
+    // fresh cache hits never reach curl
+    std::vector<std::string> validators;
+    if (_cache_lookup(req, req->get_request_url_utf8(), validators))
+    {
+      m_stats.requests[REQ_ERR_NONE]++;
+      _report_body(taskinfo_in_out, *it, req);
+      continue;
+    }
+
+    session_curl* session = _create_session(task_in, req, taskinfo_in_out);
+    session->request_id = *it;
+    // _open_session adds the request headers after these
+    if (!validators.empty())
+    {
+      for (std::vector<std::string>::iterator vit = validators.begin();
+        vit != validators.end(); vit++)
+        session->headerlist = ::curl_slist_append(session->headerlist, vit->c_str());
+      session->revalidate = 1;
+    }
+
+    // deadlines cover all attempts, so they start with the task
+    int deadline, connect_timeout, first_byte_timeout;
+    req->get_timeouts(deadline, connect_timeout, first_byte_timeout);
+    deadline = _get_timeout(deadline, cfg, pool_cfg, CFG_INT_REQUEST_TIMEOUT, 0);
+    if (deadline > 0)
+      _add_timer(session, m_now_ms + deadline, TIMER_DEADLINE);
+    if (task_deadline > 0)
+      _add_timer(session, m_now_ms + task_deadline, TIMER_TASK_DEADLINE);
+
+    taskinfo_in_out.htasks.push_back(session);
+    taskinfo_in_out.running_handle++;
+    // a follower never needs a curl handle of its own unless its
+    // leader fails to complete
+    if (!coalesce || !_coalesce(session, proxyurl, useragent))
+      _start_session(session);
+  }
+}
+
+pool_impl::session_curl* pool_impl::_create_session(const refptr<task>& task_in,
+                                                    const refptr<request>& req,
+                                                    task_info& taskinfo_in)
+{
+  session_curl* session = new session_curl;
+  session_curl& scurl = *session;
+  scurl.hcurl = NULL;
+  scurl.post = NULL;
+  scurl.last = NULL;
+  scurl.headerlist = NULL;
+  scurl.owner = task_in;
+  scurl.req = req;
+  scurl.request_id = 0;
+  scurl.state = SESSION_QUEUED;
+  scurl.pool = this;
+  scurl.info = &taskinfo_in;
+  scurl.max_recv = 0;
+  scurl.max_send = 0;
+  scurl.attempts = 0;
+  scurl.first_byte = 0;
+  scurl.primary = NULL;
+  scurl.hedge = NULL;
+  scurl.leader = NULL;
+  scurl.revalidate = 0;
+
+  int deadline, connect_timeout, first_byte_timeout;
+  req->get_timeouts(deadline, connect_timeout, first_byte_timeout);
+  scurl.first_byte_timeout = _get_timeout(first_byte_timeout, task_in->get_config(),
+    get_config(), CFG_INT_FIRST_BYTE_TIMEOUT, 0);
+
+  url request_url;
+  req->get_request_url(request_url);
+  scurl.spec = request_url.get_spec();
+  scurl.origin = request_url.get_origin();
+  return session;
+}
+
+int pool_impl::_open_session(session_curl* session)
+{
+  std::string proxyurl, useragent;
+  refptr<config> cfg = session->owner->get_config();
+  if (cfg)
+  {
+    cfg->get_strvar_utf8(CFG_STR_PROXY, proxyurl);
+    cfg->get_strvar_utf8(CFG_STR_AGENT, useragent);
+  }
+  refptr<config> pool_cfg = get_config();
+
+  CURL* curl = ::curl_easy_init();
+  if (!curl)
+    return 0;
+
+  session_curl& scurl = *session;
+  refptr<request> req = scurl.req;
+  scurl.hcurl = curl;
+
+  // connect and low speed timeouts are left to curl, deadlines and
+  // the first byte timeout run on the pool timers
+  int deadline, connect_timeout, first_byte_timeout;
+  int low_speed_limit, low_speed_time;
+  req->get_timeouts(deadline, connect_timeout, first_byte_timeout);
+  req->get_low_speed(low_speed_limit, low_speed_time);
+  connect_timeout = _get_timeout(connect_timeout, cfg, pool_cfg,
+    CFG_INT_CONNECT_TIMEOUT, POOL_DEFAULT_CONNECT_TIMEOUT);
+  low_speed_limit = _get_timeout(low_speed_limit, cfg, pool_cfg,
+    CFG_INT_LOW_SPEED_LIMIT, POOL_DEFAULT_LOW_SPEED_LIMIT);
+  low_speed_time = _get_timeout(low_speed_time, cfg, pool_cfg,
+    CFG_INT_LOW_SPEED_TIME, POOL_DEFAULT_LOW_SPEED_TIME);
+  if (connect_timeout > 0)
+    ::curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, (long)connect_timeout);
+  if (low_speed_limit > 0 && low_speed_time > 0)
+  {
+    ::curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, (long)low_speed_limit);
+    ::curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)low_speed_time);
+  }
+
+  ::curl_easy_setopt(curl, CURLOPT_PRIVATE, (char*)session);
+  ::curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_header_callback);
+  ::curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)session);
+  ::curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_mem_callback);
+  ::curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)session);
+  ::curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+  ::curl_easy_setopt(curl, CURLOPT_URL, scurl.spec.c_str());
+
+  // set the proxy
+  if (!proxyurl.empty())
+    ::curl_easy_setopt(curl, CURLOPT_PROXY, proxyurl.c_str());
+
+  // set the ssl
+  ::curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+
+  // set header
+  bool useagent = false;
+  si_stringmap_utf8 header = req->get_request_header_utf8();
+  for (si_stringmap_utf8::iterator it = header.begin(); it != header.end(); it++)
+  {
+    std::string item;
+    // format:
+    // host:shooter.cn
+    item = (*it).first + ":" + (*it).second;
+    scurl.headerlist = ::curl_slist_append(scurl.headerlist, item.c_str());
     
-    session_curl scurl;
+    std::string headerkey = (*it).first;
+    std::transform(headerkey.begin(), headerkey.end(), headerkey.begin(), ::tolower);
+    if (headerkey == "user-agent")
+      useagent = true;
+  }
+
+  if (!useagent && !useragent.empty())
+    ::curl_easy_setopt(curl, CURLOPT_USERAGENT, useragent.c_str());
+
+  std::string reqmethod = req->get_request_method_utf8();
+  if (reqmethod == REQ_GET_UTF8)
+  {
+    ;
+  }
+  else if (reqmethod == REQ_POST_UTF8)
+  {
+    std::vector<refptr<postdataelem> > elems;
+    refptr<postdata> postdata = req->get_postdata();
+    postdata->get_elements(elems);
+
+    // make a post form
+    for (std::vector<refptr<postdataelem> >::iterator it = elems.begin(); it != elems.end(); it++)
+    {
+      postdataelem_type_t elemtype = (*it)->get_type();
+      std::string name = (*it)->get_name_utf8();
+
+      if (elemtype == PDE_TYPE_TEXT)
+      {
+        std::string cont = (*it)->get_text_utf8();
+        ::curl_formadd(&scurl.post, &scurl.last, CURLFORM_COPYNAME, name.c_str(), 
+                        CURLFORM_COPYCONTENTS, cont.c_str(), CURLFORM_END);
+      }
+      else if (elemtype == PDE_TYPE_FILE)
+      {
+        std::string cont = (*it)->get_file_utf8();
+        ::curl_formadd(&scurl.post, &scurl.last, CURLFORM_COPYNAME, name.c_str(),
+                        CURLFORM_FILE, cont.c_str(), CURLFORM_END);
+      }
+      else if (elemtype == PDE_TYPE_BYTES)
+      {
+        size_t buffsize = (*it)->get_buffer_size();
+        void* buffer = malloc(buffsize);
+        (*it)->copy_buffer_to(buffer, buffsize);
+        
+        std::string cont = (*it)->get_text_utf8();
+
+        ::curl_formadd(&scurl.post, &scurl.last, CURLFORM_COPYNAME, name.c_str(), CURLFORM_BUFFER, cont.c_str(), CURLFORM_BUFFERPTR,
+          (char*)buffer, CURLFORM_BUFFERLENGTH, buffsize, CURLFORM_END);
+
+        scurl.bufs.push_back(buffer);
+      }
+
+      ::curl_easy_setopt(curl, CURLOPT_HTTPPOST, scurl.post);
+    }
+  }
+  ::curl_easy_setopt(curl, CURLOPT_HTTPHEADER, scurl.headerlist);
+  return 1;
+}
+
+void pool_impl::_cancel_running_task(task_info& taskinfo_in)
+{
+  std::vector<session_curl*> sessions;
+  sessions.swap(taskinfo_in.htasks);
+  for (std::vector<session_curl*>::iterator it = sessions.begin();
+    it != sessions.end(); it++)
+    _free_session(*it);
+  taskinfo_in.running_handle = 0;
+}
+
+void pool_impl::_start_session(session_curl* session)
+{
+  if (!session->hcurl && !_open_session(session))
+  {
+    session->req->set_request_error(REQ_ERR_OTHER);
+    _session_done(session);
+    return;
+  }
+  _queue_session(session);
+}
+
+void pool_impl::_queue_session(session_curl* session)
+{
+  std::deque<session_curl*>& queue = m_origin_queues[session->origin];
+  if (queue.empty())
+    m_origin_order.push_back(session->origin);
+  queue.push_back(session);
+  session->state = SESSION_QUEUED;
+}
+
+void pool_impl::_dispatch_sessions()
+{
+  SINET_TRACE_SCOPE("dispatch sessions");
+  int max_host = _get_limit(CFG_INT_MAX_HOST_CONNECTIONS,
+                            POOL_DEFAULT_MAX_HOST_CONNECTIONS);
+  int max_total = _get_limit(CFG_INT_MAX_TOTAL_CONNECTIONS,
+                             POOL_DEFAULT_MAX_TOTAL_CONNECTIONS);
+
+  // take one session from each origin per turn, so a long queue for
+  // one host does not hold back the others. Stop after a full turn
+  // without starting anything.
+  size_t origins_skipped = 0;
+  while (!m_origin_order.empty() && origins_skipped < m_origin_order.size())
+  {
+    if (max_total > 0 && m_active_total >= max_total)
+      break;
+    // admission control, nothing starts while the pool is over its rate
+    if (!m_request_bucket.available(1) || !m_recv_bucket.available(1))
+      break;
+
+    std::string origin = m_origin_order.front();
+    m_origin_order.pop_front();
+
+    std::map<std::string, std::deque<session_curl*> >::iterator qit =
+      m_origin_queues.find(origin);
+    if (qit == m_origin_queues.end())
+      continue;
+
+    int& origin_active = m_origin_active[origin];
+    if (max_host > 0 && origin_active >= max_host)
+    {
+      m_origin_order.push_back(origin);
+      origins_skipped++;
+      continue;
+    }
+
+    // a task over its own rate only holds back its origin for this turn
+    session_curl* session = qit->second.front();
+    if (!session->info->request_bucket.available(1) ||
+      !session->info->recv_bucket.available(1))
+    {
+      m_origin_order.push_back(origin);
+      origins_skipped++;
+      continue;
+    }
+
+    qit->second.pop_front();
+    if (qit->second.empty())
+      m_origin_queues.erase(qit);
+    else
+      m_origin_order.push_back(origin);
+
+    ::curl_multi_add_handle(m_hmaster, session->hcurl);
+    session->state = SESSION_ACTIVE;
+    session->req->set_attempts(++session->attempts);
+    session->first_byte = 0;
+    session->attempt_start = m_now_ms;
+    // a hedge neither waited in the queue nor is a retry
+    m_stats.transfers++;
+    if (!session->primary && session->attempts == 1)
+      histogram_record(m_stats.queue_wait, (m_now_ms - session->info->queued_ms) * 1000);
+    else if (!session->primary)
+      m_stats.retries++;
+    if (session->first_byte_timeout > 0)
+      _add_timer(session, m_now_ms + session->first_byte_timeout, TIMER_FIRST_BYTE);
+    int hedge_delay = _hedge_delay(session);
+    if (hedge_delay >= 0)
+      _add_timer(session, m_now_ms + hedge_delay, TIMER_HEDGE);
+    origin_active++;
+    m_active_total++;
+    session->info->active_handle++;
+    m_request_bucket.consume(1);
+    session->info->request_bucket.consume(1);
+    m_caps_dirty = 1;
+    origins_skipped = 0;
+  }
+}
+
+void pool_impl::_collect_finished()
+{
+  SINET_TRACE_SCOPE("collect finished");
+  CURLMsg* msg;
+  int msgs_left;
+  while ((msg = ::curl_multi_info_read(m_hmaster, &msgs_left)) != NULL)
+  {
+    if (msg->msg != CURLMSG_DONE)
+      continue;
+
+    session_curl* session = NULL;
+    ::curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&session);
+    if (!session || session->state != SESSION_ACTIVE)
+      continue;
+
+    CURLcode result = msg->data.result;
+    _detach_session(session);
+    _record_transfer(session);
+
+    int error = _request_error(result);
+    if (result == CURLE_OPERATION_TIMEDOUT)
+    {
+      // curl only runs the connect timeout and the low speed limit, a
+      // transfer that got past pretransfer was connected
+      double pretransfer = 0;
+      ::curl_easy_getinfo(session->hcurl, CURLINFO_PRETRANSFER_TIME, &pretransfer);
+      error = pretransfer > 0 ? REQ_ERR_STALLED : REQ_ERR_CONNECT_TIMEOUT;
+    }
+    long status = 0;
+    ::curl_easy_getinfo(session->hcurl, CURLINFO_RESPONSE_CODE, &status);
+    _end_attempt(session, error, status);
+  }
+}
+
+void pool_impl::_end_attempt(session_curl* session, int error, long status)
+{
+  if (session->primary)
+  {
+    // a hedge only counts when it got an answer, otherwise the
+    // primary carries on alone
+    if (error == REQ_ERR_NONE && status >= 200 && status < 400)
+      _hedge_won(session);
+    else
+      _drop_hedge(session->primary);
+    return;
+  }
+  if (session->hedge)
+    _drop_hedge(session);
+
+  _remove_timers(session, TIMER_FIRST_BYTE);
+  _remove_timers(session, TIMER_HEDGE);
+  session->req->set_request_error(error);
+
+  int delay = _retry_delay(session->req, session->attempts, error, status,
+    m_rand_seed);
+  if (delay >= 0)
+  {
+    // the easy handle keeps its options, adding it again restarts
+    // the transfer
+    session->req->reset_response();
+    session->state = SESSION_WAITING;
+    _add_timer(session, m_now_ms + delay, TIMER_RETRY);
+    return;
+  }
+  _session_done(session);
+}
+
+void pool_impl::_session_done(session_curl* session)
+{
+  if (session->hedge)
+    _drop_hedge(session);
+  _remove_timers(session, TIMER_ALL);
+  session->state = SESSION_DONE;
+  session->info->running_handle--;
+  // followers and hedges made no transfer of their own
+  if (session->attempts > 0)
+    _cache_store(session);
+
+  // a deadline belongs to the leader's request, not to its followers
+  int error = session->req->get_request_error();
+  if (error >= 0 && error < REQ_ERR_COUNT)
+    m_stats.requests[error]++;
+  if (error == REQ_ERR_DEADLINE || error == REQ_ERR_TASK_DEADLINE)
+    _promote_follower(session);
+  else
+    _fan_out(session);
+}
+
+void pool_impl::_detach_session(session_curl* session)
+{
+  if (session->state == SESSION_FOLLOWING)
+  {
+    std::vector<session_curl*>& followers = session->leader->followers;
+    followers.erase(std::find(followers.begin(), followers.end(), session));
+    session->leader = NULL;
+  }
+  else if (session->state == SESSION_ACTIVE)
+  {
+    ::curl_multi_remove_handle(m_hmaster, session->hcurl);
+    m_active_total--;
+    if (--m_origin_active[session->origin] <= 0)
+      m_origin_active.erase(session->origin);
+    session->info->active_handle--;
+    m_caps_dirty = 1;
+  }
+  else if (session->state == SESSION_QUEUED)
+  {
+    std::map<std::string, std::deque<session_curl*> >::iterator qit =
+      m_origin_queues.find(session->origin);
+    if (qit != m_origin_queues.end())
+    {
+      std::deque<session_curl*>::iterator sit =
+        std::find(qit->second.begin(), qit->second.end(), session);
+      if (sit != qit->second.end())
+        qit->second.erase(sit);
+      if (qit->second.empty())
+      {
+        m_origin_queues.erase(qit);
+        std::deque<std::string>::iterator oit =
+          std::find(m_origin_order.begin(), m_origin_order.end(), session->origin);
+        if (oit != m_origin_order.end())
+          m_origin_order.erase(oit);
+      }
+    }
+  }
+  if (session->state != SESSION_DONE)
+    session->state = SESSION_WAITING;
+}
+
+void pool_impl::_free_session(session_curl* session)
+{
+  // a canceled transfer keeps the timing of how far it got
+  if (session->state == SESSION_ACTIVE)
+    _record_transfer(session);
+  if (session->state != SESSION_DONE)
+  {
+    session->req->set_request_error(REQ_ERR_CANCELED);
+    if (!session->primary)
+      m_stats.requests[REQ_ERR_CANCELED]++;
+  }
+  _detach_session(session);
+  _remove_timers(session, TIMER_ALL);
+  _promote_follower(session);
+  if (session->primary)
+    session->primary->hedge = NULL;
+  if (session->hedge)
+    session->hedge->primary = NULL;
+
+  ::curl_easy_cleanup(session->hcurl);
+  ::curl_formfree(session->post);
+  ::curl_slist_free_all(session->headerlist);
+  for (std::vector<void*>::iterator bfit = session->bufs.begin(); bfit != session->bufs.end(); bfit++)
+    free((*bfit));
+  delete session;
+}
+
+void pool_impl::_finish_task(std::map<refptr<task>, task_info>::iterator it)
+{
+  _cancel_running_task(it->second);
+  it->first->set_status(taskstatus_completed);
+  std::vector<int> ids;
+  it->first->get_request_ids(ids);
+  for (std::vector<int>::iterator iit = ids.begin(); iit != ids.end(); iit++)
+  {
+    refptr<request> req = it->first->get_request((*iit));
+    req->close_outfile();
+  }
+  m_cstask_finished.lock();
+  m_task_finished.push_back(it->first);
+  m_cstask_finished.unlock();
+  m_notices.push_back(std::make_pair(it->first, taskstatus_completed));
+  m_tasks_running.erase(it);
+  m_stats.tasks_completed++;
+  m_stats_dirty = 1;
+}
+
+// seconds from curl as microseconds
+static long long curl_us(double seconds)
+{
+  return (long long)(seconds * 1000000);
+}
+
+void pool_impl::_record_transfer(session_curl* session)
+{
+  CURL* curl = session->hcurl;
+  double namelookup = 0, connect = 0, appconnect = 0, pretransfer = 0;
+  double starttransfer = 0, total = 0;
+  long connects = 0, header_size = 0, request_size = 0;
+  ::curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &namelookup);
+  ::curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connect);
+  ::curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &appconnect);
+  ::curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME, &pretransfer);
+  ::curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &starttransfer);
+  ::curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total);
+#if LIBCURL_VERSION_NUM >= 0x073700
+  // the byte counts without the double, which 7.55.0 deprecates
+  curl_off_t downloaded = 0, uploaded = 0;
+  ::curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+  ::curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+#else
+  double downloaded = 0, uploaded = 0;
+  ::curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &downloaded);
+  ::curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD, &uploaded);
+#endif
+  ::curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+  ::curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &header_size);
+  ::curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &request_size);
+
+  request_timing timing;
+  memset(&timing, 0, sizeof(timing));
+  timing.queued_ms = session->info->queued_ms;
+  timing.started_ms = session->attempt_start;
+  timing.namelookup = curl_us(namelookup);
+  timing.connect = curl_us(connect);
+  timing.appconnect = curl_us(appconnect);
+  timing.pretransfer = curl_us(pretransfer);
+  timing.starttransfer = curl_us(starttransfer);
+  timing.total = curl_us(total);
+  long redirects = 0;
+  ::curl_easy_getinfo(curl, CURLINFO_REDIRECT_COUNT, &redirects);
+  timing.redirects = (int)redirects;
+  timing.reused = (connects == 0 && pretransfer > 0) ? 1 : 0;
+  char* ip = NULL;
+  if (::curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &ip) == CURLE_OK && ip)
+    strncpy(timing.primary_ip, ip, sizeof(timing.primary_ip) - 1);
+  session->req->set_timing(timing);
+  char* effective_url = NULL;
+  if (::curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url) == CURLE_OK && effective_url)
+    session->req->set_effective_url_utf8(effective_url);
+
+  m_stats.bytes_received += header_size + (long long)downloaded;
+  m_stats.bytes_sent += request_size + (long long)uploaded;
+  // curl's times add up from the start of the attempt
+  if (connects > 0)
+  {
+    m_stats.connections_opened++;
+    if (namelookup > 0)
+    {
+      m_stats.dns_lookups++;
+      histogram_record(m_stats.dns, curl_us(namelookup));
+    }
+    if (connect > 0)
+      histogram_record(m_stats.connect, curl_us(connect - namelookup));
+    if (appconnect > 0)
+    {
+      m_stats.tls_handshakes++;
+      histogram_record(m_stats.tls, curl_us(appconnect - connect));
+    }
+  }
+  // an attempt that failed before it had a connection reused none
+  else if (timing.reused)
+    m_stats.connections_reused++;
+  if (starttransfer > 0)
+    histogram_record(m_stats.ttfb, curl_us(starttransfer - pretransfer));
+  histogram_record(m_stats.total, curl_us(total));
+}
+
+void pool_impl::_publish_stats()
+{
+  m_stats.tasks_running = (int)m_tasks_running.size();
+  m_stats.transfers_active = m_active_total;
+  m_stats.transfers_waiting = 0;
+  for (std::map<std::string, std::deque<session_curl*> >::iterator it =
+    m_origin_queues.begin(); it != m_origin_queues.end(); it++)
+    m_stats.transfers_waiting += (int)it->second.size();
+  m_stats_dirty = 0;
 
-    CURL* curl = ::curl_easy_init();
-    if (!curl)
+  auto_criticalsection acs(m_csstats);
+  m_stats_published = m_stats;
+}
+
+void pool_impl::get_stats(pool_stats& stats)
+{
+  m_csstats.lock();
+  stats = m_stats_published;
+  m_csstats.unlock();
+  // the queue is counted by the callers of execute()
+  auto_criticalsection acs(m_cstask_queue);
+  stats.tasks_executed = m_tasks_executed;
+  stats.tasks_queued = (int)m_task_queue.size();
+}
+
+void pool_impl::_report_data(task_info& taskinfo_in, int request_id, size_t offset,
+                             const void* data, size_t size)
+{
+  SINET_TRACE_SCOPE_ARG("report data", size);
+  task_callbacks& callbacks = taskinfo_in.callbacks;
+  if (callbacks.on_data)
+    callbacks.on_data(callbacks.user, request_id, offset, data, size);
+
+  itask_observer* observer = taskinfo_in.owner->get_observer();
+  if (!observer && !callbacks.on_progress)
+    return;
+
+  // requests with no Content-Length yet don't count
+  double expected = 0, received = 0;
+  std::vector<int> ids;
+  taskinfo_in.owner->get_request_ids(ids);
+  for (std::vector<int>::iterator it = ids.begin(); it != ids.end(); it++)
+  {
+    refptr<request> req = taskinfo_in.owner->get_request(*it);
+    size_t total = req->get_response_size();
+    if (total == 0)
       continue;
+    size_t retrieved = req->get_retrieved_size();
+    expected += (double)total;
+    received += (double)(retrieved < total ? retrieved : total);
+  }
+  if (expected <= 0)
+    return;
+  int progress = (int)(received * 100 / expected);
+  if (progress == taskinfo_in.progress)
+    return;
+  taskinfo_in.progress = progress;
+  if (observer)
+    observer->progress_change(progress);
+  if (callbacks.on_progress)
+    callbacks.on_progress(callbacks.user, progress);
+}
 
-    scurl.hcurl = curl;
-    scurl.post = NULL;
-    scurl.last = NULL;
-    scurl.headerlist = NULL;
-
-    ::curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_header_callback);
-    ::curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)req.get());
-    ::curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_mem_callback);
-    ::curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)req.get());
-    ::curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-    ::curl_easy_setopt(curl, CURLOPT_URL, strings::wstring_utf8string(req->get_request_url()).c_str());
-
-    // set the proxy
-    if (!proxyurl.empty())
-      ::curl_easy_setopt(curl, CURLOPT_PROXY, strings::wstring_utf8string(proxyurl).c_str());
-
-    // set the ssl
-    ::curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-
-    // set header
-    bool useagent = false;
-    si_stringmap header = req->get_request_header();
-    for (si_stringmap::iterator it = header.begin(); it != header.end(); it++)
+void pool_impl::_report_body(task_info& taskinfo_in, int request_id,
+                             const refptr<request>& req, size_t offset)
+{
+  if (req->get_request_outmode() == REQ_OUTBUFFER)
+  {
+    refptr<shared_buffer> body = req->lease_response_buffer();
+    if (body->get_size() > offset)
+      _report_data(taskinfo_in, request_id, offset,
+        body->get_data() + offset, body->get_size() - offset);
+    return;
+  }
+
+  // a body written to the out file is flushed and read back
+  req->close_outfile();
+#if defined(_WINDOWS_)
+  FILE* in = ::_wfopen(req->get_outfile().c_str(), L"rb");
+#elif defined(_MAC_) || defined(__linux__)
+  FILE* in = ::fopen(req->get_outfile_utf8().c_str(), "rb");
+#endif
+  if (!in)
+    return;
+  if (offset == 0 || fseek(in, (long)offset, SEEK_SET) == 0)
+  {
+    char chunk[65536];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), in)) > 0)
     {
-      std::wstring item;
-      // format:
-      // host:shooter.cn
-      item = (*it).first + L":" + (*it).second;
-      scurl.headerlist = ::curl_slist_append(scurl.headerlist, strings::wstring_utf8string(item).c_str());
-      
-      std::wstring headerkey = (*it).first;
-      std::transform(headerkey.begin(), headerkey.end(), headerkey.begin(), towlower);
-      if (headerkey == L"user-agent")
-        useagent = true;
+      _report_data(taskinfo_in, request_id, offset, chunk, read);
+      offset += read;
     }
+  }
+  fclose(in);
+}
 
-    if (!useagent && !useragent.empty())
-      ::curl_easy_setopt(curl, CURLOPT_USERAGENT, strings::wstring_utf8string(useragent).c_str());
+void pool_impl::_notify_status(const refptr<task>& task_in, int status)
+{
+  SINET_TRACE_SCOPE_ARG("notify status", status);
+  itask_observer* observer = task_in->get_observer();
+  if (observer)
+    observer->status_change(status);
+  task_callbacks callbacks;
+  task_in->get_callbacks(callbacks);
+  if (callbacks.on_status)
+    callbacks.on_status(callbacks.user, status);
+  if (status == taskstatus_completed || status == taskstatus_canceled)
+    _signal_finished();
+}
 
-    std::wstring reqmethod = req->get_request_method();
-    if (reqmethod == REQ_GET)
+intptr_t pool_impl::get_event_fd()
+{
+  auto_criticalsection acs(m_cstask_finished);
+#if defined(_WINDOWS_)
+  if (!m_finished_event)
+    m_finished_event = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+  return m_finished_event ? (intptr_t)m_finished_event : -1;
+#elif defined(_MAC_) || defined(__linux__)
+  if (m_finished_pipe[0] < 0 && ::pipe(m_finished_pipe) == 0)
+  {
+    // the pool never blocks on a full pipe, the reader is woken anyway
+    for (int i = 0; i < 2; i++)
     {
-      ;
+      ::fcntl(m_finished_pipe[i], F_SETFL, ::fcntl(m_finished_pipe[i], F_GETFL) | O_NONBLOCK);
+      ::fcntl(m_finished_pipe[i], F_SETFD, FD_CLOEXEC);
     }
-    else if (reqmethod == REQ_POST)
+  }
+  return m_finished_pipe[0];
+#endif
+}
+
+void pool_impl::_signal_finished()
+{
+  auto_criticalsection acs(m_cstask_finished);
+#if defined(_WINDOWS_)
+  if (m_finished_event)
+    ::SetEvent(m_finished_event);
+#elif defined(_MAC_) || defined(__linux__)
+  if (m_finished_pipe[1] >= 0)
+  {
+    char c = 0;
+    if (::write(m_finished_pipe[1], &c, 1) < 0)
+      return;
+  }
+#endif
+}
+
+int pool_impl::_get_limit(int id, int default_value)
+{
+  return _get_limit(get_config(), id, default_value);
+}
+
+int pool_impl::_get_limit(const refptr<config>& cfg, int id, int default_value)
+{
+  int value = default_value;
+  if (cfg)
+    cfg->get_intvar(id, value);
+  return value;
+}
+
+int pool_impl::_get_timeout(int value, const refptr<config>& task_cfg,
+                            const refptr<config>& pool_cfg, int id, int default_value)
+{
+  if (value == 0 && !(task_cfg && task_cfg->get_intvar(id, value)))
+    value = _get_limit(pool_cfg, id, default_value);
+  return value > 0 ? value : 0;
+}
+
+void pool_impl::_account_received(session_curl* session, size_t size)
+{
+  m_recv_bucket.consume((double)size);
+  session->info->recv_bucket.consume((double)size);
+}
+
+void pool_impl::_data_received(session_curl* session, const void* data, size_t size)
+{
+  // a hedge writes to a request of its own, its body is reported in
+  // one piece if it wins
+  if (session->primary || size == 0)
+    return;
+  size_t retrieved = session->req->get_retrieved_size();
+  _report_data(*session->info, session->request_id, retrieved - size, data, size);
+}
+
+void pool_impl::_update_rate_limits()
+{
+  refptr<config> cfg = get_config();
+  int recv_rate = m_recv_bucket.get_rate();
+  m_request_bucket.set_rate(_get_limit(cfg, CFG_INT_MAX_REQUEST_RATE, 0), m_now_ms);
+  m_recv_bucket.set_rate(_get_limit(cfg, CFG_INT_MAX_RECV_SPEED, 0), m_now_ms);
+  int send_rate = _get_limit(cfg, CFG_INT_MAX_SEND_SPEED, 0);
+  if (recv_rate != m_recv_bucket.get_rate() || send_rate != m_send_rate)
+    m_caps_dirty = 1;
+  m_send_rate = send_rate;
+  m_request_bucket.refill(m_now_ms);
+  m_recv_bucket.refill(m_now_ms);
+
+  for (std::map<refptr<task>, task_info>::iterator it = m_tasks_running.begin();
+    it != m_tasks_running.end(); it++)
+  {
+    task_info& ti = it->second;
+    cfg = it->first->get_config();
+    recv_rate = ti.recv_bucket.get_rate();
+    ti.request_bucket.set_rate(_get_limit(cfg, CFG_INT_MAX_REQUEST_RATE, 0), m_now_ms);
+    ti.recv_bucket.set_rate(_get_limit(cfg, CFG_INT_MAX_RECV_SPEED, 0), m_now_ms);
+    send_rate = _get_limit(cfg, CFG_INT_MAX_SEND_SPEED, 0);
+    if (recv_rate != ti.recv_bucket.get_rate() || send_rate != ti.send_rate)
+      m_caps_dirty = 1;
+    ti.send_rate = send_rate;
+    ti.request_bucket.refill(m_now_ms);
+    ti.recv_bucket.refill(m_now_ms);
+  }
+}
+
+// @returns the per-transfer share of the pool and task rates, 0 if
+//          neither is limited
+static long long split_rate(int pool_rate, int pool_active, int task_rate, int task_active)
+{
+  long long cap = 0;
+  if (pool_rate > 0 && pool_active > 0)
+    cap = pool_rate / pool_active;
+  if (task_rate > 0 && task_active > 0)
+  {
+    long long task_cap = task_rate / task_active;
+    if (cap == 0 || task_cap < cap)
+      cap = task_cap;
+  }
+  // curl takes 0 as no limit
+  if (cap == 0 && (pool_rate > 0 || task_rate > 0))
+    cap = 1;
+  return cap;
+}
+
+void pool_impl::_apply_speed_caps()
+{
+  if (!m_caps_dirty)
+    return;
+  m_caps_dirty = 0;
+
+  for (std::map<refptr<task>, task_info>::iterator it = m_tasks_running.begin();
+    it != m_tasks_running.end(); it++)
+  {
+    task_info& ti = it->second;
+    for (std::vector<session_curl*>::iterator sit = ti.htasks.begin();
+      sit != ti.htasks.end(); sit++)
     {
-      std::vector<refptr<postdataelem> > elems;
-      refptr<postdata> postdata = req->get_postdata();
-      postdata->get_elements(elems);
+      session_curl* session = *sit;
+      if (session->state != SESSION_ACTIVE)
+        continue;
+      long long max_recv = split_rate(m_recv_bucket.get_rate(), m_active_total,
+                                      ti.recv_bucket.get_rate(), ti.active_handle);
+      long long max_send = split_rate(m_send_rate, m_active_total,
+                                      ti.send_rate, ti.active_handle);
+      if (max_recv != session->max_recv)
+      {
+        ::curl_easy_setopt(session->hcurl, CURLOPT_MAX_RECV_SPEED_LARGE, (curl_off_t)max_recv);
+        session->max_recv = max_recv;
+      }
+      if (max_send != session->max_send)
+      {
+        ::curl_easy_setopt(session->hcurl, CURLOPT_MAX_SEND_SPEED_LARGE, (curl_off_t)max_send);
+        session->max_send = max_send;
+      }
+    }
+  }
+}
+
+void pool_impl::_add_timer(session_curl* session, long long due_ms, int kind)
+{
+  timer_entry entry;
+  entry.session = session;
+  entry.kind = kind;
+  session->timers.push_back(m_timers.insert(std::make_pair(due_ms, entry)));
+}
+
+void pool_impl::_remove_timers(session_curl* session, int kind)
+{
+  std::vector<timer_queue::iterator>& timers = session->timers;
+  for (size_t i = 0; i < timers.size(); )
+  {
+    if (kind == TIMER_ALL || timers[i]->second.kind == kind)
+    {
+      m_timers.erase(timers[i]);
+      timers.erase(timers.begin() + i);
+    }
+    else
+      i++;
+  }
+}
 
-      // make a post form
-      for (std::vector<refptr<postdataelem> >::iterator it = elems.begin(); it != elems.end(); it++)
+void pool_impl::_run_timers()
+{
+  while (!m_timers.empty() && m_timers.begin()->first <= m_now_ms)
+  {
+    timer_queue::iterator it = m_timers.begin();
+    timer_entry entry = it->second;
+    std::vector<timer_queue::iterator>& timers = entry.session->timers;
+    timers.erase(std::find(timers.begin(), timers.end(), it));
+    m_timers.erase(it);
+
+    session_curl* session = entry.session;
+    switch (entry.kind)
+    {
+    case TIMER_RETRY:
+      _queue_session(session);
+      break;
+    case TIMER_DEADLINE:
+    case TIMER_TASK_DEADLINE:
+      // queued, running and waiting sessions all end here
+      _detach_session(session);
+      session->req->set_request_error(entry.kind == TIMER_DEADLINE ?
+        REQ_ERR_DEADLINE : REQ_ERR_TASK_DEADLINE);
+      _session_done(session);
+      break;
+    case TIMER_FIRST_BYTE:
+      if (session->state == SESSION_ACTIVE && !session->first_byte)
       {
-        postdataelem_type_t elemtype = (*it)->get_type();
-        std::string name = strings::wstring_utf8string((*it)->get_name());
-
-        if (elemtype == PDE_TYPE_TEXT)
-        {
-          std::string cont = strings::wstring_utf8string((*it)->get_text());
-          ::curl_formadd(&scurl.post, &scurl.last, CURLFORM_COPYNAME, name.c_str(), 
-                          CURLFORM_COPYCONTENTS, cont.c_str(), CURLFORM_END);
-        }
-        else if (elemtype == PDE_TYPE_FILE)
-        {
-          std::string cont = strings::wstring_utf8string((*it)->get_file());
-          ::curl_formadd(&scurl.post, &scurl.last, CURLFORM_COPYNAME, name.c_str(),
-                          CURLFORM_FILE, cont.c_str(), CURLFORM_END);
-        }
-        else if (elemtype == PDE_TYPE_BYTES)
-        {
-          size_t buffsize = (*it)->get_buffer_size();
-          void* buffer = malloc(buffsize);
-          (*it)->copy_buffer_to(buffer, buffsize);
-          
-          std::string cont = strings::wstring_utf8string((*it)->get_text());
-
-          ::curl_formadd(&scurl.post, &scurl.last, CURLFORM_COPYNAME, name.c_str(), CURLFORM_BUFFER, cont.c_str(), CURLFORM_BUFFERPTR,
-            (char*)buffer, CURLFORM_BUFFERLENGTH, buffsize, CURLFORM_END);
-
-          scurl.bufs.push_back(buffer);
-        }
-
-        ::curl_easy_setopt(curl, CURLOPT_HTTPPOST, scurl.post);
+        _detach_session(session);
+        _end_attempt(session, REQ_ERR_FIRST_BYTE_TIMEOUT, 0);
       }
+      break;
+    case TIMER_HEDGE:
+      if (session->state == SESSION_ACTIVE && !session->first_byte && !session->hedge)
+        _start_hedge(session);
+      break;
     }
-    ::curl_easy_setopt(curl, CURLOPT_HTTPHEADER, scurl.headerlist);
-    taskinfo_in_out.htasks.push_back(scurl);
-    ::curl_multi_add_handle(taskinfo_in_out.hmaster, curl);
   }
 }
 
-void pool_impl::_cancel_running_task(CURLM*& hmaster, std::vector<session_curl>& htasks) 
+// @returns the seconds of a Retry-After header, -1 if there is none.
+//          The HTTP-date form is not supported.
+static int retry_after_seconds(const si_stringmap_utf8& header)
 {
-  for (std::vector<session_curl>::iterator it = htasks.begin(); it != htasks.end(); it++)
+  for (si_stringmap_utf8::const_iterator it = header.begin(); it != header.end(); it++)
   {
-    ::curl_multi_remove_handle(hmaster, (*it).hcurl);
-    ::curl_easy_cleanup((*it).hcurl);
-    ::curl_formfree((*it).post);
-    ::curl_slist_free_all((*it).headerlist);
-    for (std::vector<void*>::iterator bfit = (*it).bufs.begin(); bfit != (*it).bufs.end(); bfit++)
-      free((*bfit));
+    std::string key = it->first;
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    if (key != "retry-after")
+      continue;
+    const char* value = it->second.c_str();
+    while (*value == ' ' || *value == '\t')
+      value++;
+    if (*value < '0' || *value > '9')
+      return -1;
+    return (int)strtol(value, 0, 10);
   }
-  ::curl_multi_cleanup(hmaster);
+  return -1;
+}
+
+int pool_impl::_retry_delay(const refptr<request>& req, int attempts, int error,
+                            long status, unsigned int& rand_seed)
+{
+  int max_attempts, base_delay, max_delay, retry_errors;
+  req->get_retry_policy(max_attempts, base_delay, max_delay, retry_errors);
+  if (attempts >= max_attempts)
+    return -1;
+
+  int retry = 0;
+  if (error != REQ_ERR_NONE)
+    retry = (error < 32 && (retry_errors & REQ_ERR_BIT(error)));
+  else
+  {
+    std::vector<int> statuses;
+    req->get_retry_status(statuses);
+    retry = (std::find(statuses.begin(), statuses.end(), (int)status) != statuses.end());
+  }
+  if (!retry)
+    return -1;
+
+  // exponential backoff with "equal jitter": half the delay is fixed,
+  // the other half random, so retries of many requests that failed
+  // together spread out
+  long long delay = base_delay;
+  for (int i = 1; i < attempts && delay < max_delay; i++)
+    delay *= 2;
+  if (delay > max_delay)
+    delay = max_delay;
+  rand_seed = rand_seed * 1103515245 + 12345;
+  delay = delay / 2 + (long long)((rand_seed >> 16) % (unsigned int)(delay / 2 + 1));
+
+  int retry_after = retry_after_seconds(req->get_response_header_utf8());
+  if (retry_after >= 0 && (long long)retry_after * 1000 > delay)
+    delay = (long long)retry_after * 1000;
+  if (delay > max_delay)
+    delay = max_delay;
+  return (int)delay;
+}
+
+void pool_impl::_record_first_byte(session_curl* session)
+{
+  if (session->primary)
+    return;
+  latency_window& window = m_latency[session->origin];
+  int latency = (int)(_now_ms() - session->attempt_start);
+  if (window.samples.size() < LATENCY_WINDOW_SIZE)
+    window.samples.push_back(latency);
+  else
+  {
+    window.samples[window.next] = latency;
+    window.next = (window.next + 1) % LATENCY_WINDOW_SIZE;
+  }
+}
+
+int pool_impl::_hedge_delay(session_curl* session)
+{
+  if (session->primary || session->hedge)
+    return -1;
+  int percentile, delay;
+  session->req->get_hedge_policy(percentile, delay);
+  if (percentile <= 0 && delay <= 0)
+    return -1;
+  if (session->req->get_request_method_utf8() != REQ_GET_UTF8)
+    return -1;
+
+  if (percentile > 0)
+  {
+    std::map<std::string, latency_window>::iterator it = m_latency.find(session->origin);
+    if (it != m_latency.end() && it->second.samples.size() >= LATENCY_MIN_SAMPLES)
+    {
+      std::vector<int> samples(it->second.samples);
+      std::vector<int>::iterator nth =
+        samples.begin() + (samples.size() - 1) * percentile / 100;
+      std::nth_element(samples.begin(), nth, samples.end());
+      return *nth;
+    }
+  }
+  return delay > 0 ? delay : -1;
+}
+
+void pool_impl::_start_hedge(session_curl* primary)
+{
+  refptr<request> req = primary->req;
+
+  // the hedge writes into a request of its own, only the winner's
+  // response ends up in |req|
+  refptr<request> shadow = request::create_instance();
+  // cancel() frees sessions from the caller's thread
+  shadow->publish();
+  shadow->set_request_method_utf8(REQ_GET_UTF8);
+  std::vector<std::string> mirrors;
+  req->get_mirrors(mirrors);
+  if (mirrors.empty())
+    shadow->set_request_url_utf8(primary->spec.c_str());
+  else
+    shadow->set_request_url_utf8(mirrors[(primary->attempts - 1) % mirrors.size()].c_str());
+  si_stringmap_utf8 header = req->get_request_header_utf8();
+  shadow->set_request_header_utf8(header);
+  int deadline, connect_timeout, first_byte_timeout;
+  req->get_timeouts(deadline, connect_timeout, first_byte_timeout);
+  shadow->set_timeouts(0, connect_timeout, first_byte_timeout);
+  int low_speed_limit, low_speed_time;
+  req->get_low_speed(low_speed_limit, low_speed_time);
+  shadow->set_low_speed(low_speed_limit, low_speed_time);
+
+  session_curl* hedge = _create_session(primary->owner, shadow, *primary->info);
+  if (!_open_session(hedge))
+  {
+    delete hedge;
+    return;
+  }
+  hedge->primary = primary;
+  hedge->request_id = primary->request_id;
+  primary->hedge = hedge;
+  primary->info->htasks.push_back(hedge);
+  _queue_session(hedge);
+}
+
+void pool_impl::_drop_hedge(session_curl* primary)
+{
+  session_curl* hedge = primary->hedge;
+  if (!hedge)
+    return;
+  std::vector<session_curl*>& sessions = primary->info->htasks;
+  std::vector<session_curl*>::iterator it =
+    std::find(sessions.begin(), sessions.end(), hedge);
+  if (it != sessions.end())
+    sessions.erase(it);
+  _free_session(hedge);
+}
+
+// replace the response of |to| with the one of |from|
+static void copy_response(const refptr<request>& from, const refptr<request>& to)
+{
+  to->reset_response();
+  si_stringmap_utf8 header = from->get_response_header_utf8();
+  to->set_response_header_utf8(header);
+  to->set_response_size(from->get_response_size());
+  to->set_response_errcode(from->get_response_errcode());
+  si_buffer buffer = from->get_response_buffer();
+  if (!buffer.empty())
+    to->set_appendbuffer(&buffer[0], buffer.size());
+  to->set_request_error(from->get_request_error());
+  request_timing timing;
+  from->get_timing(timing);
+  to->set_timing(timing);
+  to->set_effective_url_utf8(from->get_effective_url_utf8().c_str());
+}
+
+void pool_impl::_hedge_won(session_curl* hedge)
+{
+  session_curl* primary = hedge->primary;
+  refptr<request> req = primary->req;
+  refptr<request> shadow = hedge->req;
+
+  _detach_session(primary);
+  // the primary may have streamed the start of the body already, the
+  // hedge's copy of it is the same
+  size_t reported = req->get_retrieved_size();
+  copy_response(shadow, req);
+  _report_body(*primary->info, primary->request_id, req, reported);
+
+  // frees |hedge| too
+  _session_done(primary);
+}
+
+int pool_impl::_coalesce(session_curl* session, const std::string& proxyurl,
+                         const std::string& useragent)
+{
+  refptr<request> req = session->req;
+  if (req->get_request_method_utf8() != REQ_GET_UTF8)
+    return 0;
+
+  // everything that can change the response: url, headers and the
+  // task's proxy and user agent
+  std::string key(session->spec);
+  key.push_back('\n');
+  key.append(proxyurl);
+  key.push_back('\n');
+  key.append(useragent);
+  si_stringmap_utf8 header = req->get_request_header_utf8();
+  for (si_stringmap_utf8::iterator it = header.begin(); it != header.end(); it++)
+  {
+    key.push_back('\n');
+    key.append(it->first);
+    key.push_back(':');
+    key.append(it->second);
+  }
+
+  std::map<std::string, session_curl*>::iterator it = m_inflight.find(key);
+  if (it != m_inflight.end())
+  {
+    session->leader = it->second;
+    session->state = SESSION_FOLLOWING;
+    it->second->followers.push_back(session);
+    return 1;
+  }
+
+  // the response of a leader is copied from its buffer
+  if (req->get_request_outmode() == REQ_OUTBUFFER)
+  {
+    session->coalesce_key = key;
+    m_inflight[key] = session;
+  }
+  return 0;
+}
+
+void pool_impl::_fan_out(session_curl* leader)
+{
+  if (leader->coalesce_key.empty())
+    return;
+  m_inflight.erase(leader->coalesce_key);
+  leader->coalesce_key.clear();
+
+  std::vector<session_curl*> followers;
+  followers.swap(leader->followers);
+  for (std::vector<session_curl*>::iterator it = followers.begin();
+    it != followers.end(); it++)
+  {
+    (*it)->leader = NULL;
+    copy_response(leader->req, (*it)->req);
+    (*it)->req->set_attempts(leader->attempts);
+    _report_body(*(*it)->info, (*it)->request_id, (*it)->req);
+    _session_done(*it);
+  }
+}
+
+void pool_impl::_promote_follower(session_curl* leader)
+{
+  if (leader->coalesce_key.empty())
+    return;
+  m_inflight.erase(leader->coalesce_key);
+
+  std::vector<session_curl*> followers;
+  followers.swap(leader->followers);
+  std::vector<session_curl*>::iterator it = followers.begin();
+  for (; it != followers.end(); it++)
+    if ((*it)->req->get_request_outmode() == REQ_OUTBUFFER)
+      break;
+
+  // with no follower able to lead, each one runs on its own
+  session_curl* next = (it == followers.end()) ? NULL : *it;
+  if (next && !_open_session(next))
+    next = NULL;
+  if (next)
+  {
+    next->coalesce_key = leader->coalesce_key;
+    m_inflight[next->coalesce_key] = next;
+  }
+  for (it = followers.begin(); it != followers.end(); it++)
+  {
+    (*it)->leader = NULL;
+    if (next && *it != next)
+    {
+      (*it)->leader = next;
+      next->followers.push_back(*it);
+    }
+    else
+      _start_session(*it);
+  }
+  leader->coalesce_key.clear();
+}
+
+// answer |req| with a copy kept on disk
+static int serve_stored(const refptr<request>& req, const disk_cache::entry& stored)
+{
+  req->reset_response();
+  si_stringmap_utf8 header = stored.header;
+  req->set_response_header_utf8(header);
+  req->set_response_size((size_t)stored.body_size);
+  req->set_response_errcode(200);
+  int ok = disk_cache::read_body(stored, req);
+  req->close_outfile();
+  if (!ok)
+    req->reset_response();
+  return ok;
+}
+
+int pool_impl::_cache_lookup(const refptr<request>& req, const std::string& spec,
+                             std::vector<std::string>& validators)
+{
+  if (req->get_request_method_utf8() != REQ_GET_UTF8)
+    return 0;
+
+  si_stringmap_utf8 request_header = req->get_request_header_utf8();
+  long long now = (long long)time(NULL);
+  const http_cache::entry* cached = m_cache.lookup(spec, request_header, now);
+  if (cached)
+  {
+    req->reset_response();
+    si_stringmap_utf8 header = cached->header;
+    req->set_response_header_utf8(header);
+    req->set_response_size(cached->body.size());
+    req->set_response_errcode(cached->status);
+    if (!cached->body.empty())
+      req->set_appendbuffer(&cached->body[0], cached->body.size());
+    req->close_outfile();
+    return 1;
+  }
+
+  disk_cache::entry stored;
+  if (!m_disk_cache.lookup(spec, request_header, stored))
+    return 0;
+  if (stored.expires > now)
+  {
+    if (!serve_stored(req, stored))
+      return 0;
+    m_disk_hits++;
+    return 1;
+  }
+  disk_cache::get_validators(stored, validators);
+  return 0;
+}
+
+void pool_impl::_cache_store(session_curl* session)
+{
+  refptr<request> req = session->req;
+  if (req->get_request_error() != REQ_ERR_NONE ||
+    req->get_request_method_utf8() != REQ_GET_UTF8)
+    return;
+
+  // 0 stands for 200, see request::get_response_errcode
+  int status = req->get_response_errcode();
+  if (status == 0)
+    status = 200;
+  const std::string& spec = session->spec;
+  si_stringmap_utf8 request_header = req->get_request_header_utf8();
+  long long now = (long long)time(NULL);
+
+  if (status == 304 && session->revalidate)
+  {
+    // the stale copy is still good, the request gets it instead of the
+    // empty 304
+    disk_cache::entry stored;
+    if (!m_disk_cache.refresh(spec, request_header, req->get_response_header_utf8(),
+      now, stored) || !serve_stored(req, stored))
+      return;
+    m_revalidated++;
+    _report_body(*session->info, session->request_id, req);
+    if (req->get_request_outmode() == REQ_OUTBUFFER)
+      m_cache.store(spec, request_header, 200, stored.header,
+        req->get_response_buffer(), now);
+    return;
+  }
+  if (status != 200)
+    return;
+
+  if (req->get_request_outmode() == REQ_OUTBUFFER)
+  {
+    si_buffer buffer = req->get_response_buffer();
+    m_cache.store(spec, request_header, status, req->get_response_header_utf8(),
+      buffer, now);
+    m_disk_cache.store(spec, request_header, req->get_response_header_utf8(),
+      &buffer, std::string(), now);
+  }
+  else if (!m_disk_cache.get_directory().empty())
+  {
+    req->close_outfile();
+    m_disk_cache.store(spec, request_header, req->get_response_header_utf8(),
+      NULL, req->get_outfile_utf8(), now);
+  }
+}
+
+int pool_impl::_request_error(int curl_code)
+{
+  switch (curl_code)
+  {
+  case CURLE_OK:
+    return REQ_ERR_NONE;
+  case CURLE_COULDNT_RESOLVE_PROXY:
+  case CURLE_COULDNT_RESOLVE_HOST:
+    return REQ_ERR_RESOLVE;
+  case CURLE_COULDNT_CONNECT:
+    return REQ_ERR_CONNECT;
+  case CURLE_OPERATION_TIMEDOUT:
+    return REQ_ERR_TIMEOUT;
+  case CURLE_SEND_ERROR:
+    return REQ_ERR_SEND;
+  case CURLE_RECV_ERROR:
+  case CURLE_GOT_NOTHING:
+  case CURLE_PARTIAL_FILE:
+    return REQ_ERR_RECV;
+  case CURLE_SSL_CONNECT_ERROR:
+  case CURLE_PEER_FAILED_VERIFICATION:
+  case CURLE_SSL_CERTPROBLEM:
+  case CURLE_SSL_CIPHER:
+#if LIBCURL_VERSION_NUM < 0x073e00
+  // an alias of CURLE_PEER_FAILED_VERIFICATION since 7.62.0
+  case CURLE_SSL_CACERT:
+#endif
+  case CURLE_SSL_CACERT_BADFILE:
+    return REQ_ERR_SSL;
+  case CURLE_TOO_MANY_REDIRECTS:
+    return REQ_ERR_REDIRECTS;
+  }
+  return REQ_ERR_OTHER;
+}
+
+long long pool_impl::_now_ms()
+{
+#if defined(_WINDOWS_)
+  return (long long)::GetTickCount();
+#elif defined(_MAC_) || defined(__linux__)
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (long long)now.tv_sec * 1000 + now.tv_usec / 1000;
+#endif
 }
 
 void pool_impl::_stop_thread()
@@ -483,6 +1843,7 @@ void pool_impl::_stop_thread()
     ::WaitForSingleObject(m_thread, INFINITE);
   m_thread = NULL;
 #elif defined(_MAC_) || defined(__linux__)
+  m_stopping = 1;
   pthread_cond_signal(&m_stop_event);
   pthread_join(m_thread, NULL);
 #endif
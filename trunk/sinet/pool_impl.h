@@ -2,6 +2,11 @@
 #define SINET_POOL_IMPL_H
 
 #include "pool.h"
+#include "token_bucket.h"
+#include "http_cache.h"
+#include "disk_cache.h"
+#include <deque>
+#include <map>
 
 typedef void CURLM;
 typedef void CURL;
@@ -20,25 +25,95 @@ public:
   pool_impl(void);
   ~pool_impl(void);
 
-  virtual void execute(refptr<task> task_in);
-  virtual void cancel(refptr<task> task_in);
-  virtual int is_running(refptr<task> task_in);
-  virtual int is_queued(refptr<task> task_in);
-  virtual int is_running_or_queued(refptr<task> task_in);
+  virtual void execute(const refptr<task>& task_in);
+  virtual void cancel(const refptr<task>& task_in);
+  virtual int is_running(const refptr<task>& task_in);
+  virtual int is_queued(const refptr<task>& task_in);
+  virtual int is_running_or_queued(const refptr<task>& task_in);
   virtual void clear_all();
 
+  virtual void use_config(const refptr<config>& config);
+  virtual refptr<config> get_config();
+
+  virtual void get_cache_stats(cache_stats& stats);
+  virtual intptr_t get_event_fd();
+  virtual void get_stats(pool_stats& stats);
+
+  struct _task_info;
+  struct _session_curl;
+
+  // pending timers of the pool thread by due time, in _now_ms() clock
+  typedef struct _timer_entry{
+    struct _session_curl* session;
+    int kind;
+  }timer_entry;
+  typedef std::multimap<long long, timer_entry> timer_queue;
+
+  // one per request, allocated by _prepare_task and handed to curl as
+  // CURLOPT_PRIVATE and callback data
   typedef struct _session_curl{
     CURL* hcurl;
     curl_httppost* post;
     curl_httppost* last;
     curl_slist* headerlist;
     std::vector<void*>  bufs;
+    refptr<task>        owner;
+    refptr<request>     req;
+    // id of |req| in |owner|, a hedge has the one of its primary
+    int                 request_id;
+    // spec and origin key of the request url, see url::get_spec and
+    // url::get_origin. Taken once so that later steps need not copy
+    // the url out of |req| again.
+    std::string         spec;
+    std::string         origin;
+    int                 state;
+    pool_impl*          pool;
+    struct _task_info*  info;
+    // speed caps currently set on |hcurl|, 0 for none
+    long long           max_recv;
+    long long           max_send;
+    // attempts started so far, see request::set_retry_policy
+    int                 attempts;
+    // first byte timeout of each attempt, 0 for none
+    int                 first_byte_timeout;
+    // set by the header callback once the attempt got a response
+    int                 first_byte;
+    // start of the current attempt, in _now_ms() clock
+    long long           attempt_start;
+    // a hedge is a copy of |primary| into a private request, see
+    // request::set_hedge_policy. Each points to the other while both run.
+    struct _session_curl* primary;
+    struct _session_curl* hedge;
+    // identical GETs wait as followers of one leader session and get a
+    // copy of its response, see _coalesce. |coalesce_key| is set on
+    // leaders only.
+    std::string         coalesce_key;
+    struct _session_curl* leader;
+    std::vector<struct _session_curl*> followers;
+    // set when the request carries the validators of a stale copy on
+    // disk, a 304 is answered from that copy
+    int                 revalidate;
+    // timers of this session in |m_timers|
+    std::vector<timer_queue::iterator> timers;
   }session_curl;
 
   typedef struct _task_info{
-    CURLM* hmaster;
-    std::vector<session_curl> htasks;
+    std::vector<session_curl*> htasks;
+    // sessions of this task not yet finished
     int running_handle;
+    // sessions of this task added to the multi handle
+    int active_handle;
+    // rate limits from the task config
+    token_bucket request_bucket;
+    token_bucket recv_bucket;
+    int send_rate;
+    // the task's callbacks, read when it starts
+    task*          owner;
+    task_callbacks callbacks;
+    // last percentage reported, -1 for none
+    int progress;
+    // when execute() queued the task, in _now_ms() clock
+    long long queued_ms;
   }task_info;
 
   // threading details for the pool
@@ -49,13 +124,138 @@ public:
 #endif
   void _thread();
 
+  // charge |size| received bytes to the pool and task buckets
+  // called by the curl write callback
+  void _account_received(session_curl* session, size_t size);
+  // pass bytes the transfer of |session| wrote to the task callbacks
+  // called by the curl write callback
+  void _data_received(session_curl* session, const void* data, size_t size);
+  // note the first byte latency of the current attempt
+  // called by the curl header callback
+  void _record_first_byte(session_curl* session);
+
+  // @returns the delay before the next attempt of |req| after
+  //          |attempts| attempts, the last one failed with |error| and
+  //          HTTP |status|; -1 for no retry. |rand_seed| is advanced for
+  //          the jitter.
+  static int _retry_delay(const refptr<request>& req, int attempts, int error,
+                          long status, unsigned int& rand_seed);
+
+  // recent first byte latencies of an origin, for hedging
+  typedef struct _latency_window{
+    std::vector<int> samples;
+    size_t next;
+  }latency_window;
+
 private:
   // iterates thru refptr<task> and translate them into CURL details
   // called by pool_impl::execute
-  void _prepare_task(refptr<task> task_in, task_info& taskinfo_in);
+  void _prepare_task(const refptr<task>& task_in, task_info& taskinfo_in);
+  // create the session of |req|, with no curl handle yet
+  session_curl* _create_session(const refptr<task>& task_in, const refptr<request>& req,
+                                task_info& taskinfo_in);
+  // create and set up the curl handle of a session that is going to
+  // run its own transfer, not yet queued
+  // @returns 0 if curl failed to create the handle
+  int _open_session(session_curl* session);
   // tell CURL to stop running tasks
-  // called by pool_impl::cancel, pool_impl::clear_all, pool_impl::_clean_finished
-  void _cancel_running_task(CURLM*& hmaster, std::vector<session_curl>& htasks);
+  // called by pool_impl::cancel, pool_impl::clear_all, pool_impl::_finish_task
+  void _cancel_running_task(task_info& taskinfo_in);
+
+  // open a session if it has no curl handle yet and queue it, a
+  // session that cannot be opened is done with REQ_ERR_OTHER
+  void _start_session(session_curl* session);
+  // put a session in the queue of its origin
+  void _queue_session(session_curl* session);
+  // start queued sessions round-robin across origins, as long as the
+  // connection limits allow
+  void _dispatch_sessions();
+  // pick up transfers curl reports as done and free their slots
+  void _collect_finished();
+  // take a session off the multi handle or its queue, freeing its slot
+  void _detach_session(session_curl* session);
+  // a detached session's attempt ended with |error|, retry or finish it
+  void _end_attempt(session_curl* session, int error, long status);
+  // mark a detached session as finished
+  void _session_done(session_curl* session);
+  // remove a session from the multi handle or its queue and free it
+  void _free_session(session_curl* session);
+  // move a task whose sessions are all done to |m_task_finished|
+  void _finish_task(std::map<refptr<task>, task_info>::iterator it);
+
+  // report |size| bytes at |offset| of a request body and the task
+  // progress to the callbacks
+  void _report_data(task_info& taskinfo_in, int request_id, size_t offset,
+                    const void* data, size_t size);
+  // report a body that did not come from the request's own transfer,
+  // a buffer in one piece, an out file in chunks read back from it. The
+  // first |offset| bytes were reported already.
+  void _report_body(task_info& taskinfo_in, int request_id, const refptr<request>& req,
+                    size_t offset = 0);
+  // tell the observer and callbacks of |task_in| its new status, with no
+  // pool lock held
+  void _notify_status(const refptr<task>& task_in, int status);
+  // signal the event of get_event_fd, if there is one
+  void _signal_finished();
+
+  // count the bytes, connection and timings of a finished attempt and
+  // give the request its timing
+  void _record_transfer(session_curl* session);
+  // copy the counters and gauges for get_stats
+  void _publish_stats();
+
+  // @returns the config value |id|, or |default_value| if not set
+  int _get_limit(int id, int default_value);
+  static int _get_limit(const refptr<config>& cfg, int id, int default_value);
+  // @returns |value| if it is not 0, else the config value |id| of the
+  //          task or the pool; 0 when the timeout is disabled
+  static int _get_timeout(int value, const refptr<config>& task_cfg,
+                          const refptr<config>& pool_cfg, int id, int default_value);
+
+  // re-read the rate limits of the pool and running tasks, refill
+  // their buckets
+  void _update_rate_limits();
+  // split the byte rate limits over the running transfers
+  void _apply_speed_caps();
+
+  // timers fire from the pool thread, nothing blocks while one waits
+  void _add_timer(session_curl* session, long long due_ms, int kind);
+  void _remove_timers(session_curl* session, int kind);
+  // fire the timers due at |m_now_ms|
+  void _run_timers();
+
+  // @returns the REQ_ERR_* class of a CURLcode
+  static int _request_error(int curl_code);
+
+  // @returns the hedge delay of |session|'s current attempt, -1 for none
+  int _hedge_delay(session_curl* session);
+  // queue a copy of |primary|, to its next mirror if it has any
+  void _start_hedge(session_curl* primary);
+  // cancel and free the hedge of |primary|
+  void _drop_hedge(session_curl* primary);
+  // the hedge won, its response becomes the primary's
+  void _hedge_won(session_curl* hedge);
+
+  // make |session| a follower of an identical GET in flight, or the
+  // leader of later ones
+  // @returns 1 if |session| became a follower
+  int _coalesce(session_curl* session, const std::string& proxyurl,
+                const std::string& useragent);
+  // hand the leader's response to its followers
+  void _fan_out(session_curl* leader);
+  // the leader will not complete, let a follower take over
+  void _promote_follower(session_curl* leader);
+
+  // answer |req|, whose url is |spec|, from the memory or disk cache
+  // @returns 1 on a fresh hit, otherwise 0 and the conditional headers
+  //          of a stale copy on disk, if any
+  int _cache_lookup(const refptr<request>& req, const std::string& spec,
+                    std::vector<std::string>& validators);
+  // offer the response of a finished session to the cache
+  void _cache_store(session_curl* session);
+
+  // milliseconds from an arbitrary start, for the rate limits
+  static long long _now_ms();
 
   // stopping and cleanup master pool thread
   // called by destructor
@@ -67,6 +267,9 @@ private:
 #elif defined(_MAC_) || defined(__linux__)
   pthread_t       m_thread;
   pthread_cond_t  m_stop_event;
+  // a signal sent while the thread is not waiting is lost, the thread
+  // checks this flag after each pass
+  volatile int    m_stopping;
 #endif
 
   critical_section                  m_cstasks_running;
@@ -75,6 +278,63 @@ private:
   std::map<refptr<task>, task_info> m_tasks_running;
   std::vector<refptr<task> >        m_task_queue;
   std::vector<refptr<task> >        m_task_finished;
+  // guarded by |m_cstask_queue|: when each task in |m_task_queue| was
+  // queued, and the number of tasks ever queued
+  std::vector<long long>            m_task_queue_times;
+  long long                         m_tasks_executed;
+  // status changes of this pass, reported after |m_cstasks_running|
+  // is released
+  std::vector<std::pair<refptr<task>, int> > m_notices;
+
+  // guarded by |m_cstask_finished|, see get_event_fd
+#if defined(_WINDOWS_)
+  HANDLE                            m_finished_event;
+#elif defined(_MAC_) || defined(__linux__)
+  int                               m_finished_pipe[2];
+#endif
+
+  critical_section                  m_csconfig;
+  refptr<config>                    m_config;
+
+  // below are guarded by |m_cstasks_running|
+  // one multi handle for all running tasks, so connections are
+  // reused across them
+  CURLM*                            m_hmaster;
+  // sessions waiting for a connection slot, per origin
+  std::map<std::string, std::deque<session_curl*> > m_origin_queues;
+  // origins with queued sessions, in round-robin order
+  std::deque<std::string>           m_origin_order;
+  // running transfers per origin and in total
+  std::map<std::string, int>        m_origin_active;
+  int                               m_active_total;
+
+  // pool wide rate limits
+  token_bucket                      m_request_bucket;
+  token_bucket                      m_recv_bucket;
+  int                               m_send_rate;
+  // clock of the current scheduling pass
+  long long                         m_now_ms;
+  // set when the transfers or limits change, see _apply_speed_caps
+  int                               m_caps_dirty;
+
+  timer_queue                       m_timers;
+  // retry jitter
+  unsigned int                      m_rand_seed;
+  // first byte latencies per origin
+  std::map<std::string, latency_window> m_latency;
+  // leaders of coalesced GETs by coalesce key
+  std::map<std::string, session_curl*> m_inflight;
+  http_cache                        m_cache;
+  disk_cache                        m_disk_cache;
+  long long                         m_disk_hits;
+  long long                         m_revalidated;
+  // counters of the pool thread, set |m_stats_dirty| on change
+  pool_stats                        m_stats;
+  int                               m_stats_dirty;
+
+  // the last copy of |m_stats| published, for get_stats
+  critical_section                  m_csstats;
+  pool_stats                        m_stats_published;
 };
 
 } // namespace sinet
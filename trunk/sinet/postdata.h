@@ -19,9 +19,9 @@ public:
   // clear all elements
   virtual void clear() = 0;
   // add an element, return non-zero if succeeds.
-  virtual void add_elem(refptr<postdataelem> elem) = 0;
+  virtual void add_elem(const refptr<postdataelem>& elem) = 0;
   // remove an element, return non-zero if succeeds.
-  virtual int remove_elem(refptr<postdataelem> elem) = 0;
+  virtual int remove_elem(const refptr<postdataelem>& elem) = 0;
   // retrieve all elements, returning count
   virtual void get_elements(std::vector<refptr<postdataelem> >& elems) = 0;
   virtual int get_element_count() = 0;
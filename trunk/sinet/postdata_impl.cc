@@ -3,6 +3,8 @@
 
 using namespace sinet;
 
+SINET_POOLED_NEW_IMPL(postdata_impl, 32)
+
 refptr<postdata> postdata::create_instance()
 {
   refptr<postdata> _postdata(new postdata_impl());
@@ -14,12 +16,14 @@ void postdata_impl::clear()
   m_elems.clear();
 }
 
-void postdata_impl::add_elem(refptr<postdataelem> elem)
+void postdata_impl::add_elem(const refptr<postdataelem>& elem)
 {
+  if (elem && is_published())
+    elem->publish();
   m_elems.push_back(elem);
 }
 
-int postdata_impl::remove_elem(refptr<postdataelem> elem)
+int postdata_impl::remove_elem(const refptr<postdataelem>& elem)
 {
   for (std::vector<refptr<postdataelem> >::iterator it = m_elems.begin();
        it != m_elems.end(); it++)
@@ -42,3 +46,11 @@ int postdata_impl::get_element_count()
 {
   return m_elems.size();
 }
+
+void postdata_impl::publish()
+{
+  local_base<postdata>::publish();
+  for (std::vector<refptr<postdataelem> >::iterator it = m_elems.begin();
+       it != m_elems.end(); it++)
+    (*it)->publish();
+}
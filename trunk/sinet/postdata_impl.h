@@ -2,20 +2,25 @@
 #define POSTDATA_IMPL_H
 
 #include "postdata.h"
+#include "object_pool.h"
 
 namespace sinet
 {
 
 class postdata_impl:
-  public threadsafe_base<postdata>
+  public local_base<postdata>
 {
 public:
+  SINET_POOLED_NEW(postdata_impl)
+
   virtual void clear();
-  virtual void add_elem(refptr<postdataelem> elem);
-  virtual int remove_elem(refptr<postdataelem> elem);
+  virtual void add_elem(const refptr<postdataelem>& elem);
+  virtual int remove_elem(const refptr<postdataelem>& elem);
   virtual void get_elements(std::vector<refptr<postdataelem> >& elems);
   virtual int get_element_count();
 
+  virtual void publish();
+
 private:
   std::vector<refptr<postdataelem> > m_elems;
 };
@@ -21,6 +21,8 @@ public:
   // field name for this entry
   virtual void set_name(const wchar_t* fieldname) = 0;
   virtual std::wstring get_name() = 0;
+  virtual void set_name_utf8(const char* fieldname) = 0;
+  virtual std::string get_name_utf8() = 0;
 
   // clear contents of postdataelem
   virtual void setto_empty() = 0;
@@ -42,6 +44,13 @@ public:
   // returning the actual size copied
   virtual size_t copy_buffer_to(void* bytes_inout, size_t size_in) = 0;
   virtual std::wstring get_text() = 0;
+
+  // UTF-8 variants of the string setters and getters above, names and
+  // texts are stored as UTF-8 internally
+  virtual void setto_file_utf8(const char* filename) = 0;
+  virtual void setto_text_utf8(const char* text) = 0;
+  virtual std::string get_file_utf8() = 0;
+  virtual std::string get_text_utf8() = 0;
 };
 
 } // namespace sinet
@@ -1,8 +1,11 @@
 #include "pch.h"
 #include "postdataelem_impl.h"
+#include "strings.h"
 
 using namespace sinet;
 
+SINET_POOLED_NEW_IMPL(postdataelem_impl, 64)
+
 refptr<postdataelem> postdataelem::create_instance()
 {
   refptr<postdataelem> _postdataelem(new postdataelem_impl());
@@ -11,10 +14,20 @@ refptr<postdataelem> postdataelem::create_instance()
 
 void postdataelem_impl::set_name(const wchar_t* fieldname)
 {
-  m_name = fieldname;
+  m_name = strings::wstring_utf8string(fieldname);
 }
 
 std::wstring postdataelem_impl::get_name()
+{
+  return strings::utf8string_wstring(m_name);
+}
+
+void postdataelem_impl::set_name_utf8(const char* fieldname)
+{
+  m_name = fieldname;
+}
+
+std::string postdataelem_impl::get_name_utf8()
 {
   return m_name;
 }
@@ -26,8 +39,7 @@ void postdataelem_impl::setto_empty()
 
 void postdataelem_impl::setto_file(const wchar_t* filename)
 {
-  m_type = PDE_TYPE_FILE;
-  m_filename = filename;
+  setto_file_utf8(strings::wstring_utf8string(filename).c_str());
 }
 
 void postdataelem_impl::setto_buffer(const void* bytes_in, const size_t size_in)
@@ -41,8 +53,7 @@ void postdataelem_impl::setto_buffer(const void* bytes_in, const size_t size_in)
 
 void postdataelem_impl::setto_text(const wchar_t* text)
 {
-  m_type = PDE_TYPE_TEXT;
-  m_text = text;
+  setto_text_utf8(strings::wstring_utf8string(text).c_str());
 }
 
 postdataelem_type_t postdataelem_impl::get_type()
@@ -52,7 +63,7 @@ postdataelem_type_t postdataelem_impl::get_type()
 
 std::wstring postdataelem_impl::get_file()
 {
-  return m_filename;
+  return strings::utf8string_wstring(m_filename);
 }
 
 size_t postdataelem_impl::get_buffer_size()
@@ -68,6 +79,28 @@ size_t postdataelem_impl::copy_buffer_to(void* bytes_inout, size_t size_in)
 }
 
 std::wstring postdataelem_impl::get_text()
+{
+  return strings::utf8string_wstring(m_text);
+}
+
+void postdataelem_impl::setto_file_utf8(const char* filename)
+{
+  m_type = PDE_TYPE_FILE;
+  m_filename = filename;
+}
+
+void postdataelem_impl::setto_text_utf8(const char* text)
+{
+  m_type = PDE_TYPE_TEXT;
+  m_text = text;
+}
+
+std::string postdataelem_impl::get_file_utf8()
+{
+  return m_filename;
+}
+
+std::string postdataelem_impl::get_text_utf8()
 {
   return m_text;
 }
\ No newline at end of file
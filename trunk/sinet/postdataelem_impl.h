@@ -2,16 +2,21 @@
 #define POSTDATAELEM_IMPL_H
 
 #include "postdataelem.h"
+#include "object_pool.h"
 
 namespace sinet
 {
 
 class postdataelem_impl:
-  public threadsafe_base<postdataelem>
+  public local_base<postdataelem>
 {
 public:
+  SINET_POOLED_NEW(postdataelem_impl)
+
   virtual void set_name(const wchar_t* fieldname);
   virtual std::wstring get_name();
+  virtual void set_name_utf8(const char* fieldname);
+  virtual std::string get_name_utf8();
 
   virtual void setto_empty();
   virtual void setto_file(const wchar_t* filename);
@@ -25,10 +30,15 @@ public:
   virtual size_t copy_buffer_to(void* bytes_inout, size_t size_in);
   virtual std::wstring get_text();
 
+  virtual void setto_file_utf8(const char* filename);
+  virtual void setto_text_utf8(const char* text);
+  virtual std::string get_file_utf8();
+  virtual std::string get_text_utf8();
+
 private:
-  std::wstring m_name;
-  std::wstring m_filename;
-  std::wstring m_text;
+  std::string m_name;
+  std::string m_filename;
+  std::string m_text;
   std::vector<unsigned char> m_buffer;
   postdataelem_type_t  m_type;
 };
@@ -4,10 +4,27 @@
 #include "api_base.h"
 #include "api_refptr.h"
 #include "postdata.h"
+#include "url.h"
 
 namespace sinet
 {
 
+//////////////////////////////////////////////////////////////////////////
+//
+//  shared_buffer class
+//
+//    A response body lent out by request::lease_response_buffer. The
+//    bytes stay valid and unchanged for as long as a reference is held.
+//
+class shared_buffer:
+  public base
+{
+public:
+  // NULL when empty
+  virtual const unsigned char* get_data() = 0;
+  virtual size_t get_size() = 0;
+};
+
 //////////////////////////////////////////////////////////////////////////
 //
 //  request class
@@ -17,11 +34,76 @@ namespace sinet
 //
 //    The current design of request emphasizes on HTTP only.
 //
+//    Strings are stored internally as UTF-8, which is what curl takes.
+//    The *_utf8 accessors read and write that storage directly, the
+//    wchar_t accessors convert on every call and are kept for
+//    compatibility.
+//
 
 // be used for response output
 #define   REQ_OUTFILE         1
 #define   REQ_OUTBUFFER       2
 
+// transport result of a request, see get_request_error
+#define   REQ_ERR_NONE              0
+#define   REQ_ERR_RESOLVE           1   // host or proxy name lookup failed
+#define   REQ_ERR_CONNECT           2   // could not connect
+#define   REQ_ERR_TIMEOUT           3   // curl reported a timeout
+#define   REQ_ERR_SEND              4   // failed sending data
+#define   REQ_ERR_RECV              5   // failed receiving data
+#define   REQ_ERR_SSL               6   // SSL handshake or certificate error
+#define   REQ_ERR_REDIRECTS         7   // too many redirects
+#define   REQ_ERR_CANCELED          8   // canceled before completion
+#define   REQ_ERR_OTHER             9
+#define   REQ_ERR_DEADLINE          10  // request deadline passed
+#define   REQ_ERR_TASK_DEADLINE     11  // task deadline passed
+#define   REQ_ERR_CONNECT_TIMEOUT   12  // no connection within the connect timeout
+#define   REQ_ERR_FIRST_BYTE_TIMEOUT 13 // no response within the first byte timeout
+#define   REQ_ERR_STALLED           14  // transfer below the low speed limit
+// number of REQ_ERR_* values
+#define   REQ_ERR_COUNT             15
+
+// bit of an error in the |retry_errors| mask of set_retry_policy
+#define   REQ_ERR_BIT(err)          (1 << (err))
+
+// retry policy defaults, a request is tried once unless
+// set_retry_policy allows more attempts
+#define   REQ_RETRY_DEFAULT_BASE_DELAY  200
+#define   REQ_RETRY_DEFAULT_MAX_DELAY   10000
+#define   REQ_RETRY_DEFAULT_ERRORS      (REQ_ERR_BIT(REQ_ERR_RESOLVE) | \
+                                         REQ_ERR_BIT(REQ_ERR_CONNECT) | \
+                                         REQ_ERR_BIT(REQ_ERR_TIMEOUT) | \
+                                         REQ_ERR_BIT(REQ_ERR_SEND) | \
+                                         REQ_ERR_BIT(REQ_ERR_RECV) | \
+                                         REQ_ERR_BIT(REQ_ERR_CONNECT_TIMEOUT) | \
+                                         REQ_ERR_BIT(REQ_ERR_FIRST_BYTE_TIMEOUT) | \
+                                         REQ_ERR_BIT(REQ_ERR_STALLED))
+
+// where the time of the last attempt of a request went, set by the pool
+// when the attempt ends or is canceled. Responses from the cache have
+// no timing, a request served by another one's transfer (hedged or
+// coalesced) has that transfer's.
+typedef struct _request_timing{
+  // milliseconds on the pool's monotonic clock: execute() of the task
+  // and the start of the attempt
+  long long queued_ms;
+  long long started_ms;
+  // microseconds from the start of the attempt to the end of each
+  // phase as curl times them, 0 for a phase that did not happen
+  long long namelookup;
+  long long connect;
+  long long appconnect;
+  long long pretransfer;
+  long long starttransfer;
+  long long total;
+  // redirects followed
+  int       redirects;
+  // 1 if the attempt sent its request on a connection already open
+  int       reused;
+  // address of the last connection, "" if none was made
+  char      primary_ip[64];
+}request_timing;
+
 class request:
   public base
 {
@@ -31,26 +113,46 @@ public:
   // request method
   virtual void set_request_method(const wchar_t* method) = 0;
   virtual std::wstring get_request_method() = 0;
+  virtual void set_request_method_utf8(const char* method) = 0;
+  virtual std::string get_request_method_utf8() = 0;
 
   // request url
   virtual void set_request_url(const wchar_t* url) = 0;
   virtual std::wstring get_request_url() = 0;
+  virtual void set_request_url_utf8(const char* url) = 0;
+  virtual std::string get_request_url_utf8() = 0;
+  // parsed form, set_request_url_utf8 parses once and get_request_url
+  // copies the cached components, spec and origin key
+  virtual void set_request_url(const url& request_url) = 0;
+  virtual void get_request_url(url& request_url) = 0;
 
   // request header
   virtual void set_request_header(si_stringmap& header) = 0;
   virtual si_stringmap get_request_header() = 0;
+  virtual void set_request_header_utf8(si_stringmap_utf8& header) = 0;
+  virtual si_stringmap_utf8 get_request_header_utf8() = 0;
 
   // request postdata
-  virtual void set_postdata(refptr<postdata> postdata) = 0;
+  virtual void set_postdata(const refptr<postdata>& postdata) = 0;
   virtual refptr<postdata> get_postdata() = 0;
 
   // response header
   virtual void set_response_header(si_stringmap& header) = 0;
   virtual si_stringmap get_response_header() = 0;
+  virtual void set_response_header_utf8(si_stringmap_utf8& header) = 0;
+  virtual si_stringmap_utf8 get_response_header_utf8() = 0;
+  // set one response header in place, the pool adds them as they
+  // arrive without copying the whole map each time
+  virtual void add_response_header_utf8(const std::string& key,
+                                        const std::string& value) = 0;
 
   // response content buffer
   virtual void set_response_buffer(si_buffer& buffer) = 0;
   virtual si_buffer get_response_buffer() = 0;
+  // the response body without a copy, may be taken while the request
+  // runs. Data the request receives later goes to a new body, the lease
+  // keeps what it saw.
+  virtual refptr<shared_buffer> lease_response_buffer() = 0;
 
   // response content buffer size only
   virtual void set_response_size(size_t size_in) = 0;
@@ -69,9 +171,73 @@ public:
 
   virtual void set_outfile(const wchar_t* file) = 0;
   virtual std::wstring get_outfile() = 0;
+  virtual void set_outfile_utf8(const char* file) = 0;
+  virtual std::string get_outfile_utf8() = 0;
   virtual void close_outfile() = 0;
 
   virtual void set_appendbuffer(const void* data, size_t size) = 0;
+
+  // transport result of the last attempt, one of REQ_ERR_*, set by
+  // the pool. HTTP statuses are reported by get_response_errcode.
+  virtual void set_request_error(int error) = 0;
+  virtual int get_request_error() = 0;
+
+  // retry policy
+  // a failed attempt is retried while fewer than |max_attempts| were
+  // made and either its REQ_ERR_* bit is in |retry_errors| or its HTTP
+  // status is one of the retry statuses (429, 502, 503 and 504 by
+  // default). The n-th retry waits between half and all of
+  // |base_delay_ms| * 2^(n-1), or longer if a Retry-After header asks
+  // for it, but never more than |max_delay_ms|. Only enable retries
+  // for requests that are safe to send twice.
+  virtual void set_retry_policy(int max_attempts, int base_delay_ms,
+                                int max_delay_ms, int retry_errors) = 0;
+  virtual void get_retry_policy(int& max_attempts, int& base_delay_ms,
+                                int& max_delay_ms, int& retry_errors) = 0;
+  virtual void set_retry_status(const std::vector<int>& statuses) = 0;
+  virtual void get_retry_status(std::vector<int>& statuses) = 0;
+
+  // attempts made so far, set by the pool
+  virtual void set_attempts(int attempts) = 0;
+  virtual int get_attempts() = 0;
+
+  // drop the response of a failed attempt before it is retried
+  virtual void reset_response() = 0;
+
+  // timeouts in milliseconds, 0 to use CFG_INT_*_TIMEOUT of the task
+  // or pool config, less than 0 for none
+  //   deadline: from the start of the task to the end of the last
+  //             attempt, fails with REQ_ERR_DEADLINE and is not retried
+  //   connect: name lookup and connect of each attempt
+  //   first_byte: from the start of an attempt to the response status
+  virtual void set_timeouts(int deadline_ms, int connect_ms, int first_byte_ms) = 0;
+  virtual void get_timeouts(int& deadline_ms, int& connect_ms, int& first_byte_ms) = 0;
+  // fail an attempt with REQ_ERR_STALLED when it transfers less than
+  // |limit_bytes| per second for |time_sec| seconds. 0 to use the
+  // config, less than 0 for none. Keep |limit_bytes| below any speed
+  // cap of the pool or task.
+  virtual void set_low_speed(int limit_bytes, int time_sec) = 0;
+  virtual void get_low_speed(int& limit_bytes, int& time_sec) = 0;
+
+  // hedging, for idempotent GETs to replicated servers
+  // when an attempt has no response after the |percentile|-th
+  // percentile of the recent first byte latencies of its origin, or
+  // after |delay_ms| while there are too few of them or |percentile|
+  // is 0, the pool starts a second copy of it, to the next mirror if
+  // any are set. The first copy to complete wins and the other one is
+  // canceled. Both 0, the default, turns hedging off.
+  virtual void set_hedge_policy(int percentile, int delay_ms) = 0;
+  virtual void get_hedge_policy(int& percentile, int& delay_ms) = 0;
+  // UTF-8 urls serving the same content as the request url
+  virtual void set_mirrors(const std::vector<std::string>& urls) = 0;
+  virtual void get_mirrors(std::vector<std::string>& urls) = 0;
+
+  // timing of the last attempt, see request_timing, and the UTF-8 url
+  // it ended at after redirects
+  virtual void set_timing(const request_timing& timing) = 0;
+  virtual void get_timing(request_timing& timing) = 0;
+  virtual void set_effective_url_utf8(const char* url) = 0;
+  virtual std::string get_effective_url_utf8() = 0;
 };
 
 } // namespace sinet
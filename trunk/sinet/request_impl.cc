@@ -1,8 +1,12 @@
 #include "pch.h"
 #include "request_impl.h"
+#include "strings.h"
+#include "trace.h"
 #define _min(x,y) x<y?x:y
 using namespace sinet;
 
+SINET_POOLED_NEW_IMPL(request_impl, 64)
+
 refptr<request> request::create_instance()
 {
   refptr<request> _request(new request_impl());
@@ -12,9 +16,27 @@ refptr<request> request::create_instance()
 request_impl::request_impl(void):
   m_response_size(0),
   m_retrieved_size(0),
-  m_request_outmode(REQ_OUTBUFFER)
+  m_response_errcode(0),
+  m_request_outmode(REQ_OUTBUFFER),
+  m_request_error(REQ_ERR_NONE),
+  m_attempts(0),
+  m_retry_max_attempts(1),
+  m_retry_base_delay(REQ_RETRY_DEFAULT_BASE_DELAY),
+  m_retry_max_delay(REQ_RETRY_DEFAULT_MAX_DELAY),
+  m_retry_errors(REQ_RETRY_DEFAULT_ERRORS),
+  m_deadline(0),
+  m_connect_timeout(0),
+  m_first_byte_timeout(0),
+  m_low_speed_limit(0),
+  m_low_speed_time(0),
+  m_hedge_percentile(0),
+  m_hedge_delay(0)
 {
-
+  m_retry_status.push_back(429);
+  m_retry_status.push_back(502);
+  m_retry_status.push_back(503);
+  m_retry_status.push_back(504);
+  memset(&m_timing, 0, sizeof(m_timing));
 }
 
 request_impl::~request_impl(void)
@@ -24,36 +46,80 @@ request_impl::~request_impl(void)
 
 void request_impl::set_request_method(const wchar_t* method)
 {
-  m_method = method;
+  m_method = strings::wstring_utf8string(method);
 }
 
 std::wstring request_impl::get_request_method()
+{
+  return strings::utf8string_wstring(m_method);
+}
+
+void request_impl::set_request_method_utf8(const char* method)
+{
+  m_method = method;
+}
+
+std::string request_impl::get_request_method_utf8()
 {
   return m_method;
 }
 
 void request_impl::set_request_url(const wchar_t* url)
 {
-  m_url = url;
+  m_url.parse(strings::wstring_utf8string(url));
 }
 
 std::wstring request_impl::get_request_url()
 {
-  return m_url;
+  return m_url.get_spec_wide();
+}
+
+void request_impl::set_request_url_utf8(const char* url)
+{
+  m_url.parse(url);
+}
+
+std::string request_impl::get_request_url_utf8()
+{
+  return m_url.get_spec();
+}
+
+void request_impl::set_request_url(const url& request_url)
+{
+  m_url = request_url;
+}
+
+void request_impl::get_request_url(url& request_url)
+{
+  request_url = m_url;
 }
 
 void request_impl::set_request_header(si_stringmap& header)
 {
-  m_header = header;
+  strings::wstringmap_utf8stringmap(header, m_header);
 }
 
 si_stringmap request_impl::get_request_header()
+{
+  si_stringmap header;
+  strings::utf8stringmap_wstringmap(m_header, header);
+  return header;
+}
+
+void request_impl::set_request_header_utf8(si_stringmap_utf8& header)
+{
+  m_header = header;
+}
+
+si_stringmap_utf8 request_impl::get_request_header_utf8()
 {
   return m_header;
 }
 
-void request_impl::set_postdata(refptr<postdata> postdata)
+void request_impl::set_postdata(const refptr<postdata>& postdata)
 {
+  if (postdata && is_published())
+    postdata->publish();
   m_postdata = postdata;
 }
 
@@ -64,26 +130,57 @@ refptr<postdata> request_impl::get_postdata()
 
 void request_impl::set_response_header(si_stringmap& header)
 {
-  m_response_header = header;
+  strings::wstringmap_utf8stringmap(header, m_response_header);
 }
 
 si_stringmap request_impl::get_response_header()
+{
+  si_stringmap header;
+  strings::utf8stringmap_wstringmap(m_response_header, header);
+  return header;
+}
+
+void request_impl::set_response_header_utf8(si_stringmap_utf8& header)
+{
+  m_response_header = header;
+}
+
+si_stringmap_utf8 request_impl::get_response_header_utf8()
 {
   return m_response_header;
 }
 
+void request_impl::add_response_header_utf8(const std::string& key,
+                                            const std::string& value)
+{
+  m_response_header[key] = value;
+}
+
 void request_impl::set_response_buffer(si_buffer& buffer)
 {
   size_t rsz = _min(buffer.size(), m_response_size);
   if (rsz == 0)
     return;
-  m_response_buffer.resize(rsz);
-  memcpy(&m_response_buffer[0], &buffer[0], rsz);
+  auto_criticalsection acs(m_csbody);
+  si_buffer& body = _writable_body();
+  body.resize(rsz);
+  memcpy(&body[0], &buffer[0], rsz);
 }
 
 si_buffer request_impl::get_response_buffer()
 {
-  return m_response_buffer;
+  auto_criticalsection acs(m_csbody);
+  if (!m_response_body)
+    return si_buffer();
+  return m_response_body->m_buffer;
+}
+
+refptr<shared_buffer> request_impl::lease_response_buffer()
+{
+  auto_criticalsection acs(m_csbody);
+  if (!m_response_body)
+    m_response_body = new response_body();
+  return m_response_body.get();
 }
 
 void request_impl::set_response_size(size_t size_in)
@@ -128,18 +225,26 @@ int request_impl::get_request_outmode()
 }
 
 void request_impl::set_outfile(const wchar_t *file)
+{
+  set_outfile_utf8(strings::wstring_utf8string(file).c_str());
+}
+
+std::wstring request_impl::get_outfile()
+{
+  return strings::utf8string_wstring(m_outfile);
+}
+
+void request_impl::set_outfile_utf8(const char* file)
 {
   m_outfile = file;
 #ifdef WIN32
-  _wremove(m_outfile.c_str());
-#elif defined(_MAC_)
-	unlink(Utf8(m_outfile.c_str()));
-#elif defined(__linux__)
-  unlink((wchar_utf8(m_outfile)).c_str());
+  _wremove(strings::utf8string_wstring(m_outfile).c_str());
+#elif defined(_MAC_) || defined(__linux__)
+  unlink(m_outfile.c_str());
 #endif
 }
 
-std::wstring request_impl::get_outfile()
+std::string request_impl::get_outfile_utf8()
 {
   return m_outfile;
 }
@@ -154,6 +259,7 @@ void request_impl::set_appendbuffer(const void* data, size_t size)
 {
   if (size == 0)
     return;
+  SINET_TRACE_SCOPE_ARG("append buffer", size);
 
   m_retrieved_size += size;
 
@@ -162,21 +268,21 @@ void request_impl::set_appendbuffer(const void* data, size_t size)
   // save data to buffer
   case REQ_OUTBUFFER:
     {
-    size_t lastsize = m_response_buffer.size();
-    m_response_buffer.resize(lastsize + size);
-    memcpy(&m_response_buffer[lastsize], data, size);
+    auto_criticalsection acs(m_csbody);
+    si_buffer& body = _writable_body();
+    size_t lastsize = body.size();
+    body.resize(lastsize + size);
+    memcpy(&body[lastsize], data, size);
     break;
     }
   // save data to file
   case REQ_OUTFILE:
     if (!m_outstream.is_open())
     {
-#ifdef _MAC_ 
-      m_outstream.open(Utf8(m_outfile.c_str()), std::ios::out|std::ios::binary);
-#elif  defined(__linux__)
-      m_outstream.open((wchar_utf8(m_outfile)).c_str(), std::ios::out|std::ios::binary);
+#if defined(_MAC_) || defined(__linux__)
+      m_outstream.open(m_outfile.c_str(), std::ios::out|std::ios::binary);
 #else
-			m_outstream.open(m_outfile.c_str(), std::ios::out|std::ios::binary);
+			m_outstream.open(strings::utf8string_wstring(m_outfile).c_str(), std::ios::out|std::ios::binary);
 #endif
 			if (!m_outstream.is_open())
         return;
@@ -185,3 +291,158 @@ void request_impl::set_appendbuffer(const void* data, size_t size)
     break;
   }
 }
+
+void request_impl::set_request_error(int error)
+{
+  m_request_error = error;
+}
+
+int request_impl::get_request_error()
+{
+  return m_request_error;
+}
+
+void request_impl::set_retry_policy(int max_attempts, int base_delay_ms,
+                                    int max_delay_ms, int retry_errors)
+{
+  m_retry_max_attempts = max_attempts < 1 ? 1 : max_attempts;
+  m_retry_base_delay = base_delay_ms < 0 ? 0 : base_delay_ms;
+  m_retry_max_delay = max_delay_ms < m_retry_base_delay ? m_retry_base_delay : max_delay_ms;
+  m_retry_errors = retry_errors;
+}
+
+void request_impl::get_retry_policy(int& max_attempts, int& base_delay_ms,
+                                    int& max_delay_ms, int& retry_errors)
+{
+  max_attempts = m_retry_max_attempts;
+  base_delay_ms = m_retry_base_delay;
+  max_delay_ms = m_retry_max_delay;
+  retry_errors = m_retry_errors;
+}
+
+void request_impl::set_retry_status(const std::vector<int>& statuses)
+{
+  m_retry_status = statuses;
+}
+
+void request_impl::get_retry_status(std::vector<int>& statuses)
+{
+  statuses = m_retry_status;
+}
+
+void request_impl::set_attempts(int attempts)
+{
+  m_attempts = attempts;
+}
+
+int request_impl::get_attempts()
+{
+  return m_attempts;
+}
+
+void request_impl::reset_response()
+{
+  // the out file is truncated when it is opened again
+  close_outfile();
+  // leases keep the old body
+  {
+    auto_criticalsection acs(m_csbody);
+    m_response_body = NULL;
+  }
+  m_response_header.clear();
+  m_response_size = 0;
+  m_retrieved_size = 0;
+  m_response_errcode = 0;
+}
+
+void request_impl::set_timeouts(int deadline_ms, int connect_ms, int first_byte_ms)
+{
+  m_deadline = deadline_ms;
+  m_connect_timeout = connect_ms;
+  m_first_byte_timeout = first_byte_ms;
+}
+
+void request_impl::get_timeouts(int& deadline_ms, int& connect_ms, int& first_byte_ms)
+{
+  deadline_ms = m_deadline;
+  connect_ms = m_connect_timeout;
+  first_byte_ms = m_first_byte_timeout;
+}
+
+void request_impl::set_low_speed(int limit_bytes, int time_sec)
+{
+  m_low_speed_limit = limit_bytes;
+  m_low_speed_time = time_sec;
+}
+
+void request_impl::get_low_speed(int& limit_bytes, int& time_sec)
+{
+  limit_bytes = m_low_speed_limit;
+  time_sec = m_low_speed_time;
+}
+
+void request_impl::set_hedge_policy(int percentile, int delay_ms)
+{
+  m_hedge_percentile = percentile < 0 ? 0 : (percentile > 100 ? 100 : percentile);
+  m_hedge_delay = delay_ms < 0 ? 0 : delay_ms;
+}
+
+void request_impl::get_hedge_policy(int& percentile, int& delay_ms)
+{
+  percentile = m_hedge_percentile;
+  delay_ms = m_hedge_delay;
+}
+
+void request_impl::set_mirrors(const std::vector<std::string>& urls)
+{
+  m_mirrors = urls;
+}
+
+void request_impl::get_mirrors(std::vector<std::string>& urls)
+{
+  urls = m_mirrors;
+}
+
+void request_impl::set_timing(const request_timing& timing)
+{
+  m_timing = timing;
+}
+
+void request_impl::get_timing(request_timing& timing)
+{
+  timing = m_timing;
+}
+
+void request_impl::set_effective_url_utf8(const char* url)
+{
+  m_effective_url = url;
+}
+
+std::string request_impl::get_effective_url_utf8()
+{
+  return m_effective_url;
+}
+
+si_buffer& request_impl::_writable_body()
+{
+  if (!m_response_body)
+  {
+    m_response_body = new response_body();
+    return m_response_body->m_buffer;
+  }
+  // count the references with an atomic operation rather than
+  // GetRefCt(), so that a lease released on another thread is done
+  // reading before the body is written again
+  int shared = m_response_body->AddRef() > 2;
+  m_response_body->Release();
+  if (shared)
+    m_response_body = new response_body(m_response_body->m_buffer);
+  return m_response_body->m_buffer;
+}
+
+void request_impl::publish()
+{
+  local_base<request>::publish();
+  if (m_postdata)
+    m_postdata->publish();
+}
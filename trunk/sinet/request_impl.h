@@ -2,35 +2,68 @@
 #define SINET_REQUEST_IMPL_H
 
 #include "request.h"
+#include "object_pool.h"
 #include <fstream>
 
 namespace sinet
 {
 
+// response body of a request, shared with the leases it gave out
+class response_body:
+  public threadsafe_base<shared_buffer>
+{
+public:
+  response_body(void) {}
+  response_body(const si_buffer& buffer): m_buffer(buffer) {}
+
+  virtual const unsigned char* get_data()
+  {
+    return m_buffer.empty() ? NULL : &m_buffer[0];
+  }
+  virtual size_t get_size() { return m_buffer.size(); }
+
+  si_buffer m_buffer;
+};
+
 class request_impl:
-  public threadsafe_base<request>
+  public local_base<request>
 {
 public:
+  SINET_POOLED_NEW(request_impl)
+
   request_impl(void);
   ~request_impl(void);
 
   virtual void set_request_method(const wchar_t* method);
   virtual std::wstring get_request_method();
+  virtual void set_request_method_utf8(const char* method);
+  virtual std::string get_request_method_utf8();
 
   virtual void set_request_url(const wchar_t* url);
   virtual std::wstring get_request_url();
+  virtual void set_request_url_utf8(const char* url);
+  virtual std::string get_request_url_utf8();
+  virtual void set_request_url(const url& request_url);
+  virtual void get_request_url(url& request_url);
 
   virtual void set_request_header(si_stringmap& header);
   virtual si_stringmap get_request_header();
+  virtual void set_request_header_utf8(si_stringmap_utf8& header);
+  virtual si_stringmap_utf8 get_request_header_utf8();
 
-  virtual void set_postdata(refptr<postdata> postdata);
+  virtual void set_postdata(const refptr<postdata>& postdata);
   virtual refptr<postdata> get_postdata();
 
   virtual void set_response_header(si_stringmap& header);
   virtual si_stringmap get_response_header();
+  virtual void set_response_header_utf8(si_stringmap_utf8& header);
+  virtual si_stringmap_utf8 get_response_header_utf8();
+  virtual void add_response_header_utf8(const std::string& key,
+                                        const std::string& value);
 
   virtual void set_response_buffer(si_buffer& buffer);
   virtual si_buffer get_response_buffer();
+  virtual refptr<shared_buffer> lease_response_buffer();
 
   virtual void set_response_size(size_t size_in);
   virtual size_t get_response_size();
@@ -46,27 +79,90 @@ public:
 
   virtual void set_outfile(const wchar_t* file);
   virtual std::wstring get_outfile();
+  virtual void set_outfile_utf8(const char* file);
+  virtual std::string get_outfile_utf8();
 
   virtual void close_outfile();
 
   virtual void set_appendbuffer(const void* data, size_t size);
 
+  virtual void set_request_error(int error);
+  virtual int get_request_error();
+
+  virtual void set_retry_policy(int max_attempts, int base_delay_ms,
+                                int max_delay_ms, int retry_errors);
+  virtual void get_retry_policy(int& max_attempts, int& base_delay_ms,
+                                int& max_delay_ms, int& retry_errors);
+  virtual void set_retry_status(const std::vector<int>& statuses);
+  virtual void get_retry_status(std::vector<int>& statuses);
+
+  virtual void set_attempts(int attempts);
+  virtual int get_attempts();
+
+  virtual void reset_response();
+
+  virtual void set_timeouts(int deadline_ms, int connect_ms, int first_byte_ms);
+  virtual void get_timeouts(int& deadline_ms, int& connect_ms, int& first_byte_ms);
+  virtual void set_low_speed(int limit_bytes, int time_sec);
+  virtual void get_low_speed(int& limit_bytes, int& time_sec);
+
+  virtual void set_hedge_policy(int percentile, int delay_ms);
+  virtual void get_hedge_policy(int& percentile, int& delay_ms);
+  virtual void set_mirrors(const std::vector<std::string>& urls);
+  virtual void get_mirrors(std::vector<std::string>& urls);
+
+  virtual void set_timing(const request_timing& timing);
+  virtual void get_timing(request_timing& timing);
+  virtual void set_effective_url_utf8(const char* url);
+  virtual std::string get_effective_url_utf8();
+
+  virtual void publish();
+
 private:
-  std::wstring  m_url;
-  std::wstring  m_method;
-  si_buffer     m_response_buffer;
-  size_t        m_response_size;
-  size_t        m_retrieved_size;
-  si_stringmap  m_header;
-  si_stringmap  m_response_header;
-  int           m_response_errcode;
+  // the body to write to, a copy if a lease holds the current one.
+  // The caller holds m_csbody until it is done writing.
+  si_buffer& _writable_body();
+
+  // strings are kept in UTF-8, see request.h
+  url               m_url;
+  std::string       m_method;
+  // NULL until data arrives. Leases are taken from other threads while
+  // the pool writes, m_csbody orders them against the copy on write.
+  refptr<response_body> m_response_body;
+  critical_section  m_csbody;
+  size_t            m_response_size;
+  size_t            m_retrieved_size;
+  si_stringmap_utf8 m_header;
+  si_stringmap_utf8 m_response_header;
+  int               m_response_errcode;
   
-  int           m_request_outmode;
-  std::wstring  m_outfile;
+  int               m_request_outmode;
+  std::string       m_outfile;
 
   std::ofstream m_outstream;
 
   refptr<postdata> m_postdata;
+
+  int               m_request_error;
+  int               m_attempts;
+  int               m_retry_max_attempts;
+  int               m_retry_base_delay;
+  int               m_retry_max_delay;
+  int               m_retry_errors;
+  std::vector<int>  m_retry_status;
+
+  int               m_deadline;
+  int               m_connect_timeout;
+  int               m_first_byte_timeout;
+  int               m_low_speed_limit;
+  int               m_low_speed_time;
+
+  int               m_hedge_percentile;
+  int               m_hedge_delay;
+  std::vector<std::string> m_mirrors;
+
+  request_timing    m_timing;
+  std::string       m_effective_url;
 };
 
 } // namespace sinet
@@ -10,5 +10,7 @@
 #include "request.h"
 #include "task.h"
 #include "task_observer.h"
+#include "trace.h"
+#include "url.h"
 
 #endif // SINET_H
\ No newline at end of file
@@ -1,48 +1,397 @@
 #include "pch.h"
 #include "strings.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STRINGS_SIMD_AVX2
+#define STRINGS_SIMD_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRINGS_SIMD_SSE2
+#endif
+
 using namespace sinet;
 
-// Convert a std::wstring to a std::string (utf8)
-std::string strings::wstring_utf8string(const std::wstring& s)
+// replacement character for ill-formed input
+#define UNICODE_REPLACEMENT 0xFFFD
+// returned by the decoders for ill-formed input
+#define INVALID_CODEPOINT   0xFFFFFFFF
+
+// 2 on Windows (UTF-16), 4 on Linux and OS X (UTF-32)
+#define WCHAR_IS_UTF16      (sizeof(wchar_t) == 2)
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  ASCII fast paths
+//
+//    Strings crossing the API are mostly URLs and header lines, which
+//    are pure ASCII. These helpers find and copy ASCII runs 16 or 32
+//    code units at a time, the scalar decoders below only handle the
+//    rest.
+//
+
+// @returns the length of the leading run of ASCII bytes in |p|
+static size_t ascii_prefix(const unsigned char* p, size_t len)
 {
-#ifdef WIN32 
-  char* ch;
-  UINT bytes = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, NULL, 0,
-                                   NULL, NULL); 
-  ch = new char[bytes];
-  if(ch)
-    bytes = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, ch, bytes,
-                                NULL, NULL);
-  std::string str = ch;
-  delete[] ch;
-  return str;
+  size_t i = 0;
+#if defined(STRINGS_SIMD_AVX2)
+  // stop at the first block with a non-ASCII byte and let the
+  // narrower loops below locate it
+  for (; i + 32 <= len; i += 32)
+  {
+    if (_mm256_movemask_epi8(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i))))
+      break;
+  }
 #endif
-#ifdef _MAC_ 
-  return std::string((const char*)Utf8(s.c_str()));
+#if defined(STRINGS_SIMD_SSE2)
+  for (; i + 16 <= len; i += 16)
+  {
+    int mask = _mm_movemask_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+    if (mask)
+    {
+      while (p[i] < 0x80)
+        i++;
+      return i;
+    }
+  }
 #endif
-#ifdef __linux__
-  return wchar_utf8(s);
+  while (i < len && p[i] < 0x80)
+    i++;
+  return i;
+}
+
+// @returns the length of the leading run of code units below 0x80
+static size_t ascii_prefix(const wchar_t* p, size_t len)
+{
+  size_t i = 0;
+#if defined(STRINGS_SIMD_SSE2)
+  const size_t step = 16 / sizeof(wchar_t);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i high = WCHAR_IS_UTF16 ? _mm_set1_epi16((short)0xFF80)
+                                      : _mm_set1_epi32((int)0xFFFFFF80);
+  for (; i + step <= len; i += step)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, high), zero)) != 0xFFFF)
+      break;
+  }
+#endif
+  while (i < len && (unsigned int)p[i] < 0x80)
+    i++;
+  return i;
+}
+
+// widen |len| ASCII bytes from |in| to |out|
+static void widen_ascii(const unsigned char* in, size_t len, wchar_t* out)
+{
+  size_t i = 0;
+#if defined(STRINGS_SIMD_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    __m128i* dst = reinterpret_cast<__m128i*>(out + i);
+    if (WCHAR_IS_UTF16)
+    {
+      _mm_storeu_si128(dst, lo);
+      _mm_storeu_si128(dst + 1, hi);
+    }
+    else
+    {
+      _mm_storeu_si128(dst, _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+    }
+  }
+#endif
+  for (; i < len; i++)
+    out[i] = in[i];
+}
+
+// narrow |len| code units below 0x80 from |in| to |out|
+static void narrow_ascii(const wchar_t* in, size_t len, char* out)
+{
+  size_t i = 0;
+#if defined(STRINGS_SIMD_SSE2)
+  const __m128i* src = reinterpret_cast<const __m128i*>(in);
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i v;
+    if (WCHAR_IS_UTF16)
+    {
+      v = _mm_packus_epi16(_mm_loadu_si128(src), _mm_loadu_si128(src + 1));
+      src += 2;
+    }
+    else
+    {
+      // values are below 0x80, so the signed saturation is a plain narrowing
+      __m128i lo = _mm_packs_epi32(_mm_loadu_si128(src), _mm_loadu_si128(src + 1));
+      __m128i hi = _mm_packs_epi32(_mm_loadu_si128(src + 2), _mm_loadu_si128(src + 3));
+      v = _mm_packus_epi16(lo, hi);
+      src += 4;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+  }
 #endif
+  for (; i < len; i++)
+    out[i] = (char)in[i];
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  scalar decoding and encoding of a single code point
+//
+
+// decode one non-ASCII sequence at |p| (at most |len| bytes).
+// @returns the number of bytes consumed, always at least 1. For an
+// ill-formed sequence |cp| is set to INVALID_CODEPOINT and the maximal
+// valid subpart is consumed, as recommended by Unicode 6 chapter 3.9.
+static size_t decode_utf8(const unsigned char* p, size_t len, unsigned int& cp)
+{
+  unsigned int lead = p[0];
+  size_t need;
+  unsigned char lower = 0x80, upper = 0xBF;
+
+  if (lead >= 0xC2 && lead <= 0xDF)
+  {
+    need = 1;
+    cp = lead & 0x1F;
+  }
+  else if (lead >= 0xE0 && lead <= 0xEF)
+  {
+    need = 2;
+    cp = lead & 0x0F;
+    if (lead == 0xE0)
+      lower = 0xA0;   // overlong
+    else if (lead == 0xED)
+      upper = 0x9F;   // surrogates
+  }
+  else if (lead >= 0xF0 && lead <= 0xF4)
+  {
+    need = 3;
+    cp = lead & 0x07;
+    if (lead == 0xF0)
+      lower = 0x90;   // overlong
+    else if (lead == 0xF4)
+      upper = 0x8F;   // above U+10FFFF
+  }
+  else
+  {
+    cp = INVALID_CODEPOINT;
+    return 1;
+  }
+
+  for (size_t i = 1; i <= need; i++)
+  {
+    if (i >= len || p[i] < lower || p[i] > upper)
+    {
+      cp = INVALID_CODEPOINT;
+      return i;
+    }
+    cp = (cp << 6) | (p[i] & 0x3F);
+    lower = 0x80;
+    upper = 0xBF;
+  }
+  return need + 1;
+}
+
+// read one code point from |p| (at most |len| units, first one is not
+// ASCII). @returns the number of wchar_t consumed.
+static size_t decode_wide(const wchar_t* p, size_t len, unsigned int& cp)
+{
+  cp = (unsigned int)p[0];
+  if (WCHAR_IS_UTF16)
+  {
+    cp &= 0xFFFF;
+    if (cp >= 0xD800 && cp <= 0xDBFF && len > 1)
+    {
+      unsigned int trail = (unsigned int)p[1] & 0xFFFF;
+      if (trail >= 0xDC00 && trail <= 0xDFFF)
+      {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (trail - 0xDC00);
+        return 2;
+      }
+    }
+  }
+  if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+    cp = UNICODE_REPLACEMENT;
+  return 1;
+}
+
+static size_t utf8_length(unsigned int cp)
+{
+  return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+static char* encode_utf8(unsigned int cp, char* out)
+{
+  if (cp < 0x80)
+    *out++ = (char)cp;
+  else if (cp < 0x800)
+  {
+    *out++ = (char)(0xC0 | (cp >> 6));
+    *out++ = (char)(0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    *out++ = (char)(0xE0 | (cp >> 12));
+    *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+    *out++ = (char)(0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    *out++ = (char)(0xF0 | (cp >> 18));
+    *out++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+    *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+    *out++ = (char)(0x80 | (cp & 0x3F));
+  }
+  return out;
+}
+
+static wchar_t* encode_wide(unsigned int cp, wchar_t* out)
+{
+  if (WCHAR_IS_UTF16 && cp >= 0x10000)
+  {
+    cp -= 0x10000;
+    *out++ = (wchar_t)(0xD800 | (cp >> 10));
+    *out++ = (wchar_t)(0xDC00 | (cp & 0x3FF));
+  }
+  else
+    *out++ = (wchar_t)cp;
+  return out;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  strings
+//
+
+void strings::utf8_to_wide(const char* in, size_t len, std::wstring& out)
+{
+  const unsigned char* src = reinterpret_cast<const unsigned char*>(in);
+  unsigned int cp;
+
+  // pass 1: count output units
+  size_t count = 0;
+  for (size_t i = 0; i < len; )
+  {
+    size_t run = ascii_prefix(src + i, len - i);
+    count += run;
+    i += run;
+    if (i == len)
+      break;
+    i += decode_utf8(src + i, len - i, cp);
+    count += (WCHAR_IS_UTF16 && cp >= 0x10000 && cp != INVALID_CODEPOINT) ? 2 : 1;
+  }
+
+  out.resize(count);
+  if (count == 0)
+    return;
+
+  // pass 2: convert
+  wchar_t* dst = &out[0];
+  for (size_t i = 0; i < len; )
+  {
+    size_t run = ascii_prefix(src + i, len - i);
+    widen_ascii(src + i, run, dst);
+    dst += run;
+    i += run;
+    if (i == len)
+      break;
+    i += decode_utf8(src + i, len - i, cp);
+    dst = encode_wide(cp == INVALID_CODEPOINT ? UNICODE_REPLACEMENT : cp, dst);
+  }
+}
+
+void strings::wide_to_utf8(const wchar_t* in, size_t len, std::string& out)
+{
+  unsigned int cp;
+
+  // pass 1: count output bytes
+  size_t count = 0;
+  for (size_t i = 0; i < len; )
+  {
+    size_t run = ascii_prefix(in + i, len - i);
+    count += run;
+    i += run;
+    if (i == len)
+      break;
+    i += decode_wide(in + i, len - i, cp);
+    count += utf8_length(cp);
+  }
+
+  out.resize(count);
+  if (count == 0)
+    return;
+
+  // pass 2: convert
+  char* dst = &out[0];
+  for (size_t i = 0; i < len; )
+  {
+    size_t run = ascii_prefix(in + i, len - i);
+    narrow_ascii(in + i, run, dst);
+    dst += run;
+    i += run;
+    if (i == len)
+      break;
+    i += decode_wide(in + i, len - i, cp);
+    dst = encode_utf8(cp, dst);
+  }
+}
+
+int strings::is_valid_utf8(const char* in, size_t len)
+{
+  const unsigned char* src = reinterpret_cast<const unsigned char*>(in);
+  unsigned int cp;
+  for (size_t i = 0; i < len; )
+  {
+    i += ascii_prefix(src + i, len - i);
+    if (i == len)
+      break;
+    i += decode_utf8(src + i, len - i, cp);
+    if (cp == INVALID_CODEPOINT)
+      return 0;
+  }
+  return 1;
+}
+
+// Convert a std::wstring to a std::string (utf8)
+std::string strings::wstring_utf8string(const std::wstring& s)
+{
+  std::string str;
+  wide_to_utf8(s.c_str(), s.length(), str);
+  return str;
 }
 
 // Convert a std::string to a std::wstring (utf8)
 std::wstring strings::utf8string_wstring(const std::string& s)
 {
-#ifdef WIN32  
-  wchar_t* wch;
-  UINT bytes = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, NULL, 0);
-  wch  = new wchar_t[bytes];
-  if(wch)
-    bytes = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, wch, bytes);
-  std::wstring str = wch;
-  delete[] wch;
+  std::wstring str;
+  utf8_to_wide(s.c_str(), s.length(), str);
   return str;
-#endif
-#ifdef _MAC_
-  return std::wstring((const wchar_t*)Utf8(s.c_str()));
-#endif
-#ifdef __linux__
-  return utf8_wchar(s);
-#endif
+}
+
+void strings::wstringmap_utf8stringmap(const std::map<std::wstring, std::wstring>& in,
+                                       std::map<std::string, std::string>& out)
+{
+  out.clear();
+  for (std::map<std::wstring, std::wstring>::const_iterator it = in.begin();
+       it != in.end(); it++)
+    out.insert(out.end(), std::make_pair(wstring_utf8string(it->first),
+                                         wstring_utf8string(it->second)));
+}
+
+void strings::utf8stringmap_wstringmap(const std::map<std::string, std::string>& in,
+                                       std::map<std::wstring, std::wstring>& out)
+{
+  out.clear();
+  for (std::map<std::string, std::string>::const_iterator it = in.begin();
+       it != in.end(); it++)
+    out.insert(out.end(), std::make_pair(utf8string_wstring(it->first),
+                                         utf8string_wstring(it->second)));
 }
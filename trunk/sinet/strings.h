@@ -10,9 +10,27 @@ class strings
 public:
   static std::string wstring_utf8string(const std::wstring& s);
   static std::wstring utf8string_wstring(const std::string& s);
+
+  // transcoders behind the two functions above. wchar_t is taken as
+  // UTF-16 where it is 2 bytes wide (Windows) and as UTF-32 elsewhere.
+  // The input is validated: ill-formed sequences, UTF-8 encoded
+  // surrogates and unpaired UTF-16 surrogates come out as U+FFFD. The
+  // exact output length is computed before |out| is written to, so
+  // the destination is allocated only once.
+  static void utf8_to_wide(const char* in, size_t len, std::wstring& out);
+  static void wide_to_utf8(const wchar_t* in, size_t len, std::string& out);
+
+  // @returns 1 if |in| is well-formed UTF-8, 0 otherwise
+  static int is_valid_utf8(const char* in, size_t len);
+
+  // convert every key and value of a header map, replacing |out|
+  static void wstringmap_utf8stringmap(const std::map<std::wstring, std::wstring>& in,
+                                       std::map<std::string, std::string>& out);
+  static void utf8stringmap_wstringmap(const std::map<std::string, std::string>& in,
+                                       std::map<std::wstring, std::wstring>& out);
 };
 
 
 } // namespace sinet
 
-#endif // STRINGS_H
\ No newline at end of file
+#endif // STRINGS_H
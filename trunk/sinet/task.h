@@ -37,7 +37,7 @@ public:
 
   // append a new request to the task
   // @returns request_id (int)
-  virtual void append_request(refptr<request> request_in) = 0;
+  virtual void append_request(const refptr<request>& request_in) = 0;
   // erase a request by id
   // @returns 1 if succeeded, 0 if failed
   virtual int erase_request(int request_id) = 0;
@@ -63,9 +63,13 @@ public:
   virtual void attach_observer(itask_observer* observer_in) = 0;
   virtual void detach_observer() = 0;
   virtual itask_observer* get_observer() = 0;
+  // function pointers called along with the observer, see
+  // task_callbacks. Set them before pool::execute.
+  virtual void set_callbacks(const task_callbacks& callbacks) = 0;
+  virtual void get_callbacks(task_callbacks& callbacks) = 0;
 
   // for config definition
-  virtual void use_config(refptr<config> config) = 0;
+  virtual void use_config(const refptr<config>& config) = 0;
   virtual refptr<config> get_config() = 0;
 };
 
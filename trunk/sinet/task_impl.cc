@@ -4,6 +4,8 @@
 
 using namespace sinet;
 
+SINET_POOLED_NEW_IMPL(task_impl, 32)
+
 refptr<task> task::create_instance()
 {
   refptr<task> _task(new task_impl());
@@ -15,15 +17,18 @@ task_impl::task_impl(void):
   m_current_id(0),
   m_observer(NULL)
 {
+  memset(&m_callbacks, 0, sizeof(m_callbacks));
 }
 
 task_impl::~task_impl(void)
 {
 }
 
-void task_impl::append_request(refptr<request> request_in)
+void task_impl::append_request(const refptr<request>& request_in)
 {
   auto_criticalsection acs(m_csrequests);
+  if (request_in && is_published())
+    request_in->publish();
   m_requests[m_current_id++] = request_in;
 }
 
@@ -95,12 +100,37 @@ itask_observer* task_impl::get_observer()
   return m_observer;
 }
 
-void task_impl::use_config(refptr<config> config)
+void task_impl::set_callbacks(const task_callbacks& callbacks)
+{
+  auto_criticalsection acs(m_csrequests);
+  m_callbacks = callbacks;
+}
+
+void task_impl::get_callbacks(task_callbacks& callbacks)
 {
+  auto_criticalsection acs(m_csrequests);
+  callbacks = m_callbacks;
+}
+
+void task_impl::use_config(const refptr<config>& config)
+{
+  if (config && is_published())
+    config->publish();
   m_config = config;
 }
 
 refptr<config> task_impl::get_config()
 {
   return m_config;
+}
+
+void task_impl::publish()
+{
+  auto_criticalsection acs(m_csrequests);
+  local_base<task>::publish();
+  for (std::map<int, refptr<request> >::iterator it = m_requests.begin();
+       it != m_requests.end(); it++)
+    it->second->publish();
+  if (m_config)
+    m_config->publish();
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define SINET_TASK_IMPL_H
 
 #include "task.h"
+#include "object_pool.h"
 
 namespace sinet
 {
@@ -9,13 +10,15 @@ namespace sinet
 typedef void CURL;
 
 class task_impl:
-  public threadsafe_base<task>
+  public local_base<task>
 {
 public:
+  SINET_POOLED_NEW(task_impl)
+
   task_impl(void);
   ~task_impl(void);
 
-  virtual void append_request(refptr<request> request_in);
+  virtual void append_request(const refptr<request>& request_in);
   virtual int erase_request(int request_id);
   virtual void clearall_requests();
   virtual int get_request_count();
@@ -28,15 +31,20 @@ public:
   virtual void attach_observer(itask_observer* observer_in);
   virtual void detach_observer();
   virtual itask_observer* get_observer();
+  virtual void set_callbacks(const task_callbacks& callbacks);
+  virtual void get_callbacks(task_callbacks& callbacks);
 
-  virtual void use_config(refptr<config> config);
+  virtual void use_config(const refptr<config>& config);
   virtual refptr<config> get_config();
 
+  virtual void publish();
+
 private:
   int m_status;
   int m_current_id;
   refptr<config>                  m_config;
   itask_observer*                 m_observer;
+  task_callbacks                  m_callbacks;
   critical_section                m_csrequests;
   std::map<int, refptr<request> > m_requests;
 };
@@ -1,6 +1,16 @@
 #ifndef SINET_TASK_OBSERVER_H
 #define SINET_TASK_OBSERVER_H
 
+#include <stddef.h>
+
+#ifndef SINET_CALLBACK
+#if defined(WIN32)
+#define SINET_CALLBACK __stdcall
+#else
+#define SINET_CALLBACK
+#endif
+#endif
+
 namespace sinet
 {
 
@@ -8,6 +18,8 @@ namespace sinet
 //
 //  Interface for observer/callback mechanism
 //
+//    Gets the same calls as task_callbacks below, on the same threads.
+//
 class itask_observer
 {
 public:
@@ -15,6 +27,38 @@ public:
   virtual void status_change(int new_status) = 0;
 };
 
+//////////////////////////////////////////////////////////////////////////
+//
+//  task_callbacks struct
+//
+//    Plain function pointers for embedders that cannot implement
+//    itask_observer, each gets |user| back. NULL members are skipped.
+//
+//    on_status gets taskstatus_queued on the thread calling
+//    pool::execute, taskstatus_canceled on the one calling pool::cancel,
+//    taskstatus_running and taskstatus_completed on the pool thread with
+//    no pool lock held.
+//
+//    on_progress and on_data run on the pool thread in the middle of a
+//    pass, they must return quickly and must not call the pool other
+//    than pool::execute. on_progress gets the percentage of the bytes
+//    received out of the sizes the responses announced so far.
+//    on_data gets the body of a request as it arrives, |offset| is the
+//    position of |data| in it; a retry starts again at offset 0. A
+//    response taken from the cache, a hedge or a coalesced request
+//    arrives in one piece in REQ_OUTBUFFER mode, in REQ_OUTFILE mode it
+//    is read back from the out file once it is written. When a hedge
+//    wins after the request's own transfer streamed part of the body,
+//    only the rest of it follows.
+//
+typedef struct _task_callbacks{
+  void (SINET_CALLBACK *on_status)(void* user, int status);
+  void (SINET_CALLBACK *on_progress)(void* user, int progress);
+  void (SINET_CALLBACK *on_data)(void* user, int request_id, size_t offset,
+                                 const void* data, size_t size);
+  void* user;
+}task_callbacks;
+
 } // namespace sinet
 
 #endif // SINET_TASK_OBSERVER_H
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "token_bucket.h"
+
+using namespace sinet;
+
+token_bucket::token_bucket(void):
+  m_rate(0),
+  m_tokens(0),
+  m_last_ms(0)
+{
+
+}
+
+void token_bucket::set_rate(int rate, long long now_ms)
+{
+  if (rate < 0)
+    rate = 0;
+  if (rate == m_rate)
+    return;
+  refill(now_ms);
+  // a new limit starts with a full bucket
+  if (m_rate == 0 || m_tokens > rate)
+    m_tokens = rate;
+  m_rate = rate;
+  m_last_ms = now_ms;
+}
+
+int token_bucket::get_rate() const
+{
+  return m_rate;
+}
+
+int token_bucket::is_limited() const
+{
+  return m_rate > 0;
+}
+
+void token_bucket::refill(long long now_ms)
+{
+  if (m_rate <= 0 || now_ms <= m_last_ms)
+    return;
+  m_tokens += (double)m_rate * (now_ms - m_last_ms) / 1000;
+  if (m_tokens > m_rate)
+    m_tokens = m_rate;
+  m_last_ms = now_ms;
+}
+
+int token_bucket::available(double tokens) const
+{
+  return m_rate <= 0 || m_tokens >= tokens;
+}
+
+void token_bucket::consume(double tokens)
+{
+  if (m_rate > 0)
+    m_tokens -= tokens;
+}
@@ -0,0 +1,42 @@
+#ifndef SINET_TOKEN_BUCKET_H
+#define SINET_TOKEN_BUCKET_H
+
+namespace sinet
+{
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  token_bucket class
+//
+//    Refills at |rate| tokens per second up to one second worth of
+//    tokens. Used by the pool for request and byte rate limits. The
+//    caller passes the clock in, so all buckets of one scheduling pass
+//    see the same time. Not thread safe, the pool thread owns them.
+//
+class token_bucket
+{
+public:
+  token_bucket(void);
+
+  // tokens per second, 0 or less for no limit
+  void set_rate(int rate, long long now_ms);
+  int get_rate() const;
+  int is_limited() const;
+
+  // add the tokens earned since the last refill
+  void refill(long long now_ms);
+  // @returns 1 if |tokens| are in the bucket, or there is no limit
+  int available(double tokens) const;
+  // take |tokens|, the balance may go negative and is paid back by
+  // later refills
+  void consume(double tokens);
+
+private:
+  int       m_rate;
+  double    m_tokens;
+  long long m_last_ms;
+};
+
+} // namespace sinet
+
+#endif // SINET_TOKEN_BUCKET_H
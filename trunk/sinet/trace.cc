@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "trace.h"
+#include "api_base.h"
+#include <stdio.h>
+
+using namespace sinet;
+
+#ifdef SINET_ENABLE_TRACE
+
+typedef struct _trace_ring{
+  trace_event events[TRACE_RING_SIZE];
+  // events recorded, counted by the owner thread after it wrote one.
+  // Wraps around, |wrapped| tells a full ring from an empty one.
+  volatile long next;
+  volatile int  wrapped;
+  int           tid;
+  const char*   thread_name;
+  struct _trace_ring* older;
+}trace_ring;
+
+// the rings of all threads, newest first. Only registration and
+// trace_dump take the lock.
+static critical_section* rings_lock = new critical_section();
+static trace_ring* rings = NULL;
+static int rings_count = 0;
+
+#if defined(_WINDOWS_)
+static DWORD ring_key = ::TlsAlloc();
+#elif defined(_MAC_) || defined(__linux__)
+static pthread_key_t create_ring_key()
+{
+  pthread_key_t key;
+  pthread_key_create(&key, NULL);
+  return key;
+}
+static pthread_key_t ring_key = create_ring_key();
+#endif
+
+static trace_ring* current_ring()
+{
+#if defined(_WINDOWS_)
+  trace_ring* ring = (trace_ring*)::TlsGetValue(ring_key);
+#elif defined(_MAC_) || defined(__linux__)
+  trace_ring* ring = (trace_ring*)pthread_getspecific(ring_key);
+#endif
+  if (ring)
+    return ring;
+
+  ring = new trace_ring;
+  memset((void*)ring, 0, sizeof(trace_ring));
+  rings_lock->lock();
+  ring->tid = ++rings_count;
+  ring->older = rings;
+  rings = ring;
+  rings_lock->unlock();
+#if defined(_WINDOWS_)
+  ::TlsSetValue(ring_key, ring);
+#elif defined(_MAC_) || defined(__linux__)
+  pthread_setspecific(ring_key, ring);
+#endif
+  return ring;
+}
+
+long long sinet::trace_now_us()
+{
+#if defined(_WINDOWS_)
+  static LARGE_INTEGER frequency = {0};
+  if (!frequency.QuadPart)
+    ::QueryPerformanceFrequency(&frequency);
+  LARGE_INTEGER now;
+  ::QueryPerformanceCounter(&now);
+  // split so that the product does not overflow
+  return now.QuadPart / frequency.QuadPart * 1000000 +
+    now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#elif defined(__linux__)
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#elif defined(_MAC_)
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (long long)now.tv_sec * 1000000 + now.tv_usec;
+#endif
+}
+
+void sinet::trace_record(const char* name, long long start_us,
+                         long long duration_us, long long arg)
+{
+  trace_ring* ring = current_ring();
+  trace_event& event = ring->events[(unsigned long)ring->next % TRACE_RING_SIZE];
+  event.name = name;
+  event.start_us = start_us;
+  event.duration_us = duration_us;
+  event.arg = arg;
+  // a full barrier, trace_dump sees the event before the count
+  if ((unsigned long)atomic_increment(&ring->next) == TRACE_RING_SIZE)
+    ring->wrapped = 1;
+}
+
+void sinet::trace_thread_name(const char* name)
+{
+  current_ring()->thread_name = name;
+}
+
+static void append_name(std::string& json, const char* name)
+{
+  for (; *name; name++)
+  {
+    if (*name == '"' || *name == '\\')
+      json.push_back('\\');
+    json.push_back(*name);
+  }
+}
+
+static void append_event(std::string& json, const trace_event& event, int tid)
+{
+  char fields[160];
+  if (event.duration_us < 0)
+    sprintf(fields, "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld,\"pid\":1,\"tid\":%d}",
+      event.start_us, tid);
+  else
+    sprintf(fields, "\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d,"
+      "\"args\":{\"arg\":%lld}}", event.start_us, event.duration_us, tid, event.arg);
+  json.append(",\n{\"name\":\"");
+  append_name(json, event.name);
+  json.append(fields);
+}
+
+#endif // SINET_ENABLE_TRACE
+
+void sinet::trace_dump(std::string& json)
+{
+  json = "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+    "\"args\":{\"name\":\"sinet\"}}";
+#ifdef SINET_ENABLE_TRACE
+  std::vector<trace_event> events;
+  auto_criticalsection acs(*rings_lock);
+  for (trace_ring* ring = rings; ring; ring = ring->older)
+  {
+    unsigned long end = (unsigned long)ring->next;
+    unsigned long count = (ring->wrapped || end > TRACE_RING_SIZE) ? TRACE_RING_SIZE : end;
+    events.resize(0);
+    for (unsigned long seq = end - count; seq != end; seq++)
+      events.push_back(ring->events[seq % TRACE_RING_SIZE]);
+    // the owner may have overwritten the oldest ones meanwhile. In a
+    // full ring the oldest slot is also the one it writes next.
+    unsigned long overwritten = (unsigned long)ring->next - end;
+    if (count == TRACE_RING_SIZE)
+      overwritten++;
+    size_t first = overwritten < count ? overwritten : count;
+
+    if (ring->thread_name)
+    {
+      char fields[64];
+      sprintf(fields, "\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", ring->tid);
+      json.append(",\n{\"name\":\"thread_name");
+      json.append(fields);
+      append_name(json, ring->thread_name);
+      json.append("\"}}");
+    }
+    for (size_t i = first; i < events.size(); i++)
+      append_event(json, events[i], ring->tid);
+  }
+#endif
+  json.append("\n]}\n");
+}
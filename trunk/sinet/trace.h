@@ -0,0 +1,92 @@
+#ifndef SINET_TRACE_H
+#define SINET_TRACE_H
+
+#include <string>
+
+namespace sinet
+{
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  trace
+//
+//    Instrumentation points on the hot paths of the pool, compiled in
+//    with SINET_ENABLE_TRACE defined. Without it the SINET_TRACE_*
+//    macros expand to nothing.
+//
+//    Each thread records into a ring of its own that holds the last
+//    TRACE_RING_SIZE events, so recording takes no lock. A ring is
+//    registered the first time its thread records and stays allocated
+//    for the life of the process. trace_dump() writes all rings out
+//    as Chrome trace JSON for chrome://tracing or ui.perfetto.dev,
+//    events recorded while it runs may be left out.
+//
+//    Event and thread names must be string literals, only the pointer
+//    is kept.
+//
+
+#define TRACE_RING_SIZE 8192
+
+// a complete event, or an instant one with |duration_us| -1
+typedef struct _trace_event{
+  const char* name;
+  long long   start_us;
+  long long   duration_us;
+  long long   arg;
+}trace_event;
+
+// Chrome trace JSON of the events in the rings, no events when built
+// without SINET_ENABLE_TRACE
+void trace_dump(std::string& json);
+
+#ifdef SINET_ENABLE_TRACE
+
+// microseconds on a monotonic clock
+long long trace_now_us();
+// record an event on the ring of the calling thread
+void trace_record(const char* name, long long start_us,
+                  long long duration_us, long long arg);
+// name the calling thread in the dump
+void trace_thread_name(const char* name);
+
+// records the time from its construction to the end of its scope
+class trace_scope
+{
+public:
+  trace_scope(const char* name, long long arg = 0):
+    m_name(name), m_arg(arg), m_start(trace_now_us()) {}
+  ~trace_scope()
+  {
+    trace_record(m_name, m_start, trace_now_us() - m_start, m_arg);
+  }
+
+private:
+  const char* m_name;
+  long long   m_arg;
+  long long   m_start;
+};
+
+#define SINET_TRACE_CONCAT2(a, b)   a##b
+#define SINET_TRACE_CONCAT(a, b)    SINET_TRACE_CONCAT2(a, b)
+// time the rest of the enclosing scope, |arg| is shown with the event
+#define SINET_TRACE_SCOPE(name) \
+  sinet::trace_scope SINET_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define SINET_TRACE_SCOPE_ARG(name, arg) \
+  sinet::trace_scope SINET_TRACE_CONCAT(trace_scope_, __LINE__)(name, (long long)(arg))
+#define SINET_TRACE_INSTANT(name) \
+  sinet::trace_record(name, sinet::trace_now_us(), -1, 0)
+#define SINET_TRACE_THREAD_NAME(name) \
+  sinet::trace_thread_name(name)
+
+#else
+
+#define SINET_TRACE_SCOPE(name)
+#define SINET_TRACE_SCOPE_ARG(name, arg)
+#define SINET_TRACE_INSTANT(name)
+#define SINET_TRACE_THREAD_NAME(name)
+
+#endif // SINET_ENABLE_TRACE
+
+} // namespace sinet
+
+#endif // SINET_TRACE_H
@@ -0,0 +1,424 @@
+#include "pch.h"
+#include "url.h"
+#include "urls.h"
+#include "strings.h"
+
+using namespace sinet;
+
+static std::string to_lower(const std::string& s)
+{
+  std::string ret(s);
+  for (size_t i = 0; i < ret.length(); i++)
+    if (ret[i] >= 'A' && ret[i] <= 'Z')
+      ret[i] = ret[i] - 'A' + 'a';
+  return ret;
+}
+
+static void append_int(std::string& out, int value)
+{
+  char buf[16];
+  int len = 0;
+  do
+  {
+    buf[len++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0 && len < (int)sizeof(buf));
+  while (len > 0)
+    out.push_back(buf[--len]);
+}
+
+// RFC 3986 5.2.4
+static std::string remove_dot_segments(const std::string& path)
+{
+  std::string in(path), out;
+  while (!in.empty())
+  {
+    if (in.compare(0, 3, "../") == 0)
+      in.erase(0, 3);
+    else if (in.compare(0, 2, "./") == 0 || in.compare(0, 3, "/./") == 0)
+      in.erase(0, 2);
+    else if (in == "/.")
+      in = "/";
+    else if (in.compare(0, 4, "/../") == 0 || in == "/..")
+    {
+      in = (in.length() == 3) ? "/" : in.substr(3);
+      size_t slash = out.rfind('/');
+      out.erase(slash == std::string::npos ? 0 : slash);
+    }
+    else if (in == "." || in == "..")
+      in.clear();
+    else
+    {
+      size_t next = in.find('/', 1);
+      if (next == std::string::npos)
+        next = in.length();
+      out.append(in, 0, next);
+      in.erase(0, next);
+    }
+  }
+  return out;
+}
+
+// upper-case the hex digits of %xx escapes
+static void upper_escapes(std::string& s)
+{
+  for (size_t i = 0; i + 2 < s.length(); i++)
+  {
+    if (s[i] != '%')
+      continue;
+    for (size_t j = i + 1; j <= i + 2; j++)
+      if (s[j] >= 'a' && s[j] <= 'f')
+        s[j] = s[j] - 'a' + 'A';
+    i += 2;
+  }
+}
+
+url::url(void):
+  m_port(0),
+  m_has_query(0),
+  m_has_fragment(0),
+  m_valid(0),
+  m_spec_built(1),
+  m_origin_built(1)
+{
+
+}
+
+url::url(const char* spec):
+  m_port(0),
+  m_has_query(0),
+  m_has_fragment(0),
+  m_valid(0),
+  m_spec_built(1),
+  m_origin_built(1)
+{
+  parse(spec ? spec : "");
+}
+
+url::url(const std::string& spec):
+  m_port(0),
+  m_has_query(0),
+  m_has_fragment(0),
+  m_valid(0),
+  m_spec_built(1),
+  m_origin_built(1)
+{
+  parse(spec);
+}
+
+url::url(const std::wstring& spec):
+  m_port(0),
+  m_has_query(0),
+  m_has_fragment(0),
+  m_valid(0),
+  m_spec_built(1),
+  m_origin_built(1)
+{
+  parse(strings::wstring_utf8string(spec));
+}
+
+int url::parse(const std::string& spec)
+{
+  m_scheme.clear();
+  m_userinfo.clear();
+  m_host.clear();
+  m_port = 0;
+  m_path.clear();
+  m_query.clear();
+  m_fragment.clear();
+  m_has_query = 0;
+  m_has_fragment = 0;
+  m_valid = 0;
+
+  // keep the caller's spelling, it is only rebuilt once a component
+  // is changed
+  m_spec = spec;
+  m_spec_built = 1;
+  m_origin.clear();
+  m_origin_built = 0;
+
+  size_t scheme_end = spec.find("://");
+  if (scheme_end == std::string::npos || scheme_end == 0 ||
+    spec.find_first_of("/?#") < scheme_end)
+    return 0;
+
+  size_t authority_begin = scheme_end + 3;
+  size_t authority_end = spec.find_first_of("/?#", authority_begin);
+  if (authority_end == std::string::npos)
+    authority_end = spec.length();
+
+  size_t host_begin = authority_begin;
+  size_t at = spec.rfind('@', authority_end - 1);
+  if (at != std::string::npos && at >= authority_begin)
+    host_begin = at + 1;
+
+  // "[::1]:8080" keeps its brackets in the host
+  size_t host_end = authority_end;
+  size_t colon = std::string::npos;
+  if (host_begin < authority_end && spec[host_begin] == '[')
+  {
+    size_t bracket = spec.find(']', host_begin);
+    if (bracket == std::string::npos || bracket >= authority_end)
+      return 0;
+    if (bracket + 1 < authority_end)
+    {
+      if (spec[bracket + 1] != ':')
+        return 0;
+      colon = bracket + 1;
+    }
+  }
+  else
+  {
+    colon = spec.find(':', host_begin);
+    if (colon >= authority_end)
+      colon = std::string::npos;
+  }
+
+  int port = 0;
+  if (colon != std::string::npos)
+  {
+    host_end = colon;
+    for (size_t i = colon + 1; i < authority_end; i++)
+    {
+      if (spec[i] < '0' || spec[i] > '9' || port > 65535)
+        return 0;
+      port = port * 10 + (spec[i] - '0');
+    }
+    if (port > 65535)
+      return 0;
+  }
+
+  if (host_end == host_begin)
+    return 0;
+
+  size_t path_end = spec.find_first_of("?#", authority_end);
+  if (path_end == std::string::npos)
+    path_end = spec.length();
+  size_t query_end = spec.find('#', path_end);
+  if (query_end == std::string::npos)
+    query_end = spec.length();
+
+  m_scheme.assign(spec, 0, scheme_end);
+  if (host_begin > authority_begin)
+    m_userinfo.assign(spec, authority_begin, host_begin - 1 - authority_begin);
+  m_host.assign(spec, host_begin, host_end - host_begin);
+  m_port = port;
+  m_path.assign(spec, authority_end, path_end - authority_end);
+  if (path_end < spec.length() && spec[path_end] == '?')
+  {
+    m_has_query = 1;
+    m_query.assign(spec, path_end + 1, query_end - path_end - 1);
+  }
+  if (query_end < spec.length())
+  {
+    m_has_fragment = 1;
+    m_fragment.assign(spec, query_end + 1, std::string::npos);
+  }
+  m_valid = 1;
+  return 1;
+}
+
+int url::is_valid() const
+{
+  return m_valid;
+}
+
+const std::string& url::get_scheme() const
+{
+  return m_scheme;
+}
+
+void url::set_scheme(const std::string& scheme)
+{
+  m_scheme = scheme;
+  _invalidate();
+}
+
+const std::string& url::get_userinfo() const
+{
+  return m_userinfo;
+}
+
+void url::set_userinfo(const std::string& userinfo)
+{
+  m_userinfo = userinfo;
+  _invalidate();
+}
+
+const std::string& url::get_host() const
+{
+  return m_host;
+}
+
+void url::set_host(const std::string& host)
+{
+  m_host = host;
+  _invalidate();
+}
+
+int url::get_port() const
+{
+  return m_port;
+}
+
+void url::set_port(int port)
+{
+  m_port = port;
+  _invalidate();
+}
+
+int url::get_effective_port() const
+{
+  return m_port ? m_port : default_port(m_scheme);
+}
+
+const std::string& url::get_path() const
+{
+  return m_path;
+}
+
+void url::set_path(const std::string& path)
+{
+  m_path = path;
+  _invalidate();
+}
+
+const std::string& url::get_query() const
+{
+  return m_query;
+}
+
+void url::set_query(const std::string& query)
+{
+  m_query = query;
+  m_has_query = !query.empty();
+  _invalidate();
+}
+
+const std::string& url::get_fragment() const
+{
+  return m_fragment;
+}
+
+void url::set_fragment(const std::string& fragment)
+{
+  m_fragment = fragment;
+  m_has_fragment = !fragment.empty();
+  _invalidate();
+}
+
+void url::append_query(const std::string& key, const std::string& value)
+{
+  if (!m_query.empty())
+    m_query.push_back('&');
+  urls::encode(key.data(), key.length(), m_query);
+  m_query.push_back('=');
+  urls::encode(value.data(), value.length(), m_query);
+  m_has_query = 1;
+  _invalidate();
+}
+
+void url::append_query(const si_stringmap_utf8& params)
+{
+  if (params.empty())
+    return;
+  if (!m_query.empty())
+    m_query.push_back('&');
+  urls::build_query(params, m_query);
+  m_has_query = 1;
+  _invalidate();
+}
+
+void url::normalize()
+{
+  if (!m_valid)
+    return;
+  m_scheme = to_lower(m_scheme);
+  m_host = to_lower(m_host);
+  if (m_port == default_port(m_scheme))
+    m_port = 0;
+  m_path = remove_dot_segments(m_path);
+  if (m_path.empty())
+    m_path = "/";
+  upper_escapes(m_path);
+  upper_escapes(m_query);
+  _invalidate();
+}
+
+const std::string& url::get_spec() const
+{
+  if (!m_spec_built)
+  {
+    m_spec.clear();
+    m_spec.reserve(m_scheme.length() + m_userinfo.length() + m_host.length() +
+      m_path.length() + m_query.length() + m_fragment.length() + 16);
+    m_spec.append(m_scheme);
+    m_spec.append("://");
+    if (!m_userinfo.empty())
+    {
+      m_spec.append(m_userinfo);
+      m_spec.push_back('@');
+    }
+    m_spec.append(m_host);
+    if (m_port)
+    {
+      m_spec.push_back(':');
+      append_int(m_spec, m_port);
+    }
+    m_spec.append(m_path);
+    if (m_has_query)
+    {
+      m_spec.push_back('?');
+      m_spec.append(m_query);
+    }
+    if (m_has_fragment)
+    {
+      m_spec.push_back('#');
+      m_spec.append(m_fragment);
+    }
+    m_spec_built = 1;
+  }
+  return m_spec;
+}
+
+std::wstring url::get_spec_wide() const
+{
+  return strings::utf8string_wstring(get_spec());
+}
+
+const std::string& url::get_origin() const
+{
+  if (!m_origin_built)
+  {
+    m_origin.clear();
+    if (m_valid)
+    {
+      m_origin = to_lower(m_scheme);
+      m_origin.append("://");
+      m_origin.append(to_lower(m_host));
+      m_origin.push_back(':');
+      append_int(m_origin, get_effective_port());
+    }
+    m_origin_built = 1;
+  }
+  return m_origin;
+}
+
+int url::default_port(const std::string& scheme)
+{
+  std::string lower = to_lower(scheme);
+  if (lower == "http")
+    return 80;
+  if (lower == "https")
+    return 443;
+  if (lower == "ftp")
+    return 21;
+  return 0;
+}
+
+void url::_invalidate()
+{
+  m_valid = !m_scheme.empty() && !m_host.empty();
+  m_spec_built = 0;
+  m_origin_built = 0;
+}
@@ -0,0 +1,98 @@
+#ifndef SINET_URL_H
+#define SINET_URL_H
+
+#include "api_types.h"
+
+namespace sinet
+{
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  url class
+//
+//    A url split into its components, all stored as UTF-8:
+//
+//      scheme://userinfo@host:port/path?query#fragment
+//
+//    The full url (spec) and the origin key ("scheme://host:port") are
+//    built on first use and cached until a component changes, so a
+//    request can hand the same url to curl and to the pool's per-origin
+//    bookkeeping without parsing or formatting it again.
+//
+//    Unlike the refcounted api classes, url is a plain value type.
+//
+class url
+{
+public:
+  url(void);
+  explicit url(const char* spec);
+  explicit url(const std::string& spec);
+  explicit url(const std::wstring& spec);
+
+  // replace the url with |spec|
+  // @returns 1 if |spec| has a scheme and a host, 0 otherwise. A url
+  //          that fails to parse keeps |spec| as its spec unchanged.
+  int parse(const std::string& spec);
+  int is_valid() const;
+
+  const std::string& get_scheme() const;
+  void set_scheme(const std::string& scheme);
+  const std::string& get_userinfo() const;
+  void set_userinfo(const std::string& userinfo);
+  const std::string& get_host() const;
+  void set_host(const std::string& host);
+  // 0 when the url has no explicit port
+  int get_port() const;
+  void set_port(int port);
+  // the explicit port, or the scheme's default port
+  int get_effective_port() const;
+  const std::string& get_path() const;
+  void set_path(const std::string& path);
+  // without the leading '?'
+  const std::string& get_query() const;
+  void set_query(const std::string& query);
+  const std::string& get_fragment() const;
+  void set_fragment(const std::string& fragment);
+
+  // append "key=value" to the query, percent-encoding both
+  void append_query(const std::string& key, const std::string& value);
+  void append_query(const si_stringmap_utf8& params);
+
+  // lower-case scheme and host, drop the default port, remove "." and
+  // ".." path segments, use "/" for an empty path and upper-case the
+  // hex digits of percent escapes
+  void normalize();
+
+  // the full url
+  const std::string& get_spec() const;
+  std::wstring get_spec_wide() const;
+  // "scheme://host:port" with the effective port, empty when invalid.
+  // Requests with the same origin can share connections.
+  const std::string& get_origin() const;
+
+  // @returns the default port of |scheme|, 0 if unknown
+  static int default_port(const std::string& scheme);
+
+private:
+  void _invalidate();
+
+  std::string m_scheme;
+  std::string m_userinfo;
+  std::string m_host;
+  int         m_port;
+  std::string m_path;
+  std::string m_query;
+  std::string m_fragment;
+  int         m_has_query;
+  int         m_has_fragment;
+  int         m_valid;
+
+  mutable std::string m_spec;
+  mutable int         m_spec_built;
+  mutable std::string m_origin;
+  mutable int         m_origin_built;
+};
+
+} // namespace sinet
+
+#endif // SINET_URL_H
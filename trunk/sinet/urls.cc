@@ -0,0 +1,234 @@
+#include "pch.h"
+#include "urls.h"
+#include "strings.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define URLS_SIMD_SSE2
+#endif
+
+using namespace sinet;
+
+// 1 for the RFC 3986 unreserved bytes, copied unescaped: [A-Za-z0-9-._~]
+static const unsigned char s_safe[256] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// value of a hex digit, -1 for other bytes
+static const signed char s_hexval[256] =
+{
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const char s_hexdigits[] = "0123456789ABCDEF";
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  Run scanners
+//
+//    Query values are mostly plain words and numbers. These find the
+//    next byte that needs work 16 bytes at a time, the table driven
+//    loops below only look at the bytes around it.
+//
+
+// @returns the length of the leading run of unreserved bytes in |p|
+static size_t safe_prefix(const unsigned char* p, size_t len)
+{
+  size_t i = 0;
+#if defined(URLS_SIMD_SSE2)
+  // bytes above 0x7F are negative as signed chars and fall outside
+  // every range. Letters are folded to lower case with | 0x20, digits
+  // are tested unfolded since 0x10-0x19 would fold into '0'-'9'.
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  const __m128i digit_lo = _mm_set1_epi8('0' - 1);
+  const __m128i digit_hi = _mm_set1_epi8('9' + 1);
+  const __m128i alpha_lo = _mm_set1_epi8('a' - 1);
+  const __m128i alpha_hi = _mm_set1_epi8('z' + 1);
+  const __m128i dash = _mm_set1_epi8('-');
+  const __m128i dot = _mm_set1_epi8('.');
+  const __m128i underscore = _mm_set1_epi8('_');
+  const __m128i tilde = _mm_set1_epi8('~');
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    __m128i lower = _mm_or_si128(v, case_bit);
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, digit_lo),
+                                  _mm_cmplt_epi8(v, digit_hi));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, alpha_lo),
+                                  _mm_cmplt_epi8(lower, alpha_hi));
+    __m128i mark = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, dash), _mm_cmpeq_epi8(v, dot)),
+      _mm_or_si128(_mm_cmpeq_epi8(v, underscore), _mm_cmpeq_epi8(v, tilde)));
+    if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, alpha), mark)) != 0xFFFF)
+      break;
+  }
+#endif
+  while (i < len && s_safe[p[i]])
+    i++;
+  return i;
+}
+
+// @returns the offset of the first '%' in |p|, or |len|
+static size_t percent_offset(const unsigned char* p, size_t len)
+{
+  size_t i = 0;
+#if defined(URLS_SIMD_SSE2)
+  const __m128i percent = _mm_set1_epi8('%');
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, percent)))
+      break;
+  }
+#endif
+  while (i < len && p[i] != '%')
+    i++;
+  return i;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+//  urls
+//
+
+void urls::encode(const char* in, size_t len, std::string& out)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+
+  // size the output exactly before writing it
+  size_t outlen = 0;
+  for (size_t i = 0; i < len; )
+  {
+    size_t run = safe_prefix(p + i, len - i);
+    outlen += run;
+    i += run;
+    for (; i < len && !s_safe[p[i]]; i++)
+      outlen += 3;
+  }
+
+  size_t pos = out.size();
+  out.resize(pos + outlen);
+  char* dst = outlen ? &out[pos] : NULL;
+  for (size_t i = 0; i < len; )
+  {
+    size_t run = safe_prefix(p + i, len - i);
+    memcpy(dst, p + i, run);
+    dst += run;
+    i += run;
+    for (; i < len && !s_safe[p[i]]; i++)
+    {
+      dst[0] = '%';
+      dst[1] = s_hexdigits[p[i] >> 4];
+      dst[2] = s_hexdigits[p[i] & 0x0F];
+      dst += 3;
+    }
+  }
+}
+
+std::string urls::encode(const std::string& s)
+{
+  std::string out;
+  encode(s.data(), s.length(), out);
+  return out;
+}
+
+std::wstring urls::encode(const std::wstring& s)
+{
+  std::string utf8, out;
+  strings::wide_to_utf8(s.data(), s.length(), utf8);
+  encode(utf8.data(), utf8.length(), out);
+  return strings::utf8string_wstring(out);
+}
+
+void urls::decode(const char* in, size_t len, std::string& out)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+
+  // decoding never grows the string, reserve the worst case
+  out.reserve(out.size() + len);
+  for (size_t i = 0; i < len; )
+  {
+    size_t run = percent_offset(p + i, len - i);
+    out.append(in + i, run);
+    i += run;
+    if (i == len)
+      break;
+    if (i + 2 < len && s_hexval[p[i + 1]] >= 0 && s_hexval[p[i + 2]] >= 0)
+    {
+      out.push_back((char)((s_hexval[p[i + 1]] << 4) | s_hexval[p[i + 2]]));
+      i += 3;
+    }
+    else
+      out.push_back(in[i++]);
+  }
+}
+
+std::string urls::decode(const std::string& s)
+{
+  std::string out;
+  decode(s.data(), s.length(), out);
+  return out;
+}
+
+std::wstring urls::decode(const std::wstring& s)
+{
+  std::string utf8, out;
+  strings::wide_to_utf8(s.data(), s.length(), utf8);
+  decode(utf8.data(), utf8.length(), out);
+  std::wstring ret;
+  strings::utf8_to_wide(out.data(), out.length(), ret);
+  return ret;
+}
+
+void urls::build_query(const si_stringmap_utf8& params, std::string& out)
+{
+  for (si_stringmap_utf8::const_iterator it = params.begin();
+    it != params.end(); it++)
+  {
+    if (it != params.begin())
+      out.push_back('&');
+    encode(it->first.data(), it->first.length(), out);
+    out.push_back('=');
+    encode(it->second.data(), it->second.length(), out);
+  }
+}
+
+std::wstring urls::build_query(const si_stringmap& params)
+{
+  si_stringmap_utf8 params_utf8;
+  strings::wstringmap_utf8stringmap(params, params_utf8);
+  std::string out;
+  build_query(params_utf8, out);
+  return strings::utf8string_wstring(out);
+}
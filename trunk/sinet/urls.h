@@ -0,0 +1,37 @@
+#ifndef URLS_H
+#define URLS_H
+
+#include "api_types.h"
+
+namespace sinet
+{
+
+
+class urls
+{
+public:
+  // percent-encode every byte except the RFC 3986 unreserved set
+  // [A-Za-z0-9-._~], as current curl_easy_escape does. The encoded
+  // form is appended to |out|.
+  static void encode(const char* in, size_t len, std::string& out);
+  static std::string encode(const std::string& s);
+  // wide strings are encoded as UTF-8
+  static std::wstring encode(const std::wstring& s);
+
+  // decode %XX sequences, anything else (including malformed escapes)
+  // is copied as-is, like curl_easy_unescape. Appends to |out|.
+  static void decode(const char* in, size_t len, std::string& out);
+  static std::string decode(const std::string& s);
+  // the decoded bytes are taken as UTF-8
+  static std::wstring decode(const std::wstring& s);
+
+  // build "key1=value1&key2=value2" with every key and value encoded,
+  // appended to |out| so it can follow a url and '?' directly
+  static void build_query(const si_stringmap_utf8& params, std::string& out);
+  static std::wstring build_query(const si_stringmap& params);
+};
+
+
+} // namespace sinet
+
+#endif // URLS_H
@@ -1,5 +1,8 @@
 #include "pch.h"
 #include "buffer_capi.h"
+#include "../sinet/request.h"
+
+using namespace sinet;
 
 SINET_DYN_API _buffer_t _buffer_alloc(unsigned char* buffer, size_t buffer_size)
 {
@@ -37,4 +40,28 @@ SINET_DYN_API unsigned char* _buffer_get(_buffer_t buffer)
     return NULL;
 
   return &(*real_buf)[0];
+}
+
+// a lease is the shared_buffer itself, holding one reference
+
+SINET_DYN_API const unsigned char* _buffer_lease_get(_buffer_lease_t lease)
+{
+  if (!lease)
+    return NULL;
+
+  return reinterpret_cast<shared_buffer*>(lease)->get_data();
+}
+
+SINET_DYN_API size_t _buffer_lease_size(_buffer_lease_t lease)
+{
+  if (!lease)
+    return 0;
+
+  return reinterpret_cast<shared_buffer*>(lease)->get_size();
+}
+
+SINET_DYN_API void _buffer_lease_release(_buffer_lease_t lease)
+{
+  if (lease)
+    reinterpret_cast<shared_buffer*>(lease)->Release();
 }
\ No newline at end of file
@@ -13,6 +13,13 @@ extern "C" {
   SINET_DYN_API void _buffer_free(_buffer_t buffer);
   SINET_DYN_API unsigned char* _buffer_get(_buffer_t buffer);
 
+  // a response body borrowed from its request without a copy, the
+  // bytes stay valid until the lease is released
+  typedef void* _buffer_lease_t;
+  SINET_DYN_API const unsigned char* _buffer_lease_get(_buffer_lease_t lease);
+  SINET_DYN_API size_t _buffer_lease_size(_buffer_lease_t lease);
+  SINET_DYN_API void _buffer_lease_release(_buffer_lease_t lease);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,10 +32,55 @@ int SINET_DYN_CALLBACK _remove_strvar(struct __config_t* self, int id)
   return config_cpptoc::Get(self)->remove_strvar(id);
 }
 
+int SINET_DYN_CALLBACK _get_strvar_utf8(struct __config_t* self, int id, _utf8string_t* strvarout)
+{
+  std::string strvar;
+  if (config_cpptoc::Get(self)->get_strvar_utf8(id, strvar))
+  {
+    *strvarout = _utf8string_alloc_length(strvar.c_str(), strvar.length());
+    return 1;
+  }
+  return 0;
+}
+
+int SINET_DYN_CALLBACK _copy_strvar_utf8(struct __config_t* self, int id, char* strvar_out, int* length_inout)
+{
+  std::string strvar;
+  if (!config_cpptoc::Get(self)->get_strvar_utf8(id, strvar))
+    return 0;
+  return _utf8string_copy(strvar.c_str(), strvar.length(), strvar_out, length_inout) ? 1 : -1;
+}
+
+void SINET_DYN_CALLBACK _set_strvar_utf8(struct __config_t* self, int id, const char* strvarin)
+{
+  config_cpptoc::Get(self)->set_strvar_utf8(id, strvarin);
+}
+
+int SINET_DYN_CALLBACK _get_intvar(struct __config_t* self, int id, int* intvarout)
+{
+  return config_cpptoc::Get(self)->get_intvar(id, *intvarout);
+}
+
+void SINET_DYN_CALLBACK _set_intvar(struct __config_t* self, int id, int intvarin)
+{
+  config_cpptoc::Get(self)->set_intvar(id, intvarin);
+}
+
+int SINET_DYN_CALLBACK _remove_intvar(struct __config_t* self, int id)
+{
+  return config_cpptoc::Get(self)->remove_intvar(id);
+}
+
 config_cpptoc::config_cpptoc(config* cls) :
   cpptoc<config_cpptoc, config, _config_t>(cls)
 {
   struct_.struct_.get_strvar    = _get_strvar;
   struct_.struct_.remove_strvar = _remove_strvar;
   struct_.struct_.set_strvar    = _set_strvar;
+  struct_.struct_.get_strvar_utf8 = _get_strvar_utf8;
+  struct_.struct_.set_strvar_utf8 = _set_strvar_utf8;
+  struct_.struct_.get_intvar    = _get_intvar;
+  struct_.struct_.set_intvar    = _set_intvar;
+  struct_.struct_.remove_intvar = _remove_intvar;
+  struct_.struct_.copy_strvar_utf8 = _copy_strvar_utf8;
 }
\ No newline at end of file
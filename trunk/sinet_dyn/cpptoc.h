@@ -24,8 +24,10 @@ public:
 
   // Use this method to create a wrapper structure for passing our class
   // instance to the other side.
-  static StructName* Wrap(refptr<BaseName> c)
+  static StructName* Wrap(const refptr<BaseName>& c)
   {
+    // C callers may use the object from any thread
+    c->publish();
     // Wrap our object with the cpptoc class.
     ClassName* wrapper = new ClassName(c);
     // Add a reference to our wrapper object that will be released once our
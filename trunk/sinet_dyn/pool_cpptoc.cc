@@ -1,6 +1,9 @@
 #include "pch.h"
 #include "pool_cpptoc.h"
 #include "task_cpptoc.h"
+#include "config_cpptoc.h"
+#include "postdata_cpptoc.h"
+#include "../sinet/trace.h"
 
 using namespace sinet;
 
@@ -12,6 +15,25 @@ SINET_DYN_API _pool_t* _pool_create_instance()
   return NULL;
 }
 
+SINET_DYN_API int _sinet_capi_version()
+{
+  return SINET_CAPI_VERSION;
+}
+
+SINET_DYN_API _utf8string_t _sinet_trace_dump()
+{
+  std::string json;
+  trace_dump(json);
+  return _utf8string_alloc_length(json.c_str(), json.length());
+}
+
+SINET_DYN_API intptr_t _pool_get_event_fd(_pool_t* pool)
+{
+  if (!pool)
+    return -1;
+  return pool_cpptoc::Get(pool)->get_event_fd();
+}
+
 void SINET_DYN_CALLBACK _execute(struct __pool_t* self, _task_t* task)
 {
   refptr<sinet::task> task_in = task_cpptoc::Unwrap(task);
@@ -47,6 +69,142 @@ int SINET_DYN_CALLBACK _is_running_or_queued(struct __pool_t* self, _task_t* tas
   return pool_cpptoc::Get(self)->is_running_or_queued(task_in);
 }
 
+void SINET_DYN_CALLBACK _use_config(struct __pool_t* self, _config_t* config)
+{
+  pool_cpptoc::Get(self)->use_config(config_cpptoc::Unwrap(config));
+}
+
+_config_t* SINET_DYN_CALLBACK _get_config(struct __pool_t* self)
+{
+  return config_cpptoc::Wrap(pool_cpptoc::Get(self)->get_config());
+}
+
+void SINET_DYN_CALLBACK _get_cache_stats(struct __pool_t* self, _cache_stats_t* stats)
+{
+  cache_stats _stats;
+  pool_cpptoc::Get(self)->get_cache_stats(_stats);
+  if (!stats)
+    return;
+  stats->hits = _stats.hits;
+  stats->misses = _stats.misses;
+  stats->stores = _stats.stores;
+  stats->evictions = _stats.evictions;
+  stats->entries = _stats.entries;
+  stats->bytes = _stats.bytes;
+  stats->disk_hits = _stats.disk_hits;
+  stats->revalidated = _stats.revalidated;
+  stats->disk_entries = _stats.disk_entries;
+  stats->disk_bytes = _stats.disk_bytes;
+}
+
+void SINET_DYN_CALLBACK _get_stats(struct __pool_t* self, _pool_stats_t* stats, size_t size)
+{
+  pool_stats _stats;
+  pool_cpptoc::Get(self)->get_stats(_stats);
+  if (!stats)
+    return;
+  _pool_stats_t out;
+  memset(&out, 0, sizeof(out));
+  out.tasks_executed = _stats.tasks_executed;
+  out.tasks_completed = _stats.tasks_completed;
+  out.tasks_canceled = _stats.tasks_canceled;
+  out.tasks_queued = _stats.tasks_queued;
+  out.tasks_running = _stats.tasks_running;
+  out.transfers = _stats.transfers;
+  out.retries = _stats.retries;
+  out.transfers_active = _stats.transfers_active;
+  out.transfers_waiting = _stats.transfers_waiting;
+  for (int i = 0; i < REQ_ERR_COUNT && i < 15; i++)
+    out.requests[i] = _stats.requests[i];
+  out.bytes_received = _stats.bytes_received;
+  out.bytes_sent = _stats.bytes_sent;
+  out.connections_opened = _stats.connections_opened;
+  out.connections_reused = _stats.connections_reused;
+  out.dns_lookups = _stats.dns_lookups;
+  out.tls_handshakes = _stats.tls_handshakes;
+  out.queue_wait = _stats.queue_wait;
+  out.dns = _stats.dns;
+  out.connect = _stats.connect;
+  out.tls = _stats.tls;
+  out.ttfb = _stats.ttfb;
+  out.total = _stats.total;
+  memcpy(stats, &out, size < sizeof(out) ? size : sizeof(out));
+}
+
+// "Name: value" lines into |header|
+static void parse_header_lines(const char* lines, size_t length, si_stringmap_utf8& header)
+{
+  const char* end = lines + length;
+  while (lines < end)
+  {
+    const char* eol = lines;
+    while (eol < end && *eol != '\n')
+      eol++;
+    const char* line_end = eol;
+    if (line_end > lines && line_end[-1] == '\r')
+      line_end--;
+    const char* colon = lines;
+    while (colon < line_end && *colon != ':')
+      colon++;
+    if (colon > lines && colon < line_end)
+    {
+      const char* value = colon + 1;
+      while (value < line_end && (*value == ' ' || *value == '\t'))
+        value++;
+      header[std::string(lines, colon)] = std::string(value, line_end);
+    }
+    lines = eol + 1;
+  }
+}
+
+_task_t* SINET_DYN_CALLBACK _execute_batch_callbacks(struct __pool_t* self,
+                                                     const _request_desc_t* requests,
+                                                     size_t count, _config_t* config,
+                                                     const _task_callbacks_t* callbacks)
+{
+  if (!requests || count == 0)
+    return NULL;
+
+  refptr<task> task_out = task::create_instance();
+  for (size_t i = 0; i < count; i++)
+  {
+    const _request_desc_t& desc = requests[i];
+    refptr<request> req = request::create_instance();
+    url request_url(desc.url ? std::string(desc.url, desc.url_length) : std::string());
+    req->set_request_url(request_url);
+    if (desc.method)
+      req->set_request_method_utf8(std::string(desc.method, desc.method_length).c_str());
+    else
+      req->set_request_method_utf8(REQ_GET_UTF8);
+    if (desc.headers && desc.headers_length)
+    {
+      si_stringmap_utf8 header;
+      parse_header_lines(desc.headers, desc.headers_length, header);
+      req->set_request_header_utf8(header);
+    }
+    if (desc.postdata)
+      req->set_postdata(postdata_cpptoc::Get(desc.postdata));
+    task_out->append_request(req);
+  }
+  if (config)
+    task_out->use_config(config_cpptoc::Unwrap(config));
+  if (callbacks)
+  {
+    task_callbacks callbacks_in;
+    task_callbacks_from_c(callbacks, callbacks_in);
+    task_out->set_callbacks(callbacks_in);
+  }
+
+  pool_cpptoc::Get(self)->execute(task_out);
+  return task_cpptoc::Wrap(task_out);
+}
+
+_task_t* SINET_DYN_CALLBACK _execute_batch(struct __pool_t* self, const _request_desc_t* requests,
+                                           size_t count, _config_t* config)
+{
+  return _execute_batch_callbacks(self, requests, count, config, NULL);
+}
+
 pool_cpptoc::pool_cpptoc(pool* cls) :
   cpptoc<pool_cpptoc, pool, _pool_t>(cls)
 {
@@ -56,4 +214,10 @@ pool_cpptoc::pool_cpptoc(pool* cls) :
   struct_.struct_.is_running             = _is_running;
   struct_.struct_.is_queued              = _is_queued;
   struct_.struct_.is_running_or_queued   = _is_running_or_queued;
+  struct_.struct_.use_config             = _use_config;
+  struct_.struct_.get_config             = _get_config;
+  struct_.struct_.get_cache_stats        = _get_cache_stats;
+  struct_.struct_.get_stats              = _get_stats;
+  struct_.struct_.execute_batch          = _execute_batch;
+  struct_.struct_.execute_batch_callbacks = _execute_batch_callbacks;
 }
\ No newline at end of file
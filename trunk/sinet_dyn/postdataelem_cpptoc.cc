@@ -72,6 +72,57 @@ _string_t SINET_DYN_CALLBACK _get_text(struct __postdataelem_t* self)
   return _text;
 }
 
+void SINET_DYN_CALLBACK _set_name_utf8(struct __postdataelem_t* self, const char* fieldname)
+{
+  postdataelem_cpptoc::Get(self)->set_name_utf8(fieldname);
+}
+
+_utf8string_t SINET_DYN_CALLBACK _get_name_utf8(struct __postdataelem_t* self)
+{
+  std::string _name = postdataelem_cpptoc::Get(self)->get_name_utf8();
+  return _utf8string_alloc_length(_name.c_str(), _name.length());
+}
+
+void SINET_DYN_CALLBACK _setto_file_utf8(struct __postdataelem_t* self, const char* filename)
+{
+  postdataelem_cpptoc::Get(self)->setto_file_utf8(filename);
+}
+
+void SINET_DYN_CALLBACK _setto_text_utf8(struct __postdataelem_t* self, const char* text)
+{
+  postdataelem_cpptoc::Get(self)->setto_text_utf8(text);
+}
+
+_utf8string_t SINET_DYN_CALLBACK _get_file_utf8(struct __postdataelem_t* self)
+{
+  std::string _file = postdataelem_cpptoc::Get(self)->get_file_utf8();
+  return _utf8string_alloc_length(_file.c_str(), _file.length());
+}
+
+_utf8string_t SINET_DYN_CALLBACK _get_text_utf8(struct __postdataelem_t* self)
+{
+  std::string _text = postdataelem_cpptoc::Get(self)->get_text_utf8();
+  return _utf8string_alloc_length(_text.c_str(), _text.length());
+}
+
+int SINET_DYN_CALLBACK _copy_name_utf8(struct __postdataelem_t* self, char* str_out, int* length_inout)
+{
+  std::string _name = postdataelem_cpptoc::Get(self)->get_name_utf8();
+  return _utf8string_copy(_name.c_str(), _name.length(), str_out, length_inout);
+}
+
+int SINET_DYN_CALLBACK _copy_file_utf8(struct __postdataelem_t* self, char* str_out, int* length_inout)
+{
+  std::string _file = postdataelem_cpptoc::Get(self)->get_file_utf8();
+  return _utf8string_copy(_file.c_str(), _file.length(), str_out, length_inout);
+}
+
+int SINET_DYN_CALLBACK _copy_text_utf8(struct __postdataelem_t* self, char* str_out, int* length_inout)
+{
+  std::string _text = postdataelem_cpptoc::Get(self)->get_text_utf8();
+  return _utf8string_copy(_text.c_str(), _text.length(), str_out, length_inout);
+}
+
 postdataelem_cpptoc::postdataelem_cpptoc(postdataelem* cls) :
   cpptoc<postdataelem_cpptoc, postdataelem, _postdataelem_t>(cls)
 {
@@ -86,4 +137,13 @@ postdataelem_cpptoc::postdataelem_cpptoc(postdataelem* cls) :
   struct_.struct_.get_type = _get_type;
   struct_.struct_.get_text = _get_text;
   struct_.struct_.copy_buffer_to = _copy_buffer_to;
+  struct_.struct_.set_name_utf8 = _set_name_utf8;
+  struct_.struct_.get_name_utf8 = _get_name_utf8;
+  struct_.struct_.setto_file_utf8 = _setto_file_utf8;
+  struct_.struct_.setto_text_utf8 = _setto_text_utf8;
+  struct_.struct_.get_file_utf8 = _get_file_utf8;
+  struct_.struct_.get_text_utf8 = _get_text_utf8;
+  struct_.struct_.copy_name_utf8 = _copy_name_utf8;
+  struct_.struct_.copy_file_utf8 = _copy_file_utf8;
+  struct_.struct_.copy_text_utf8 = _copy_text_utf8;
 }
\ No newline at end of file
@@ -4,6 +4,16 @@
 
 using namespace sinet;
 
+// put |header| in a map for the caller to free, its nodes change hands
+// instead of being copied
+template <class Map>
+static Map* detach_map(Map& header)
+{
+  Map* header_out = new Map;
+  header_out->swap(header);
+  return header_out;
+}
+
 SINET_DYN_API _request_t* _request_create_instance()
 {
   refptr<request> impl = request::create_instance();
@@ -42,12 +52,8 @@ void SINET_DYN_CALLBACK _set_request_header(struct __request_t* self, _stringmap
 
 _stringmap_t SINET_DYN_CALLBACK _get_request_header(struct __request_t* self)
 {
-  _stringmap_t header = _stringmap_alloc();
-  std::map<std::wstring, std::wstring> _header = request_cpptoc::Get(self)->get_request_header();
-  for (std::map<std::wstring, std::wstring>::iterator it = _header.begin();
-       it != _header.end(); it++)
-    (*reinterpret_cast<std::map<std::wstring, std::wstring>*>(header))[it->first] = it->second;
-  return header;
+  si_stringmap header = request_cpptoc::Get(self)->get_request_header();
+  return reinterpret_cast<_stringmap_t>(detach_map(header));
 }
 
 void SINET_DYN_CALLBACK _set_postdata(struct __request_t* self, _postdata_t* postdata)
@@ -69,12 +75,8 @@ void SINET_DYN_CALLBACK _set_response_header(struct __request_t* self, _stringma
 
 _stringmap_t SINET_DYN_CALLBACK _get_response_header(struct __request_t* self)
 {
-  _stringmap_t header = _stringmap_alloc();
-  std::map<std::wstring, std::wstring> _header = request_cpptoc::Get(self)->get_response_header();
-  for (std::map<std::wstring, std::wstring>::iterator it = _header.begin();
-    it != _header.end(); it++)
-    (*reinterpret_cast<std::map<std::wstring, std::wstring>*>(header))[it->first] = it->second;
-  return header;
+  si_stringmap header = request_cpptoc::Get(self)->get_response_header();
+  return reinterpret_cast<_stringmap_t>(detach_map(header));
 }
 
 void SINET_DYN_CALLBACK _set_response_buffer(struct __request_t* self, _buffer_t* buffer)
@@ -151,6 +153,294 @@ void SINET_DYN_CALLBACK _set_appendbuffer(struct __request_t* self, const void*
   request_cpptoc::Get(self)->set_appendbuffer(data, size);
 }
 
+void SINET_DYN_CALLBACK _set_request_method_utf8(struct __request_t* self, const char* method)
+{
+  request_cpptoc::Get(self)->set_request_method_utf8(method);
+}
+
+_utf8string_t SINET_DYN_CALLBACK _get_request_method_utf8(struct __request_t* self)
+{
+  std::string _method = request_cpptoc::Get(self)->get_request_method_utf8();
+  return _utf8string_alloc_length(_method.c_str(), _method.length());
+}
+
+void SINET_DYN_CALLBACK _set_request_url_utf8(struct __request_t* self, const char* url)
+{
+  request_cpptoc::Get(self)->set_request_url_utf8(url);
+}
+
+_utf8string_t SINET_DYN_CALLBACK _get_request_url_utf8(struct __request_t* self)
+{
+  std::string _url = request_cpptoc::Get(self)->get_request_url_utf8();
+  return _utf8string_alloc_length(_url.c_str(), _url.length());
+}
+
+void SINET_DYN_CALLBACK _set_outfile_utf8(struct __request_t* self, const char* file)
+{
+  request_cpptoc::Get(self)->set_outfile_utf8(file);
+}
+
+_utf8string_t SINET_DYN_CALLBACK _get_outfile_utf8(struct __request_t* self)
+{
+  std::string _file = request_cpptoc::Get(self)->get_outfile_utf8();
+  return _utf8string_alloc_length(_file.c_str(), _file.length());
+}
+
+void SINET_DYN_CALLBACK _set_request_header_utf8(struct __request_t* self, _utf8stringmap_t* header)
+{
+  request_cpptoc::Get(self)->set_request_header_utf8(
+    *(reinterpret_cast<si_stringmap_utf8*>(header)));
+}
+
+_utf8stringmap_t SINET_DYN_CALLBACK _get_request_header_utf8(struct __request_t* self)
+{
+  si_stringmap_utf8 header = request_cpptoc::Get(self)->get_request_header_utf8();
+  return reinterpret_cast<_utf8stringmap_t>(detach_map(header));
+}
+
+void SINET_DYN_CALLBACK _set_response_header_utf8(struct __request_t* self, _utf8stringmap_t* header)
+{
+  request_cpptoc::Get(self)->set_response_header_utf8(
+    *(reinterpret_cast<si_stringmap_utf8*>(header)));
+}
+
+_utf8stringmap_t SINET_DYN_CALLBACK _get_response_header_utf8(struct __request_t* self)
+{
+  si_stringmap_utf8 header = request_cpptoc::Get(self)->get_response_header_utf8();
+  return reinterpret_cast<_utf8stringmap_t>(detach_map(header));
+}
+
+void SINET_DYN_CALLBACK _set_request_error(struct __request_t* self, int error)
+{
+  request_cpptoc::Get(self)->set_request_error(error);
+}
+
+int SINET_DYN_CALLBACK _get_request_error(struct __request_t* self)
+{
+  return request_cpptoc::Get(self)->get_request_error();
+}
+
+void SINET_DYN_CALLBACK _set_retry_policy(struct __request_t* self, int max_attempts,
+                                          int base_delay_ms, int max_delay_ms, int retry_errors)
+{
+  request_cpptoc::Get(self)->set_retry_policy(max_attempts, base_delay_ms,
+    max_delay_ms, retry_errors);
+}
+
+void SINET_DYN_CALLBACK _get_retry_policy(struct __request_t* self, int* max_attempts,
+                                          int* base_delay_ms, int* max_delay_ms, int* retry_errors)
+{
+  int _max_attempts, _base_delay_ms, _max_delay_ms, _retry_errors;
+  request_cpptoc::Get(self)->get_retry_policy(_max_attempts, _base_delay_ms,
+    _max_delay_ms, _retry_errors);
+  if (max_attempts)
+    *max_attempts = _max_attempts;
+  if (base_delay_ms)
+    *base_delay_ms = _base_delay_ms;
+  if (max_delay_ms)
+    *max_delay_ms = _max_delay_ms;
+  if (retry_errors)
+    *retry_errors = _retry_errors;
+}
+
+void SINET_DYN_CALLBACK _set_retry_status(struct __request_t* self, const int* statuses, size_t count)
+{
+  std::vector<int> _statuses;
+  if (statuses)
+    _statuses.assign(statuses, statuses + count);
+  request_cpptoc::Get(self)->set_retry_status(_statuses);
+}
+
+void SINET_DYN_CALLBACK _get_retry_status(struct __request_t* self, _intlist_t* statuses_out)
+{
+  std::vector<int> _statuses_out;
+  request_cpptoc::Get(self)->get_retry_status(_statuses_out);
+  if (_statuses_out.size() > 0)
+    *statuses_out = _intlist_alloc(&_statuses_out[0], _statuses_out.size());
+  else
+    *statuses_out = NULL;
+}
+
+void SINET_DYN_CALLBACK _set_attempts(struct __request_t* self, int attempts)
+{
+  request_cpptoc::Get(self)->set_attempts(attempts);
+}
+
+int SINET_DYN_CALLBACK _get_attempts(struct __request_t* self)
+{
+  return request_cpptoc::Get(self)->get_attempts();
+}
+
+void SINET_DYN_CALLBACK _reset_response(struct __request_t* self)
+{
+  request_cpptoc::Get(self)->reset_response();
+}
+
+void SINET_DYN_CALLBACK _set_timeouts(struct __request_t* self, int deadline_ms,
+                                      int connect_ms, int first_byte_ms)
+{
+  request_cpptoc::Get(self)->set_timeouts(deadline_ms, connect_ms, first_byte_ms);
+}
+
+void SINET_DYN_CALLBACK _get_timeouts(struct __request_t* self, int* deadline_ms,
+                                      int* connect_ms, int* first_byte_ms)
+{
+  int _deadline_ms, _connect_ms, _first_byte_ms;
+  request_cpptoc::Get(self)->get_timeouts(_deadline_ms, _connect_ms, _first_byte_ms);
+  if (deadline_ms)
+    *deadline_ms = _deadline_ms;
+  if (connect_ms)
+    *connect_ms = _connect_ms;
+  if (first_byte_ms)
+    *first_byte_ms = _first_byte_ms;
+}
+
+void SINET_DYN_CALLBACK _set_low_speed(struct __request_t* self, int limit_bytes, int time_sec)
+{
+  request_cpptoc::Get(self)->set_low_speed(limit_bytes, time_sec);
+}
+
+void SINET_DYN_CALLBACK _get_low_speed(struct __request_t* self, int* limit_bytes, int* time_sec)
+{
+  int _limit_bytes, _time_sec;
+  request_cpptoc::Get(self)->get_low_speed(_limit_bytes, _time_sec);
+  if (limit_bytes)
+    *limit_bytes = _limit_bytes;
+  if (time_sec)
+    *time_sec = _time_sec;
+}
+
+void SINET_DYN_CALLBACK _set_hedge_policy(struct __request_t* self, int percentile, int delay_ms)
+{
+  request_cpptoc::Get(self)->set_hedge_policy(percentile, delay_ms);
+}
+
+void SINET_DYN_CALLBACK _get_hedge_policy(struct __request_t* self, int* percentile, int* delay_ms)
+{
+  int _percentile, _delay_ms;
+  request_cpptoc::Get(self)->get_hedge_policy(_percentile, _delay_ms);
+  if (percentile)
+    *percentile = _percentile;
+  if (delay_ms)
+    *delay_ms = _delay_ms;
+}
+
+void SINET_DYN_CALLBACK _set_mirrors(struct __request_t* self, const char** urls, size_t count)
+{
+  std::vector<std::string> _urls;
+  for (size_t i = 0; urls && i < count; i++)
+    _urls.push_back(urls[i] ? urls[i] : "");
+  request_cpptoc::Get(self)->set_mirrors(_urls);
+}
+
+size_t SINET_DYN_CALLBACK _get_mirror_count(struct __request_t* self)
+{
+  std::vector<std::string> urls;
+  request_cpptoc::Get(self)->get_mirrors(urls);
+  return urls.size();
+}
+
+_utf8string_t SINET_DYN_CALLBACK _get_mirror(struct __request_t* self, size_t index)
+{
+  std::vector<std::string> urls;
+  request_cpptoc::Get(self)->get_mirrors(urls);
+  if (index >= urls.size())
+    return NULL;
+  return _utf8string_alloc_length(urls[index].data(), urls[index].length());
+}
+
+_buffer_lease_t SINET_DYN_CALLBACK _lease_response_buffer(struct __request_t* self)
+{
+  refptr<shared_buffer> body = request_cpptoc::Get(self)->lease_response_buffer();
+  if (!body)
+    return NULL;
+  // the reference goes with the lease
+  body->AddRef();
+  return body.get();
+}
+
+int SINET_DYN_CALLBACK _copy_request_method_utf8(struct __request_t* self, char* str_out, int* length_inout)
+{
+  std::string _method = request_cpptoc::Get(self)->get_request_method_utf8();
+  return _utf8string_copy(_method.c_str(), _method.length(), str_out, length_inout);
+}
+
+int SINET_DYN_CALLBACK _copy_request_url_utf8(struct __request_t* self, char* str_out, int* length_inout)
+{
+  std::string _url = request_cpptoc::Get(self)->get_request_url_utf8();
+  return _utf8string_copy(_url.c_str(), _url.length(), str_out, length_inout);
+}
+
+int SINET_DYN_CALLBACK _copy_outfile_utf8(struct __request_t* self, char* str_out, int* length_inout)
+{
+  std::string _file = request_cpptoc::Get(self)->get_outfile_utf8();
+  return _utf8string_copy(_file.c_str(), _file.length(), str_out, length_inout);
+}
+
+int SINET_DYN_CALLBACK _copy_mirror(struct __request_t* self, size_t index, char* str_out, int* length_inout)
+{
+  std::vector<std::string> urls;
+  request_cpptoc::Get(self)->get_mirrors(urls);
+  if (index >= urls.size())
+    return _utf8string_copy("", 0, str_out, length_inout);
+  return _utf8string_copy(urls[index].c_str(), urls[index].length(), str_out, length_inout);
+}
+
+void SINET_DYN_CALLBACK _set_timing(struct __request_t* self, const _request_timing_t* timing, size_t size)
+{
+  if (!timing)
+    return;
+  _request_timing_t in;
+  memset(&in, 0, sizeof(in));
+  memcpy(&in, timing, size < sizeof(in) ? size : sizeof(in));
+  request_timing _timing;
+  _timing.queued_ms = in.queued_ms;
+  _timing.started_ms = in.started_ms;
+  _timing.namelookup = in.namelookup;
+  _timing.connect = in.connect;
+  _timing.appconnect = in.appconnect;
+  _timing.pretransfer = in.pretransfer;
+  _timing.starttransfer = in.starttransfer;
+  _timing.total = in.total;
+  _timing.redirects = in.redirects;
+  _timing.reused = in.reused;
+  memcpy(_timing.primary_ip, in.primary_ip, sizeof(_timing.primary_ip));
+  _timing.primary_ip[sizeof(_timing.primary_ip) - 1] = 0;
+  request_cpptoc::Get(self)->set_timing(_timing);
+}
+
+void SINET_DYN_CALLBACK _get_timing(struct __request_t* self, _request_timing_t* timing, size_t size)
+{
+  request_timing _timing;
+  request_cpptoc::Get(self)->get_timing(_timing);
+  if (!timing)
+    return;
+  _request_timing_t out;
+  out.queued_ms = _timing.queued_ms;
+  out.started_ms = _timing.started_ms;
+  out.namelookup = _timing.namelookup;
+  out.connect = _timing.connect;
+  out.appconnect = _timing.appconnect;
+  out.pretransfer = _timing.pretransfer;
+  out.starttransfer = _timing.starttransfer;
+  out.total = _timing.total;
+  out.redirects = _timing.redirects;
+  out.reused = _timing.reused;
+  memcpy(out.primary_ip, _timing.primary_ip, sizeof(out.primary_ip));
+  memcpy(timing, &out, size < sizeof(out) ? size : sizeof(out));
+}
+
+void SINET_DYN_CALLBACK _set_effective_url_utf8(struct __request_t* self, const char* url)
+{
+  request_cpptoc::Get(self)->set_effective_url_utf8(url ? url : "");
+}
+
+int SINET_DYN_CALLBACK _copy_effective_url_utf8(struct __request_t* self, char* str_out, int* length_inout)
+{
+  std::string _url = request_cpptoc::Get(self)->get_effective_url_utf8();
+  return _utf8string_copy(_url.c_str(), _url.length(), str_out, length_inout);
+}
+
 request_cpptoc::request_cpptoc(request* cls):
 cpptoc<request_cpptoc, request, _request_t>(cls)
 {
@@ -178,4 +468,41 @@ cpptoc<request_cpptoc, request, _request_t>(cls)
   struct_.struct_.set_response_size     = _set_response_size;
   struct_.struct_.set_retrieved_size    = _set_retrieved_size;
   struct_.struct_.close_outfile         = _close_outfile;
+  struct_.struct_.set_request_method_utf8 = _set_request_method_utf8;
+  struct_.struct_.get_request_method_utf8 = _get_request_method_utf8;
+  struct_.struct_.set_request_url_utf8    = _set_request_url_utf8;
+  struct_.struct_.get_request_url_utf8    = _get_request_url_utf8;
+  struct_.struct_.set_outfile_utf8        = _set_outfile_utf8;
+  struct_.struct_.get_outfile_utf8        = _get_outfile_utf8;
+  struct_.struct_.set_request_header_utf8 = _set_request_header_utf8;
+  struct_.struct_.get_request_header_utf8 = _get_request_header_utf8;
+  struct_.struct_.set_response_header_utf8 = _set_response_header_utf8;
+  struct_.struct_.get_response_header_utf8 = _get_response_header_utf8;
+  struct_.struct_.set_request_error       = _set_request_error;
+  struct_.struct_.get_request_error       = _get_request_error;
+  struct_.struct_.set_retry_policy        = _set_retry_policy;
+  struct_.struct_.get_retry_policy        = _get_retry_policy;
+  struct_.struct_.set_retry_status        = _set_retry_status;
+  struct_.struct_.get_retry_status        = _get_retry_status;
+  struct_.struct_.set_attempts            = _set_attempts;
+  struct_.struct_.get_attempts            = _get_attempts;
+  struct_.struct_.reset_response          = _reset_response;
+  struct_.struct_.set_timeouts            = _set_timeouts;
+  struct_.struct_.get_timeouts            = _get_timeouts;
+  struct_.struct_.set_low_speed           = _set_low_speed;
+  struct_.struct_.get_low_speed           = _get_low_speed;
+  struct_.struct_.set_hedge_policy        = _set_hedge_policy;
+  struct_.struct_.get_hedge_policy        = _get_hedge_policy;
+  struct_.struct_.set_mirrors             = _set_mirrors;
+  struct_.struct_.get_mirror_count        = _get_mirror_count;
+  struct_.struct_.get_mirror              = _get_mirror;
+  struct_.struct_.lease_response_buffer   = _lease_response_buffer;
+  struct_.struct_.copy_request_method_utf8 = _copy_request_method_utf8;
+  struct_.struct_.copy_request_url_utf8   = _copy_request_url_utf8;
+  struct_.struct_.copy_outfile_utf8       = _copy_outfile_utf8;
+  struct_.struct_.copy_mirror             = _copy_mirror;
+  struct_.struct_.set_timing              = _set_timing;
+  struct_.struct_.get_timing              = _get_timing;
+  struct_.struct_.set_effective_url_utf8  = _set_effective_url_utf8;
+  struct_.struct_.copy_effective_url_utf8 = _copy_effective_url_utf8;
 }
\ No newline at end of file
@@ -1,12 +1,32 @@
 #ifndef SINET_CAPI_H
 #define SINET_CAPI_H
 
+// C ABI of sinet_dyn.
+//
+// Structs only grow at the end and carry their size in base.size, a
+// caller built against a newer header checks a member with
+// _MEMBER_EXISTS before it calls it. SINET_CAPI_VERSION goes up with
+// each change that appends members or entry points, the version of the
+// library loaded is _sinet_capi_version().
+//
+//   1  versioned header, _pool_t::execute_batch_callbacks
+//   2  _pool_t::get_stats
+//   3  _request_t timing and effective url
+//   4  _sinet_trace_dump
+//
+#define SINET_CAPI_VERSION 4
+
 #include "string_capi.h"
 #include "buffer_capi.h"
 #include "stringmap_capi.h"
 #include "intlist_capi.h"
 #include "../sinet/api_types.h"
 #include "../sinet/task_observer.h"
+#include "../sinet/histogram.h"
+#include <stddef.h>
+#if !defined(WIN32)
+#include <stdint.h>
+#endif
 
 using namespace sinet;
 
@@ -23,8 +43,11 @@ extern "C" {
     int (SINET_DYN_CALLBACK *get_refct)(struct __base_t* self);
   }_base_t;
 
+// the end of member |f| of struct type |t|, a constant
+#define _MEMBER_END(t, f)      (offsetof(t, f) + sizeof(((t*)0)->f))
+
 #define _MEMBER_EXISTS(s, f)   \
-  ((int)&((s)->f) - (int)(s) + sizeof((s)->f) <= (s)->base.size)
+  ((size_t)((const char*)&((s)->f) - (const char*)(s)) + sizeof((s)->f) <= (s)->base.size)
 
 #define _MEMBER_MISSING(s, f)  (!_MEMBER_EXISTS(s, f) || !((s)->f))
 
@@ -36,6 +59,18 @@ extern "C" {
     void (SINET_DYN_CALLBACK *set_strvar)(struct __config_t* self, int id, _string_t strvarin);
     int (SINET_DYN_CALLBACK *remove_strvar)(struct __config_t* self, int id);
 
+    // UTF-8 variants
+    int (SINET_DYN_CALLBACK *get_strvar_utf8)(struct __config_t* self, int id, _utf8string_t* strvarout);
+    void (SINET_DYN_CALLBACK *set_strvar_utf8)(struct __config_t* self, int id, const char* strvarin);
+
+    int (SINET_DYN_CALLBACK *get_intvar)(struct __config_t* self, int id, int* intvarout);
+    void (SINET_DYN_CALLBACK *set_intvar)(struct __config_t* self, int id, int intvarin);
+    int (SINET_DYN_CALLBACK *remove_intvar)(struct __config_t* self, int id);
+
+    // get_strvar_utf8 into a buffer of the caller, see _utf8string_copy
+    // @returns 1 when copied, 0 when |id| is not set, -1 with the length
+    // needed when the buffer is too small
+    int (SINET_DYN_CALLBACK *copy_strvar_utf8)(struct __config_t* self, int id, char* strvar_out, int* length_inout);
   }_config_t;
 
   SINET_DYN_API _config_t* _config_create_instance();
@@ -60,6 +95,18 @@ extern "C" {
     size_t (SINET_DYN_CALLBACK *copy_buffer_to)(struct __postdataelem_t* self, void* bytes_inout, size_t size_in);
     _string_t (SINET_DYN_CALLBACK *get_text)(struct __postdataelem_t* self);
 
+    // UTF-8 variants
+    void (SINET_DYN_CALLBACK *set_name_utf8)(struct __postdataelem_t* self, const char* fieldname);
+    _utf8string_t (SINET_DYN_CALLBACK *get_name_utf8)(struct __postdataelem_t* self);
+    void (SINET_DYN_CALLBACK *setto_file_utf8)(struct __postdataelem_t* self, const char* filename);
+    void (SINET_DYN_CALLBACK *setto_text_utf8)(struct __postdataelem_t* self, const char* text);
+    _utf8string_t (SINET_DYN_CALLBACK *get_file_utf8)(struct __postdataelem_t* self);
+    _utf8string_t (SINET_DYN_CALLBACK *get_text_utf8)(struct __postdataelem_t* self);
+
+    // the UTF-8 getters into a buffer of the caller, see _utf8string_copy
+    int (SINET_DYN_CALLBACK *copy_name_utf8)(struct __postdataelem_t* self, char* str_out, int* length_inout);
+    int (SINET_DYN_CALLBACK *copy_file_utf8)(struct __postdataelem_t* self, char* str_out, int* length_inout);
+    int (SINET_DYN_CALLBACK *copy_text_utf8)(struct __postdataelem_t* self, char* str_out, int* length_inout);
   }_postdataelem_t;
 
   SINET_DYN_API _postdataelem_t* _postdataelem_create_instance();
@@ -78,6 +125,22 @@ extern "C" {
 
   SINET_DYN_API _postdata_t* _postdata_create_instance();
 
+  // see request_timing in request.h
+  typedef struct __request_timing_t
+  {
+    long long queued_ms;
+    long long started_ms;
+    long long namelookup;
+    long long connect;
+    long long appconnect;
+    long long pretransfer;
+    long long starttransfer;
+    long long total;
+    int       redirects;
+    int       reused;
+    char      primary_ip[64];
+  }_request_timing_t;
+
   typedef struct __request_t
   {
     _base_t base;
@@ -107,9 +170,102 @@ extern "C" {
     void (SINET_DYN_CALLBACK *set_appendbuffer)(struct __request_t* self, const void* data, size_t size);
     void (SINET_DYN_CALLBACK *close_outfile)(struct __request_t* self);
 
+    // UTF-8 variants
+    void (SINET_DYN_CALLBACK *set_request_method_utf8)(struct __request_t* self, const char* method);
+    _utf8string_t (SINET_DYN_CALLBACK *get_request_method_utf8)(struct __request_t* self);
+    void (SINET_DYN_CALLBACK *set_request_url_utf8)(struct __request_t* self, const char* url);
+    _utf8string_t (SINET_DYN_CALLBACK *get_request_url_utf8)(struct __request_t* self);
+    void (SINET_DYN_CALLBACK *set_outfile_utf8)(struct __request_t* self, const char* file);
+    _utf8string_t (SINET_DYN_CALLBACK *get_outfile_utf8)(struct __request_t* self);
+    void (SINET_DYN_CALLBACK *set_request_header_utf8)(struct __request_t* self, _utf8stringmap_t* header);
+    _utf8stringmap_t (SINET_DYN_CALLBACK *get_request_header_utf8)(struct __request_t* self);
+    void (SINET_DYN_CALLBACK *set_response_header_utf8)(struct __request_t* self, _utf8stringmap_t* header);
+    _utf8stringmap_t (SINET_DYN_CALLBACK *get_response_header_utf8)(struct __request_t* self);
+
+    // retry policy, see request.h
+    void (SINET_DYN_CALLBACK *set_request_error)(struct __request_t* self, int error);
+    int (SINET_DYN_CALLBACK *get_request_error)(struct __request_t* self);
+    void (SINET_DYN_CALLBACK *set_retry_policy)(struct __request_t* self, int max_attempts, int base_delay_ms, int max_delay_ms, int retry_errors);
+    void (SINET_DYN_CALLBACK *get_retry_policy)(struct __request_t* self, int* max_attempts, int* base_delay_ms, int* max_delay_ms, int* retry_errors);
+    void (SINET_DYN_CALLBACK *set_retry_status)(struct __request_t* self, const int* statuses, size_t count);
+    void (SINET_DYN_CALLBACK *get_retry_status)(struct __request_t* self, _intlist_t* statuses_out);
+    void (SINET_DYN_CALLBACK *set_attempts)(struct __request_t* self, int attempts);
+    int (SINET_DYN_CALLBACK *get_attempts)(struct __request_t* self);
+    void (SINET_DYN_CALLBACK *reset_response)(struct __request_t* self);
+
+    // timeouts, see request.h
+    void (SINET_DYN_CALLBACK *set_timeouts)(struct __request_t* self, int deadline_ms, int connect_ms, int first_byte_ms);
+    void (SINET_DYN_CALLBACK *get_timeouts)(struct __request_t* self, int* deadline_ms, int* connect_ms, int* first_byte_ms);
+    void (SINET_DYN_CALLBACK *set_low_speed)(struct __request_t* self, int limit_bytes, int time_sec);
+    void (SINET_DYN_CALLBACK *get_low_speed)(struct __request_t* self, int* limit_bytes, int* time_sec);
+
+    // hedging, see request.h
+    void (SINET_DYN_CALLBACK *set_hedge_policy)(struct __request_t* self, int percentile, int delay_ms);
+    void (SINET_DYN_CALLBACK *get_hedge_policy)(struct __request_t* self, int* percentile, int* delay_ms);
+    void (SINET_DYN_CALLBACK *set_mirrors)(struct __request_t* self, const char** urls, size_t count);
+    size_t (SINET_DYN_CALLBACK *get_mirror_count)(struct __request_t* self);
+    _utf8string_t (SINET_DYN_CALLBACK *get_mirror)(struct __request_t* self, size_t index);
+
+    // borrow the response body, release with _buffer_lease_release
+    _buffer_lease_t (SINET_DYN_CALLBACK *lease_response_buffer)(struct __request_t* self);
+
+    // the UTF-8 getters into a buffer of the caller, see _utf8string_copy
+    int (SINET_DYN_CALLBACK *copy_request_method_utf8)(struct __request_t* self, char* str_out, int* length_inout);
+    int (SINET_DYN_CALLBACK *copy_request_url_utf8)(struct __request_t* self, char* str_out, int* length_inout);
+    int (SINET_DYN_CALLBACK *copy_outfile_utf8)(struct __request_t* self, char* str_out, int* length_inout);
+    int (SINET_DYN_CALLBACK *copy_mirror)(struct __request_t* self, size_t index, char* str_out, int* length_inout);
+
+    // timing of the last attempt, see request.h. The first |size|
+    // bytes are read or filled, pass sizeof(_request_timing_t).
+    void (SINET_DYN_CALLBACK *set_timing)(struct __request_t* self, const _request_timing_t* timing, size_t size);
+    void (SINET_DYN_CALLBACK *get_timing)(struct __request_t* self, _request_timing_t* timing, size_t size);
+    void (SINET_DYN_CALLBACK *set_effective_url_utf8)(struct __request_t* self, const char* url);
+    int (SINET_DYN_CALLBACK *copy_effective_url_utf8)(struct __request_t* self, char* str_out, int* length_inout);
+
   }_request_t;
   SINET_DYN_API _request_t* _request_create_instance();
 
+  // one request of a batch, see _pool_t::execute_batch. Strings are
+  // UTF-8 with their lengths and need no terminator.
+  typedef struct __request_desc_t
+  {
+    const char*   url;
+    size_t        url_length;
+    // NULL for GET
+    const char*   method;
+    size_t        method_length;
+    // "Name: value" lines ended by "\r\n" or "\n", NULL for none
+    const char*   headers;
+    size_t        headers_length;
+    // form to post, borrowed, so several requests may share it without
+    // adding references. NULL for none.
+    _postdata_t*  postdata;
+  }_request_desc_t;
+
+  // outcome of one request, see _task_t::get_results
+  typedef struct __request_result_t
+  {
+    int             request_id;
+    // REQ_ERR_*, see request.h
+    int             request_error;
+    // HTTP status, 0 for 200
+    int             response_errcode;
+    int             attempts;
+    size_t          retrieved_size;
+    // the body, release with _buffer_lease_release
+    _buffer_lease_t body;
+  }_request_result_t;
+
+  // plain C callbacks of a task, each gets |user| back, see
+  // task_callbacks in task_observer.h for the threads they run on
+  typedef struct __task_callbacks_t
+  {
+    void (SINET_DYN_CALLBACK *on_status)(void* user, int status);
+    void (SINET_DYN_CALLBACK *on_progress)(void* user, int progress);
+    void (SINET_DYN_CALLBACK *on_data)(void* user, int request_id, size_t offset, const void* data, size_t size);
+    void* user;
+  }_task_callbacks_t;
+
   typedef struct __task_t
   {
     _base_t base;
@@ -128,9 +284,61 @@ extern "C" {
     void (SINET_DYN_CALLBACK *use_config)(struct __task_t* self, _config_t* config);
     _config_t* (SINET_DYN_CALLBACK *get_config)(struct __task_t* self);
 
+    // the outcome of the first |count| requests by id in one call. Only
+    // a completed or canceled task has results, its sizes and errors no
+    // longer change.
+    // @returns the number of requests in the task, 0 if it has not
+    // finished
+    size_t (SINET_DYN_CALLBACK *get_results)(struct __task_t* self, _request_result_t* results, size_t count);
+
+    // |callbacks| is copied, NULL clears them. Set before execute.
+    void (SINET_DYN_CALLBACK *set_callbacks)(struct __task_t* self, const _task_callbacks_t* callbacks);
+    void (SINET_DYN_CALLBACK *get_callbacks)(struct __task_t* self, _task_callbacks_t* callbacks);
   }_task_t;
   SINET_DYN_API _task_t* _task_create_instance();
 
+  typedef struct __cache_stats_t
+  {
+    long long hits;
+    long long misses;
+    long long stores;
+    long long evictions;
+    long long entries;
+    long long bytes;
+    long long disk_hits;
+    long long revalidated;
+    long long disk_entries;
+    long long disk_bytes;
+  }_cache_stats_t;
+
+  // see pool_stats in pool.h
+  typedef struct __pool_stats_t
+  {
+    long long tasks_executed;
+    long long tasks_completed;
+    long long tasks_canceled;
+    int       tasks_queued;
+    int       tasks_running;
+    long long transfers;
+    long long retries;
+    int       transfers_active;
+    int       transfers_waiting;
+    // by REQ_ERR_*, the length is fixed here, REQ_ERR_COUNT may grow
+    long long requests[15];
+    long long bytes_received;
+    long long bytes_sent;
+    long long connections_opened;
+    long long connections_reused;
+    long long dns_lookups;
+    long long tls_handshakes;
+    latency_histogram queue_wait;
+    latency_histogram dns;
+    latency_histogram connect;
+    latency_histogram tls;
+    latency_histogram ttfb;
+    latency_histogram total;
+  }_pool_stats_t;
+
   typedef struct __pool_t
   {
     _base_t base;
@@ -142,12 +350,53 @@ extern "C" {
     int (SINET_DYN_CALLBACK *is_running)(struct __pool_t* self, _task_t* task);
     int (SINET_DYN_CALLBACK *is_queued)(struct __pool_t* self, _task_t* task);
     int (SINET_DYN_CALLBACK *is_running_or_queued)(struct __pool_t* self, _task_t* task);
+
+    void (SINET_DYN_CALLBACK *use_config)(struct __pool_t* self, _config_t* config);
+    _config_t* (SINET_DYN_CALLBACK *get_config)(struct __pool_t* self);
+
+    // response cache counters, see pool.h
+    void (SINET_DYN_CALLBACK *get_cache_stats)(struct __pool_t* self, _cache_stats_t* stats);
+
+    // build a task of |count| requests, ids in the order given, and
+    // execute it, all in one call. |config| may be NULL.
+    // @returns the task, NULL if |count| is 0
+    _task_t* (SINET_DYN_CALLBACK *execute_batch)(struct __pool_t* self, const _request_desc_t* requests, size_t count, _config_t* config);
+
+    // execute_batch with |callbacks| set on the task before it is
+    // queued, so none of its calls are missed. |callbacks| may be NULL.
+    _task_t* (SINET_DYN_CALLBACK *execute_batch_callbacks)(struct __pool_t* self, const _request_desc_t* requests, size_t count, _config_t* config, const _task_callbacks_t* callbacks);
+
+    // fills the first |size| bytes of |stats|, pass sizeof(_pool_stats_t)
+    void (SINET_DYN_CALLBACK *get_stats)(struct __pool_t* self, _pool_stats_t* stats, size_t size);
   }_pool_t;
 
   SINET_DYN_API _pool_t* _pool_create_instance();
 
+  // SINET_CAPI_VERSION of the library
+  SINET_DYN_API int _sinet_capi_version();
+
+  // Chrome trace JSON of the library's trace rings, see trace.h. Free
+  // it with _utf8string_free.
+  SINET_DYN_API _utf8string_t _sinet_trace_dump();
+
+  // fd or HANDLE signaled when a task of |pool| completes or is
+  // canceled, for select/poll/WaitForMultipleObjects. See
+  // pool::get_event_fd in pool.h, -1 on failure.
+  SINET_DYN_API intptr_t _pool_get_event_fd(_pool_t* pool);
+
+  // percent-encode/decode |str_in| into |str_out|, which has room for
+  // *length_inout characters plus a terminator. On success returns 1 and
+  // the output length in *length_inout, otherwise returns 0 and the
+  // length needed in *length_inout.
   SINET_DYN_API int sinet_urlencode(const wchar_t* str_in, wchar_t* str_out, int* length_inout);
   SINET_DYN_API int sinet_urldecode(const wchar_t* str_in, wchar_t* str_out, int* length_inout);
+  SINET_DYN_API int sinet_urlencode_utf8(const char* str_in, char* str_out, int* length_inout);
+  SINET_DYN_API int sinet_urldecode_utf8(const char* str_in, char* str_out, int* length_inout);
+
+  // "key1=value1&key2=value2" with every key and value encoded,
+  // free the result with _string_free/_utf8string_free
+  SINET_DYN_API _string_t sinet_build_query(_stringmap_t params);
+  SINET_DYN_API _utf8string_t sinet_build_query_utf8(_utf8stringmap_t params);
 
 #ifdef __cplusplus
 }
@@ -1,12 +1,65 @@
 #include "pch.h"
 #include "string_capi.h"
 
+#include "../sinet/object_pool.h"
+
 #include <limits.h>
 #include <malloc.h>
 #include <string.h>
 
+using namespace sinet;
+
 typedef unsigned long dword_t;
 
+// strings crossing the ABI are mostly short lived and short, their
+// blocks come from free lists by size class, size prefix and
+// terminator included. Longer ones go to malloc.
+static object_pool string_pool_32(32, 256);
+static object_pool string_pool_64(64, 256);
+static object_pool string_pool_128(128, 128);
+static object_pool string_pool_256(256, 64);
+
+// the pool serving blocks of |bytes|, rounded up to its size class
+static object_pool* string_pool(size_t& bytes)
+{
+  if (bytes <= 32)
+  {
+    bytes = 32;
+    return &string_pool_32;
+  }
+  if (bytes <= 64)
+  {
+    bytes = 64;
+    return &string_pool_64;
+  }
+  if (bytes <= 128)
+  {
+    bytes = 128;
+    return &string_pool_128;
+  }
+  if (bytes <= 256)
+  {
+    bytes = 256;
+    return &string_pool_256;
+  }
+  return NULL;
+}
+
+static void* block_alloc(size_t bytes)
+{
+  object_pool* pool = string_pool(bytes);
+  return pool ? pool->allocate(bytes) : malloc(bytes);
+}
+
+static void block_free(void* block, size_t bytes)
+{
+  object_pool* pool = string_pool(bytes);
+  if (pool)
+    pool->deallocate(block, bytes);
+  else
+    free(block);
+}
+
 SINET_DYN_API size_t _string_length(_string_t str)
 {
   dword_t* ptr;
@@ -45,7 +98,7 @@ SINET_DYN_API _string_t _string_alloc_length(const wchar_t* str,
 
   // Allocate the new buffer including space for the proceeding dword_t size
   // value and the terminating nul.
-  ptr = (dword_t*)malloc(sizeof(dword_t) + size + sizeof(wchar_t));
+  ptr = (dword_t*)block_alloc(sizeof(dword_t) + size + sizeof(wchar_t));
   if(!ptr)
     return NULL;
 
@@ -98,50 +151,13 @@ SINET_DYN_API int _string_realloc_length(_string_t* oldstr,
   if(len >= (UINT_MAX - sizeof(wchar_t) - sizeof(dword_t)) / sizeof(wchar_t))
     return 0;
 
-  if(*oldstr)
-  {
-    dword_t newsize, *oldptr, *newptr;
-
-    // Get the new size of the string in bytes.
-    newsize = sizeof(wchar_t) * len;
-
-    // Adjust the pointer to account for the dword_t immediately proceeding the
-    // string value.
-    oldptr = (dword_t*)*oldstr;
-    oldptr--;
-
-    // Re-allocate the buffer including space for the proceeding dword_t size
-    // value and the terminating nul.
-    newptr = (dword_t*)realloc(
-      oldptr, sizeof(dword_t) + newsize + sizeof(wchar_t));
-    if(!newptr)
-      return 0;
-
-    // Set the size as the first value in the newly allocated memory and
-    // increment to the string location.
-    *newptr = newsize;
-    newptr++;
-
-    // Set the string pointer to the beginning on the string in the newly
-    // allocated memory.
-    *oldstr = (_string_t)newptr;
-
-    if(newstr)
-    {
-      // Copy the new string value.  Use of memmove() ensures that any
-      // overlapping region in the old string will be copied before being
-      // overwritten.
-      memmove(*oldstr, newstr, newsize);
-
-      // Nul-terminate the string.
-      *oldstr[len] = '\0';
-    }
-  }
-  else
-  {
-    // Allocate the string.
-    *oldstr = _string_alloc_length(newstr, len);
-  }
+  // Blocks come from size classes, so allocate the new string before
+  // freeing the old one, which |newstr| may point into.
+  _string_t str = _string_alloc_length(newstr, len);
+  if(!str)
+    return 0;
+  _string_free(*oldstr);
+  *oldstr = str;
 
   return 1;
 }
@@ -157,5 +173,91 @@ SINET_DYN_API void _string_free(_string_t str)
   ptr = (dword_t*)str;
   ptr--;
 
-  free(ptr);
+  block_free(ptr, sizeof(dword_t) + *ptr + sizeof(wchar_t));
+}
+
+SINET_DYN_API size_t _utf8string_length(_utf8string_t str)
+{
+  dword_t* ptr;
+
+  if(!str)
+    return 0;
+
+  // The string length, in bytes, is placed in a dword_t immediately proceeding
+  // the string value.
+  ptr = (dword_t*)str;
+  ptr--;
+
+  return (size_t)*ptr;
+}
+
+SINET_DYN_API _utf8string_t _utf8string_alloc(const char* str)
+{
+  if(!str)
+    return NULL;
+
+  return _utf8string_alloc_length(str, strlen(str));
+}
+
+SINET_DYN_API _utf8string_t _utf8string_alloc_length(const char* str,
+                                                      size_t len)
+{
+  dword_t *ptr;
+  char* newstr;
+
+  // Check that the size can fit in a dword_t.
+  if(len >= UINT_MAX - sizeof(char) - sizeof(dword_t))
+    return NULL;
+
+  // Allocate the new buffer including space for the proceeding dword_t size
+  // value and the terminating nul.
+  ptr = (dword_t*)block_alloc(sizeof(dword_t) + len + sizeof(char));
+  if(!ptr)
+    return NULL;
+
+  *ptr = len;
+  ptr++;
+
+  newstr = (char*)ptr;
+  if(str != NULL)
+    memcpy(newstr, str, len);
+  else
+    memset(newstr, 0, len);
+
+  // Nul-terminate the string.
+  newstr[len] = '\0';
+
+  return (_utf8string_t)newstr;
+}
+
+SINET_DYN_API void _utf8string_free(_utf8string_t str)
+{
+  dword_t* ptr;
+
+  if(!str)
+    return;
+
+  // The size is placed in a dword_t immediately proceeding the string value.
+  ptr = (dword_t*)str;
+  ptr--;
+
+  block_free(ptr, sizeof(dword_t) + *ptr + sizeof(char));
+}
+
+SINET_DYN_API int _utf8string_copy(const char* str, size_t len,
+                                   char* str_out, int* length_inout)
+{
+  if(!length_inout)
+    return 0;
+
+  if(!str_out || *length_inout < 0 || len > (size_t)*length_inout)
+  {
+    *length_inout = (int)len;
+    return 0;
+  }
+
+  memcpy(str_out, str, len);
+  str_out[len] = '\0';
+  *length_inout = (int)len;
+  return 1;
 }
@@ -16,6 +16,21 @@ extern "C" {
   SINET_DYN_API int _string_realloc_length(_string_t* oldstr, const wchar_t* newstr, size_t len);
   SINET_DYN_API void _string_free(_string_t str);
 
+  // UTF-8 strings, same length-prefixed layout as _string_t
+  typedef char* _utf8string_t;
+
+  SINET_DYN_API size_t _utf8string_length(_utf8string_t str);
+  SINET_DYN_API _utf8string_t _utf8string_alloc(const char* str);
+  SINET_DYN_API _utf8string_t _utf8string_alloc_length(const char* str, size_t len);
+  SINET_DYN_API void _utf8string_free(_utf8string_t str);
+  // copy |len| bytes of |str| into |str_out|, which has room for
+  // *length_inout bytes plus a terminator. On success returns 1 and the
+  // length in *length_inout, otherwise returns 0 and the length needed
+  // in *length_inout. The copy_*_utf8 members of the structs work the
+  // same way and allocate nothing.
+  SINET_DYN_API int _utf8string_copy(const char* str, size_t len,
+                                     char* str_out, int* length_inout);
+
 #ifdef __cplusplus
 }
 #endif
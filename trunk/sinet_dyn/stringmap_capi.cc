@@ -1,6 +1,82 @@
 #include "pch.h"
 #include "stringmap_capi.h"
 
+// cursor over a map, before the first entry until the first next()
+template <class Map>
+struct stringmap_iter
+{
+  Map*                    map;
+  typename Map::iterator  it;
+  int                     started;
+};
+
+template <class Map>
+static void* iter_begin(void* stringmap)
+{
+  if (!stringmap)
+    return NULL;
+  stringmap_iter<Map>* iter = new stringmap_iter<Map>;
+  iter->map = reinterpret_cast<Map*>(stringmap);
+  iter->it = iter->map->begin();
+  iter->started = 0;
+  return iter;
+}
+
+template <class Map>
+static int iter_next(void* iter)
+{
+  if (!iter)
+    return 0;
+  stringmap_iter<Map>* real_iter = reinterpret_cast<stringmap_iter<Map>*>(iter);
+  if (!real_iter->started)
+    real_iter->started = 1;
+  else if (real_iter->it != real_iter->map->end())
+    real_iter->it++;
+  return real_iter->it != real_iter->map->end();
+}
+
+// the entry |iter| is on, NULL before the first or past the last
+template <class Map>
+static typename Map::iterator* iter_get(void* iter)
+{
+  if (!iter)
+    return NULL;
+  stringmap_iter<Map>* real_iter = reinterpret_cast<stringmap_iter<Map>*>(iter);
+  if (!real_iter->started || real_iter->it == real_iter->map->end())
+    return NULL;
+  return &real_iter->it;
+}
+
+template <class Char>
+static const Char* borrow(const std::basic_string<Char>& str, size_t* length)
+{
+  if (length)
+    *length = str.length();
+  return str.c_str();
+}
+
+template <class Map, class Char>
+static int map_export(void* stringmap, int count, const Char** keys, size_t* key_lengths,
+                      const Char** values, size_t* value_lengths)
+{
+  if (!stringmap)
+    return 0;
+  Map* map = reinterpret_cast<Map*>(stringmap);
+  int i = 0;
+  for (typename Map::iterator it = map->begin(); it != map->end() && i < count; it++, i++)
+  {
+    if (keys)
+      keys[i] = it->first.c_str();
+    if (key_lengths)
+      key_lengths[i] = it->first.length();
+    if (values)
+      values[i] = it->second.c_str();
+    if (value_lengths)
+      value_lengths[i] = it->second.length();
+  }
+  return (int)map->size();
+}
+
 SINET_DYN_API _stringmap_t _stringmap_alloc()
 {
   std::map<std::wstring, std::wstring>* map = new std::map<std::wstring, std::wstring>();
@@ -9,7 +85,7 @@ SINET_DYN_API _stringmap_t _stringmap_alloc()
 
 SINET_DYN_API void _stringmap_free(_stringmap_t stringmap)
 {
-  if (!stringmap)
+  if (stringmap)
     delete reinterpret_cast<std::map<std::wstring, std::wstring>*>(stringmap);
 }
 
@@ -64,4 +140,136 @@ SINET_DYN_API void _stringmap_append(_stringmap_t stringmap, wchar_t* key, wchar
 {
   if (stringmap)
     (*(reinterpret_cast<std::map<std::wstring, std::wstring>*>(stringmap)))[key] = value;
-}
\ No newline at end of file
+}
+
+typedef std::map<std::wstring, std::wstring> wstringmap;
+
+SINET_DYN_API _stringmap_iter_t _stringmap_iter_begin(_stringmap_t stringmap)
+{
+  return iter_begin<wstringmap>(stringmap);
+}
+
+SINET_DYN_API int _stringmap_iter_next(_stringmap_iter_t iter)
+{
+  return iter_next<wstringmap>(iter);
+}
+
+SINET_DYN_API const wchar_t* _stringmap_iter_key(_stringmap_iter_t iter, size_t* length)
+{
+  wstringmap::iterator* it = iter_get<wstringmap>(iter);
+  return it ? borrow((*it)->first, length) : NULL;
+}
+
+SINET_DYN_API const wchar_t* _stringmap_iter_value(_stringmap_iter_t iter, size_t* length)
+{
+  wstringmap::iterator* it = iter_get<wstringmap>(iter);
+  return it ? borrow((*it)->second, length) : NULL;
+}
+
+SINET_DYN_API void _stringmap_iter_free(_stringmap_iter_t iter)
+{
+  if (iter)
+    delete reinterpret_cast<stringmap_iter<wstringmap>*>(iter);
+}
+
+SINET_DYN_API int _stringmap_export(_stringmap_t stringmap, int count,
+                                    const wchar_t** keys, size_t* key_lengths,
+                                    const wchar_t** values, size_t* value_lengths)
+{
+  return map_export<wstringmap>(stringmap, count, keys, key_lengths, values, value_lengths);
+}
+
+typedef std::map<std::string, std::string> utf8stringmap;
+
+SINET_DYN_API _utf8stringmap_t _utf8stringmap_alloc()
+{
+  return reinterpret_cast<_utf8stringmap_t>(new utf8stringmap());
+}
+
+SINET_DYN_API void _utf8stringmap_free(_utf8stringmap_t stringmap)
+{
+  if (stringmap)
+    delete reinterpret_cast<utf8stringmap*>(stringmap);
+}
+
+SINET_DYN_API int _utf8stringmap_get_size(_utf8stringmap_t stringmap)
+{
+  if (stringmap)
+    return reinterpret_cast<utf8stringmap*>(stringmap)->size();
+  return 0;
+}
+
+SINET_DYN_API _utf8string_t _utf8stringmap_get_key(_utf8stringmap_t stringmap, int index)
+{
+  if (stringmap && index >= 0 && index < _utf8stringmap_get_size(stringmap))
+  {
+    utf8stringmap::iterator it = reinterpret_cast<utf8stringmap*>(stringmap)->begin();
+    advance(it, index);
+    return _utf8string_alloc_length(it->first.c_str(), it->first.length());
+  }
+  return NULL;
+}
+
+SINET_DYN_API _utf8string_t _utf8stringmap_get_value(_utf8stringmap_t stringmap, int index)
+{
+  if (stringmap && index >= 0 && index < _utf8stringmap_get_size(stringmap))
+  {
+    utf8stringmap::iterator it = reinterpret_cast<utf8stringmap*>(stringmap)->begin();
+    advance(it, index);
+    return _utf8string_alloc_length(it->second.c_str(), it->second.length());
+  }
+  return NULL;
+}
+
+SINET_DYN_API _utf8string_t _utf8stringmap_get_find(_utf8stringmap_t stringmap, const char* key)
+{
+  if (stringmap && key)
+  {
+    utf8stringmap* pmap = reinterpret_cast<utf8stringmap*>(stringmap);
+    utf8stringmap::iterator it = pmap->find(key);
+    if (it != pmap->end())
+      return _utf8string_alloc_length(it->second.c_str(), it->second.length());
+  }
+  return NULL;
+}
+
+SINET_DYN_API void _utf8stringmap_append(_utf8stringmap_t stringmap, const char* key, const char* value)
+{
+  if (stringmap && key && value)
+    (*(reinterpret_cast<utf8stringmap*>(stringmap)))[key] = value;
+}
+
+SINET_DYN_API _utf8stringmap_iter_t _utf8stringmap_iter_begin(_utf8stringmap_t stringmap)
+{
+  return iter_begin<utf8stringmap>(stringmap);
+}
+
+SINET_DYN_API int _utf8stringmap_iter_next(_utf8stringmap_iter_t iter)
+{
+  return iter_next<utf8stringmap>(iter);
+}
+
+SINET_DYN_API const char* _utf8stringmap_iter_key(_utf8stringmap_iter_t iter, size_t* length)
+{
+  utf8stringmap::iterator* it = iter_get<utf8stringmap>(iter);
+  return it ? borrow((*it)->first, length) : NULL;
+}
+
+SINET_DYN_API const char* _utf8stringmap_iter_value(_utf8stringmap_iter_t iter, size_t* length)
+{
+  utf8stringmap::iterator* it = iter_get<utf8stringmap>(iter);
+  return it ? borrow((*it)->second, length) : NULL;
+}
+
+SINET_DYN_API void _utf8stringmap_iter_free(_utf8stringmap_iter_t iter)
+{
+  if (iter)
+    delete reinterpret_cast<stringmap_iter<utf8stringmap>*>(iter);
+}
+
+SINET_DYN_API int _utf8stringmap_export(_utf8stringmap_t stringmap, int count,
+                                        const char** keys, size_t* key_lengths,
+                                        const char** values, size_t* value_lengths)
+{
+  return map_export<utf8stringmap>(stringmap, count, keys, key_lengths, values, value_lengths);
+}
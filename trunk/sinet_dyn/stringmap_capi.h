@@ -12,11 +12,55 @@ extern "C" {
   SINET_DYN_API _stringmap_t _stringmap_alloc();
   SINET_DYN_API void _stringmap_free(_stringmap_t stringmap);
   SINET_DYN_API int _stringmap_get_size(_stringmap_t stringmap);
+  // by index, each call walks from the first entry and copies, prefer
+  // the iterator below
   SINET_DYN_API _string_t _stringmap_get_key(_stringmap_t stringmap, int index);
   SINET_DYN_API _string_t _stringmap_get_value(_stringmap_t stringmap, int index);
   SINET_DYN_API _string_t _stringmap_get_find(_stringmap_t stringmap, _string_t key);
   SINET_DYN_API void _stringmap_append(_stringmap_t stringmap, _string_t key, _string_t value);
 
+  // walk a map without copying it, _stringmap_iter_next moves to the
+  // next entry and returns 0 once past the last:
+  //   _stringmap_iter_t it = _stringmap_iter_begin(map);
+  //   while (_stringmap_iter_next(it))
+  //     use(_stringmap_iter_key(it, NULL), _stringmap_iter_value(it, NULL));
+  //   _stringmap_iter_free(it);
+  // the strings are borrowed from the map, valid until it is changed or
+  // freed. |length| is optional and receives the length in characters.
+  typedef void* _stringmap_iter_t;
+  SINET_DYN_API _stringmap_iter_t _stringmap_iter_begin(_stringmap_t stringmap);
+  SINET_DYN_API int _stringmap_iter_next(_stringmap_iter_t iter);
+  SINET_DYN_API const wchar_t* _stringmap_iter_key(_stringmap_iter_t iter, size_t* length);
+  SINET_DYN_API const wchar_t* _stringmap_iter_value(_stringmap_iter_t iter, size_t* length);
+  SINET_DYN_API void _stringmap_iter_free(_stringmap_iter_t iter);
+  // borrowed pointers to the first |count| entries in one pass, any of
+  // the arrays may be NULL
+  // @returns the number of entries in the map
+  SINET_DYN_API int _stringmap_export(_stringmap_t stringmap, int count,
+                                      const wchar_t** keys, size_t* key_lengths,
+                                      const wchar_t** values, size_t* value_lengths);
+
+  // UTF-8 string map, wraps a std::map<std::string, std::string>
+  typedef void* _utf8stringmap_t;
+  SINET_DYN_API _utf8stringmap_t _utf8stringmap_alloc();
+  SINET_DYN_API void _utf8stringmap_free(_utf8stringmap_t stringmap);
+  SINET_DYN_API int _utf8stringmap_get_size(_utf8stringmap_t stringmap);
+  SINET_DYN_API _utf8string_t _utf8stringmap_get_key(_utf8stringmap_t stringmap, int index);
+  SINET_DYN_API _utf8string_t _utf8stringmap_get_value(_utf8stringmap_t stringmap, int index);
+  SINET_DYN_API _utf8string_t _utf8stringmap_get_find(_utf8stringmap_t stringmap, const char* key);
+  SINET_DYN_API void _utf8stringmap_append(_utf8stringmap_t stringmap, const char* key, const char* value);
+
+  // as for _stringmap_t, lengths are in bytes
+  typedef void* _utf8stringmap_iter_t;
+  SINET_DYN_API _utf8stringmap_iter_t _utf8stringmap_iter_begin(_utf8stringmap_t stringmap);
+  SINET_DYN_API int _utf8stringmap_iter_next(_utf8stringmap_iter_t iter);
+  SINET_DYN_API const char* _utf8stringmap_iter_key(_utf8stringmap_iter_t iter, size_t* length);
+  SINET_DYN_API const char* _utf8stringmap_iter_value(_utf8stringmap_iter_t iter, size_t* length);
+  SINET_DYN_API void _utf8stringmap_iter_free(_utf8stringmap_iter_t iter);
+  SINET_DYN_API int _utf8stringmap_export(_utf8stringmap_t stringmap, int count,
+                                          const char** keys, size_t* key_lengths,
+                                          const char** values, size_t* value_lengths);
+
 #ifdef __cplusplus
 }
 #endif
@@ -83,6 +83,67 @@ _config_t* SINET_DYN_CALLBACK _get_config(struct __task_t* self)
   return config_cpptoc::Wrap(task_cpptoc::Get(self)->get_config());
 }
 
+size_t SINET_DYN_CALLBACK _get_results(struct __task_t* self, _request_result_t* results, size_t count)
+{
+  refptr<task> task_in = task_cpptoc::Get(self);
+  // the pool is still writing the responses of an unfinished task
+  int status = task_in->get_status();
+  if (status != taskstatus_completed && status != taskstatus_canceled)
+    return 0;
+  std::vector<int> ids;
+  task_in->get_request_ids(ids);
+  for (size_t i = 0; results && i < count && i < ids.size(); i++)
+  {
+    refptr<request> req = task_in->get_request(ids[i]);
+    _request_result_t& result = results[i];
+    result.request_id = ids[i];
+    result.request_error = req->get_request_error();
+    result.response_errcode = req->get_response_errcode();
+    result.attempts = req->get_attempts();
+    result.retrieved_size = req->get_retrieved_size();
+    result.body = NULL;
+    if (req->get_request_outmode() == REQ_OUTBUFFER)
+    {
+      refptr<shared_buffer> body = req->lease_response_buffer();
+      // the reference goes with the lease
+      body->AddRef();
+      result.body = body.get();
+    }
+  }
+  return ids.size();
+}
+
+void task_callbacks_from_c(const _task_callbacks_t* callbacks_in,
+                           task_callbacks& callbacks_out)
+{
+  memset(&callbacks_out, 0, sizeof(callbacks_out));
+  if (!callbacks_in)
+    return;
+  callbacks_out.on_status = callbacks_in->on_status;
+  callbacks_out.on_progress = callbacks_in->on_progress;
+  callbacks_out.on_data = callbacks_in->on_data;
+  callbacks_out.user = callbacks_in->user;
+}
+
+void SINET_DYN_CALLBACK _set_callbacks(struct __task_t* self, const _task_callbacks_t* callbacks)
+{
+  task_callbacks callbacks_in;
+  task_callbacks_from_c(callbacks, callbacks_in);
+  task_cpptoc::Get(self)->set_callbacks(callbacks_in);
+}
+
+void SINET_DYN_CALLBACK _get_callbacks(struct __task_t* self, _task_callbacks_t* callbacks)
+{
+  if (!callbacks)
+    return;
+  task_callbacks callbacks_out;
+  task_cpptoc::Get(self)->get_callbacks(callbacks_out);
+  callbacks->on_status = callbacks_out.on_status;
+  callbacks->on_progress = callbacks_out.on_progress;
+  callbacks->on_data = callbacks_out.on_data;
+  callbacks->user = callbacks_out.user;
+}
+
 task_cpptoc::task_cpptoc(task* cls):
 cpptoc<task_cpptoc, task, _task_t>(cls)
 {
@@ -99,4 +160,7 @@ cpptoc<task_cpptoc, task, _task_t>(cls)
   struct_.struct_.get_status        = _get_status;
   struct_.struct_.set_status        = _set_status;
   struct_.struct_.use_config        = _use_config;
+  struct_.struct_.get_results       = _get_results;
+  struct_.struct_.set_callbacks     = _set_callbacks;
+  struct_.struct_.get_callbacks     = _get_callbacks;
 }
\ No newline at end of file
@@ -13,4 +13,8 @@ public:
   virtual ~task_cpptoc(void){}
 };
 
+// |callbacks_in| as the task takes them, all NULL for NULL
+void task_callbacks_from_c(const _task_callbacks_t* callbacks_in,
+                           task_callbacks& callbacks_out);
+
 #endif // TASK_CPPTOC_H
\ No newline at end of file
@@ -1,46 +1,64 @@
 #include "pch.h"
 #include "sinet_capi.h"
-#include <curl/curl.h>
 #include "../sinet/strings.h"
+#include "../sinet/urls.h"
 
 using namespace sinet;
 
-SINET_DYN_API int sinet_urlencode(const wchar_t* str_in, wchar_t* str_out, int* length_inout)
+// copy |str| and a terminator into the caller's buffer if it holds
+// *length_inout characters, otherwise report the length needed
+template<typename char_t>
+static int copy_out(const std::basic_string<char_t>& str, char_t* str_out, int* length_inout)
 {
-  int result = 0;
-  std::string url_utf8 = strings::wstring_utf8string(str_in);
-  CURL *handle = curl_easy_init();
-  char *encodedURL = curl_easy_escape(handle, url_utf8.c_str(), url_utf8.length());
-  int real_len = strlen(encodedURL);
-  if (encodedURL && (*length_inout >= real_len))
+  int real_len = (int)str.length();
+  if (*length_inout < real_len)
   {
-    std::wstring encodedURLw = strings::utf8string_wstring(encodedURL);
-    memcpy(str_out, encodedURLw.c_str(), real_len * sizeof(wchar_t));
-    str_out[real_len] = 0;
     *length_inout = real_len;
-    curl_free(encodedURL);
-    result = 1;
+    return 0;
   }
-  curl_easy_cleanup(handle);
-  return result;
+  memcpy(str_out, str.data(), real_len * sizeof(char_t));
+  str_out[real_len] = 0;
+  *length_inout = real_len;
+  return 1;
+}
+
+SINET_DYN_API int sinet_urlencode(const wchar_t* str_in, wchar_t* str_out, int* length_inout)
+{
+  return copy_out(urls::encode(std::wstring(str_in)), str_out, length_inout);
 }
 
 SINET_DYN_API int sinet_urldecode(const wchar_t* str_in, wchar_t* str_out, int* length_inout)
 {
-  int result = 0;
-  CURL *handle = curl_easy_init();
-  int real_len;
-  std::string encodedURL_utf8 = strings::wstring_utf8string(str_in);
-  char *decodedURL = curl_easy_unescape(handle, encodedURL_utf8.c_str(), encodedURL_utf8.length(), &real_len);
-  if (decodedURL && (*length_inout >= real_len))
-  {
-    std::wstring decodedURLw = strings::utf8string_wstring(decodedURL);
-    memcpy(str_out, decodedURLw.c_str(), real_len * sizeof(wchar_t));
-    str_out[real_len] = 0;
-    *length_inout = real_len;
-    curl_free(decodedURL);
-    result = 1;
-  }
-  curl_easy_cleanup(handle);
-  return result;
-}
\ No newline at end of file
+  return copy_out(urls::decode(std::wstring(str_in)), str_out, length_inout);
+}
+
+SINET_DYN_API int sinet_urlencode_utf8(const char* str_in, char* str_out, int* length_inout)
+{
+  std::string encoded;
+  urls::encode(str_in, strlen(str_in), encoded);
+  return copy_out(encoded, str_out, length_inout);
+}
+
+SINET_DYN_API int sinet_urldecode_utf8(const char* str_in, char* str_out, int* length_inout)
+{
+  std::string decoded;
+  urls::decode(str_in, strlen(str_in), decoded);
+  return copy_out(decoded, str_out, length_inout);
+}
+
+SINET_DYN_API _string_t sinet_build_query(_stringmap_t params)
+{
+  if (!params)
+    return _string_alloc(L"");
+  std::wstring query = urls::build_query(
+    *reinterpret_cast<si_stringmap*>(params));
+  return _string_alloc_length(query.c_str(), query.length());
+}
+
+SINET_DYN_API _utf8string_t sinet_build_query_utf8(_utf8stringmap_t params)
+{
+  std::string query;
+  if (params)
+    urls::build_query(*reinterpret_cast<si_stringmap_utf8*>(params), query);
+  return _utf8string_alloc_length(query.c_str(), query.length());
+}
@@ -13,7 +13,7 @@ refptr<config> config::create_instance()
 
 int config_ctocpp::get_strvar(int id, std::wstring& strvarout)
 {
-  if (_MEMBER_MISSING(struct_, get_strvar))
+  if (_CTOCPP_MISSING(get_strvar))
     return 0;
   _string_t _strvarout;
   if (struct_->get_strvar(struct_, id, &_strvarout))
@@ -27,7 +27,7 @@ int config_ctocpp::get_strvar(int id, std::wstring& strvarout)
 
 void config_ctocpp::set_strvar(int id, std::wstring strvarin)
 {
-  if (_MEMBER_MISSING(struct_, set_strvar))
+  if (_CTOCPP_MISSING(set_strvar))
     return;
   _string_t _strvarin = _string_alloc(strvarin.c_str());
   struct_->set_strvar(struct_, id, _strvarin);
@@ -36,8 +36,68 @@ void config_ctocpp::set_strvar(int id, std::wstring strvarin)
 
 int config_ctocpp::remove_strvar(int id)
 {
-  if (_MEMBER_MISSING(struct_, remove_strvar))
+  if (_CTOCPP_MISSING(remove_strvar))
     return 0;
   struct_->remove_strvar(struct_, id);
   return 1;
-}
\ No newline at end of file
+}
+
+int config_ctocpp::get_strvar_utf8(int id, std::string& strvarout)
+{
+  if (!_CTOCPP_MISSING(copy_strvar_utf8))
+  {
+    char buffer[256];
+    int length = sizeof(buffer) - 1;
+    int ret = struct_->copy_strvar_utf8(struct_, id, buffer, &length);
+    if (ret > 0)
+      strvarout.assign(buffer, length);
+    // too long for the stack buffer
+    std::vector<char> heap_buffer;
+    while (ret < 0)
+    {
+      heap_buffer.resize(length + 1);
+      ret = struct_->copy_strvar_utf8(struct_, id, &heap_buffer[0], &length);
+      if (ret > 0)
+        strvarout.assign(&heap_buffer[0], length);
+    }
+    return ret;
+  }
+  if (_CTOCPP_MISSING(get_strvar_utf8))
+    return 0;
+  _utf8string_t _strvarout;
+  if (struct_->get_strvar_utf8(struct_, id, &_strvarout))
+  {
+    strvarout.assign(_strvarout, _utf8string_length(_strvarout));
+    _utf8string_free(_strvarout);
+    return 1;
+  }
+  return 0;
+}
+
+void config_ctocpp::set_strvar_utf8(int id, const std::string& strvarin)
+{
+  if (_CTOCPP_MISSING(set_strvar_utf8))
+    return;
+  struct_->set_strvar_utf8(struct_, id, strvarin.c_str());
+}
+
+int config_ctocpp::get_intvar(int id, int& intvarout)
+{
+  if (_CTOCPP_MISSING(get_intvar))
+    return 0;
+  return struct_->get_intvar(struct_, id, &intvarout);
+}
+
+void config_ctocpp::set_intvar(int id, int intvarin)
+{
+  if (_CTOCPP_MISSING(set_intvar))
+    return;
+  struct_->set_intvar(struct_, id, intvarin);
+}
+
+int config_ctocpp::remove_intvar(int id)
+{
+  if (_CTOCPP_MISSING(remove_intvar))
+    return 0;
+  return struct_->remove_intvar(struct_, id);
+}
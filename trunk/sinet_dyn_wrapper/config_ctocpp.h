@@ -16,6 +16,13 @@ public:
   virtual int get_strvar(int id, std::wstring& strvarout);
   virtual void set_strvar(int id, std::wstring strvarin);
   virtual int remove_strvar(int id);
+
+  virtual int get_strvar_utf8(int id, std::string& strvarout);
+  virtual void set_strvar_utf8(int id, const std::string& strvarin);
+
+  virtual int get_intvar(int id, int& intvarout);
+  virtual void set_intvar(int id, int intvarin);
+  virtual int remove_intvar(int id);
 };
 
 #endif // CONFIG_CTOCPP_H
\ No newline at end of file
@@ -5,10 +5,18 @@
 #include "../sinet/api_refptr.h"
 #include "../sinet_dyn/sinet_capi.h"
 
+// |f| of the wrapped struct is missing or not set. base.size is read
+// once when the struct is wrapped and the member end is a constant, so
+// the check costs a compare before each call.
+#define _CTOCPP_MISSING(f)  \
+  (_MEMBER_END(struct_type, f) > struct_size_ || !struct_->f)
+
 template <class ClassName, class BaseName, class StructName>
 class ctocpp : public threadsafe_base<BaseName>
 {
 public:
+  typedef StructName struct_type;
+
   // Use this method to create a wrapper class instance for a structure
   // received from the other side.
   static refptr<BaseName> Wrap(StructName* s)
@@ -26,7 +34,7 @@ public:
 
   // Use this method to retrieve the underlying structure from a wrapper class
   // instance for return back to the other side.
-  static StructName* Unwrap(refptr<BaseName> c)
+  static StructName* Unwrap(const refptr<BaseName>& c)
   {
     // Cast the object to our wrapper class type.
     ClassName* wrapper = static_cast<ClassName*>(c.get());
@@ -38,7 +46,8 @@ public:
   }
 
   ctocpp(StructName* str)
-    : struct_(str)
+    : struct_(str),
+      struct_size_(str ? str->base.size : 0)
   {
   }
   virtual ~ctocpp()
@@ -85,6 +94,25 @@ public:
 
 protected:
   StructName* struct_;
+  // members are only appended, those ending within this size exist
+  size_t      struct_size_;
 };
 
+// read a string through one of the copy_*_utf8 members, into a stack
+// buffer and onto the heap only when it does not fit
+template <class StructName>
+std::string copy_utf8(StructName* s, int (SINET_DYN_CALLBACK *copy)(StructName*, char*, int*))
+{
+  char buffer[256];
+  int length = sizeof(buffer) - 1;
+  if (copy(s, buffer, &length))
+    return std::string(buffer, length);
+  // the string may have grown since, try until it fits
+  std::vector<char> heap_buffer;
+  do
+    heap_buffer.resize(length + 1);
+  while (!copy(s, &heap_buffer[0], &length));
+  return std::string(&heap_buffer[0], length);
+}
+
 #endif // CTOCPP_H
\ No newline at end of file
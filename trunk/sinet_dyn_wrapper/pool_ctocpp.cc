@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "pool_ctocpp.h"
 #include "task_ctocpp.h"
+#include "config_ctocpp.h"
 
 using namespace sinet;
 
@@ -12,17 +13,17 @@ refptr<pool> pool::create_instance()
   return NULL;
 }
 
-void pool_ctocpp::execute(refptr<task> task_in)
+void pool_ctocpp::execute(const refptr<task>& task_in)
 {
-  if (_MEMBER_MISSING(struct_, execute))
+  if (_CTOCPP_MISSING(execute))
     return;
 
   struct_->execute(struct_, task_ctocpp::Unwrap(task_in));
 }
 
-void pool_ctocpp::cancel(refptr<task> task_in)
+void pool_ctocpp::cancel(const refptr<task>& task_in)
 {
-  if (_MEMBER_MISSING(struct_, cancel))
+  if (_CTOCPP_MISSING(cancel))
     return;
 
   struct_->cancel(struct_, task_ctocpp::Unwrap(task_in));
@@ -30,32 +31,108 @@ void pool_ctocpp::cancel(refptr<task> task_in)
 
 void pool_ctocpp::clear_all()
 {
-  if (_MEMBER_MISSING(struct_, clear_all))
+  if (_CTOCPP_MISSING(clear_all))
     return;
 
   struct_->clear_all(struct_);
 }
 
-int pool_ctocpp::is_running(refptr<task> task_in)
+int pool_ctocpp::is_running(const refptr<task>& task_in)
 {
-  if (_MEMBER_MISSING(struct_, is_running))
+  if (_CTOCPP_MISSING(is_running))
     return 0;
 
   return struct_->is_running(struct_, task_ctocpp::Unwrap(task_in));
 }
 
-int pool_ctocpp::is_queued(refptr<task> task_in)
+int pool_ctocpp::is_queued(const refptr<task>& task_in)
 {
-  if (_MEMBER_MISSING(struct_, is_queued))
+  if (_CTOCPP_MISSING(is_queued))
     return 0;
 
   return struct_->is_queued(struct_, task_ctocpp::Unwrap(task_in));
 }
 
-int pool_ctocpp::is_running_or_queued(refptr<task> task_in)
+int pool_ctocpp::is_running_or_queued(const refptr<task>& task_in)
 {
-  if (_MEMBER_MISSING(struct_, is_running_or_queued))
+  if (_CTOCPP_MISSING(is_running_or_queued))
     return 0;
 
   return struct_->is_running_or_queued(struct_, task_ctocpp::Unwrap(task_in));
-}
\ No newline at end of file
+}
+
+void pool_ctocpp::use_config(const refptr<config>& config)
+{
+  if (_CTOCPP_MISSING(use_config))
+    return;
+
+  struct_->use_config(struct_, config_ctocpp::Unwrap(config));
+}
+
+refptr<config> pool_ctocpp::get_config()
+{
+  if (_CTOCPP_MISSING(get_config))
+    return NULL;
+
+  return config_ctocpp::Wrap(struct_->get_config(struct_));
+}
+
+void pool_ctocpp::get_cache_stats(cache_stats& stats)
+{
+  memset(&stats, 0, sizeof(stats));
+  if (_CTOCPP_MISSING(get_cache_stats))
+    return;
+
+  _cache_stats_t _stats;
+  memset(&_stats, 0, sizeof(_stats));
+  struct_->get_cache_stats(struct_, &_stats);
+  stats.hits = _stats.hits;
+  stats.misses = _stats.misses;
+  stats.stores = _stats.stores;
+  stats.evictions = _stats.evictions;
+  stats.entries = _stats.entries;
+  stats.bytes = _stats.bytes;
+  stats.disk_hits = _stats.disk_hits;
+  stats.revalidated = _stats.revalidated;
+  stats.disk_entries = _stats.disk_entries;
+  stats.disk_bytes = _stats.disk_bytes;
+}
+
+void pool_ctocpp::get_stats(pool_stats& stats)
+{
+  memset(&stats, 0, sizeof(stats));
+  if (_CTOCPP_MISSING(get_stats))
+    return;
+
+  _pool_stats_t _stats;
+  memset(&_stats, 0, sizeof(_stats));
+  struct_->get_stats(struct_, &_stats, sizeof(_stats));
+  stats.tasks_executed = _stats.tasks_executed;
+  stats.tasks_completed = _stats.tasks_completed;
+  stats.tasks_canceled = _stats.tasks_canceled;
+  stats.tasks_queued = _stats.tasks_queued;
+  stats.tasks_running = _stats.tasks_running;
+  stats.transfers = _stats.transfers;
+  stats.retries = _stats.retries;
+  stats.transfers_active = _stats.transfers_active;
+  stats.transfers_waiting = _stats.transfers_waiting;
+  for (int i = 0; i < REQ_ERR_COUNT && i < 15; i++)
+    stats.requests[i] = _stats.requests[i];
+  stats.bytes_received = _stats.bytes_received;
+  stats.bytes_sent = _stats.bytes_sent;
+  stats.connections_opened = _stats.connections_opened;
+  stats.connections_reused = _stats.connections_reused;
+  stats.dns_lookups = _stats.dns_lookups;
+  stats.tls_handshakes = _stats.tls_handshakes;
+  stats.queue_wait = _stats.queue_wait;
+  stats.dns = _stats.dns;
+  stats.connect = _stats.connect;
+  stats.tls = _stats.tls;
+  stats.ttfb = _stats.ttfb;
+  stats.total = _stats.total;
+}
+
+intptr_t pool_ctocpp::get_event_fd()
+{
+  return _pool_get_event_fd(struct_);
+}
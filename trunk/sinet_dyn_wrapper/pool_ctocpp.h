@@ -13,13 +13,19 @@ public:
     : ctocpp<pool_ctocpp, pool, _pool_t>(plt) {}
   virtual ~pool_ctocpp() {}
 
-  virtual int is_running(refptr<task> task_in);
-  virtual int is_queued(refptr<task> task_in);
-  virtual int is_running_or_queued(refptr<task> task_in);
+  virtual int is_running(const refptr<task>& task_in);
+  virtual int is_queued(const refptr<task>& task_in);
+  virtual int is_running_or_queued(const refptr<task>& task_in);
 
-  virtual void execute(refptr<task> task_in);
-  virtual void cancel(refptr<task> task_in);
+  virtual void execute(const refptr<task>& task_in);
+  virtual void cancel(const refptr<task>& task_in);
   virtual void clear_all();
+
+  virtual void use_config(const refptr<config>& config);
+  virtual refptr<config> get_config();
+  virtual void get_cache_stats(cache_stats& stats);
+  virtual void get_stats(pool_stats& stats);
+  virtual intptr_t get_event_fd();
 };
 
 #endif // POOL_CTOCPP_H
\ No newline at end of file
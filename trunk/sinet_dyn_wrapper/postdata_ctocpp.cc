@@ -14,21 +14,21 @@ refptr<postdata> postdata::create_instance()
 
 void postdata_ctocpp::clear()
 {
-  if (_MEMBER_MISSING(struct_, clear))
+  if (_CTOCPP_MISSING(clear))
     return;
   struct_->clear(struct_);
 }
 
-void postdata_ctocpp::add_elem(refptr<postdataelem> elem)
+void postdata_ctocpp::add_elem(const refptr<postdataelem>& elem)
 {
-  if (_MEMBER_MISSING(struct_, add_elem))
+  if (_CTOCPP_MISSING(add_elem))
     return;
   struct_->add_elem(struct_, postdataelem_ctocpp::Unwrap(elem));
 }
 
-int postdata_ctocpp::remove_elem(refptr<postdataelem> elem)
+int postdata_ctocpp::remove_elem(const refptr<postdataelem>& elem)
 {
-  if (_MEMBER_MISSING(struct_, remove_elem))
+  if (_CTOCPP_MISSING(remove_elem))
     return 0;
   return struct_->remove_elem(struct_, postdataelem_ctocpp::Unwrap(elem));
 }
@@ -38,7 +38,7 @@ int postdata_ctocpp::remove_elem(refptr<postdataelem> elem)
 void postdata_ctocpp::get_elements(std::vector<refptr<postdataelem> >& elems)
 {
   elems.clear();
-  if (_MEMBER_MISSING(struct_, get_elements))
+  if (_CTOCPP_MISSING(get_elements))
     return;
   int count = (int)get_element_count();
   _postdataelem_t* pdeptr;
@@ -53,7 +53,7 @@ void postdata_ctocpp::get_elements(std::vector<refptr<postdataelem> >& elems)
 
 int postdata_ctocpp::get_element_count()
 {
-  if (_MEMBER_MISSING(struct_, get_element_count))
+  if (_CTOCPP_MISSING(get_element_count))
     return 0;
   return struct_->get_element_count(struct_);
 }
\ No newline at end of file
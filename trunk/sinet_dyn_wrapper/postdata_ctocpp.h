@@ -14,8 +14,8 @@ public:
   virtual ~postdata_ctocpp() {}
 
   virtual void clear();
-  virtual void add_elem(refptr<postdataelem> elem);
-  virtual int remove_elem(refptr<postdataelem> elem);
+  virtual void add_elem(const refptr<postdataelem>& elem);
+  virtual int remove_elem(const refptr<postdataelem>& elem);
   virtual void get_elements(std::vector<refptr<postdataelem> >& elems);
   virtual int get_element_count();
 };
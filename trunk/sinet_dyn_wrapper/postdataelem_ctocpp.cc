@@ -13,14 +13,14 @@ refptr<postdataelem> postdataelem::create_instance()
 
 void postdataelem_ctocpp::set_name(const wchar_t* fieldname)
 {
-  if (_MEMBER_MISSING(struct_, set_name))
+  if (_CTOCPP_MISSING(set_name))
     return;
   struct_->set_name(struct_, fieldname);
 }
 
 std::wstring postdataelem_ctocpp::get_name()
 {
-  if (_MEMBER_MISSING(struct_, get_name))
+  if (_CTOCPP_MISSING(get_name))
     return L"";
   _string_t _name = struct_->get_name(struct_);
   std::wstring name = _name;
@@ -30,42 +30,42 @@ std::wstring postdataelem_ctocpp::get_name()
 
 void postdataelem_ctocpp::setto_empty()
 {
-  if (_MEMBER_MISSING(struct_, setto_empty))
+  if (_CTOCPP_MISSING(setto_empty))
     return;
   struct_->setto_empty(struct_);
 }
 
 void postdataelem_ctocpp::setto_file(const wchar_t* filename)
 {
-  if (_MEMBER_MISSING(struct_, setto_file))
+  if (_CTOCPP_MISSING(setto_file))
     return;
   struct_->setto_file(struct_, filename);
 }
 
 void postdataelem_ctocpp::setto_buffer(const void* bytes_in, const size_t size_in)
 {
-  if (_MEMBER_MISSING(struct_, setto_buffer))
+  if (_CTOCPP_MISSING(setto_buffer))
     return;
   struct_->setto_buffer(struct_, bytes_in, size_in);
 }
 
 void postdataelem_ctocpp::setto_text(const wchar_t* text)
 {
-  if (_MEMBER_MISSING(struct_, setto_text))
+  if (_CTOCPP_MISSING(setto_text))
     return;
   struct_->setto_text(struct_, text);
 }
 
 sinet::postdataelem_type_t postdataelem_ctocpp::get_type()
 {
-  if (_MEMBER_MISSING(struct_, get_type))
+  if (_CTOCPP_MISSING(get_type))
     return PDE_TYPE_EMPTY;
   return struct_->get_type(struct_);
 }
 
 std::wstring postdataelem_ctocpp::get_file()
 {
-  if (_MEMBER_MISSING(struct_, get_file))
+  if (_CTOCPP_MISSING(get_file))
     return L"";
   _string_t _file = struct_->get_file(struct_);
   std::wstring file = _file;
@@ -75,24 +75,81 @@ std::wstring postdataelem_ctocpp::get_file()
 
 size_t postdataelem_ctocpp::get_buffer_size()
 {
-  if (_MEMBER_MISSING(struct_, get_buffer_size))
+  if (_CTOCPP_MISSING(get_buffer_size))
     return 0;
   return struct_->get_buffer_size(struct_);
 }
 
 size_t postdataelem_ctocpp::copy_buffer_to(void* bytes_inout, size_t size_in)
 {
-  if (_MEMBER_MISSING(struct_, copy_buffer_to))
+  if (_CTOCPP_MISSING(copy_buffer_to))
     return 0;
   return struct_->copy_buffer_to(struct_, bytes_inout, size_in);
 }
 
 std::wstring postdataelem_ctocpp::get_text()
 {
-  if (_MEMBER_MISSING(struct_, get_text))
+  if (_CTOCPP_MISSING(get_text))
     return L"";
   _string_t _text = struct_->get_text(struct_);
   std::wstring text = _text;
   _string_free(_text);
   return text;
-}
\ No newline at end of file
+}
+
+void postdataelem_ctocpp::set_name_utf8(const char* fieldname)
+{
+  if (_CTOCPP_MISSING(set_name_utf8))
+    return;
+  struct_->set_name_utf8(struct_, fieldname);
+}
+
+std::string postdataelem_ctocpp::get_name_utf8()
+{
+  if (!_CTOCPP_MISSING(copy_name_utf8))
+    return copy_utf8(struct_, struct_->copy_name_utf8);
+  if (_CTOCPP_MISSING(get_name_utf8))
+    return "";
+  _utf8string_t _name = struct_->get_name_utf8(struct_);
+  std::string name(_name, _utf8string_length(_name));
+  _utf8string_free(_name);
+  return name;
+}
+
+void postdataelem_ctocpp::setto_file_utf8(const char* filename)
+{
+  if (_CTOCPP_MISSING(setto_file_utf8))
+    return;
+  struct_->setto_file_utf8(struct_, filename);
+}
+
+void postdataelem_ctocpp::setto_text_utf8(const char* text)
+{
+  if (_CTOCPP_MISSING(setto_text_utf8))
+    return;
+  struct_->setto_text_utf8(struct_, text);
+}
+
+std::string postdataelem_ctocpp::get_file_utf8()
+{
+  if (!_CTOCPP_MISSING(copy_file_utf8))
+    return copy_utf8(struct_, struct_->copy_file_utf8);
+  if (_CTOCPP_MISSING(get_file_utf8))
+    return "";
+  _utf8string_t _file = struct_->get_file_utf8(struct_);
+  std::string file(_file, _utf8string_length(_file));
+  _utf8string_free(_file);
+  return file;
+}
+
+std::string postdataelem_ctocpp::get_text_utf8()
+{
+  if (!_CTOCPP_MISSING(copy_text_utf8))
+    return copy_utf8(struct_, struct_->copy_text_utf8);
+  if (_CTOCPP_MISSING(get_text_utf8))
+    return "";
+  _utf8string_t _text = struct_->get_text_utf8(struct_);
+  std::string text(_text, _utf8string_length(_text));
+  _utf8string_free(_text);
+  return text;
+}
@@ -27,6 +27,13 @@ public:
   virtual size_t get_buffer_size();
   virtual size_t copy_buffer_to(void* bytes_inout, size_t size_in);
   virtual std::wstring get_text();
+
+  virtual void set_name_utf8(const char* fieldname);
+  virtual std::string get_name_utf8();
+  virtual void setto_file_utf8(const char* filename);
+  virtual void setto_text_utf8(const char* text);
+  virtual std::string get_file_utf8();
+  virtual std::string get_text_utf8();
 };
 
 #endif // POSTDATAELEM_CTOCPP_H
\ No newline at end of file
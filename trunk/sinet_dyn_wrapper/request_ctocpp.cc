@@ -4,6 +4,46 @@
 
 using namespace sinet;
 
+// a body borrowed through the C API, given back with the last reference.
+// Against an older sinet_dyn that cannot lend it holds a copy instead.
+class buffer_lease_ctocpp:
+  public threadsafe_base<shared_buffer>
+{
+public:
+  buffer_lease_ctocpp(_buffer_lease_t lease): m_lease(lease) {}
+  buffer_lease_ctocpp(const si_buffer& copy): m_lease(NULL), m_copy(copy) {}
+  virtual ~buffer_lease_ctocpp() { _buffer_lease_release(m_lease); }
+
+  virtual const unsigned char* get_data()
+  {
+    if (m_lease)
+      return _buffer_lease_get(m_lease);
+    return m_copy.empty() ? NULL : &m_copy[0];
+  }
+  virtual size_t get_size()
+  {
+    return m_lease ? _buffer_lease_size(m_lease) : m_copy.size();
+  }
+
+private:
+  _buffer_lease_t m_lease;
+  si_buffer       m_copy;
+};
+
+// copy a map the library handed over and free it. sinet_dyn has a heap
+// of its own, so its nodes can only be copied, not taken over.
+template <class Map, class Handle>
+static Map adopt_map(Handle handle, void (*free_map)(Handle))
+{
+  Map header;
+  if (handle)
+  {
+    header = *reinterpret_cast<Map*>(handle);
+    free_map(handle);
+  }
+  return header;
+}
+
 refptr<request> request::create_instance()
 {
   _request_t* impl = _request_create_instance();
@@ -14,14 +54,14 @@ refptr<request> request::create_instance()
 
 void request_ctocpp::set_request_method(const wchar_t* method)
 {
-  if (_MEMBER_MISSING(struct_, set_request_method))
+  if (_CTOCPP_MISSING(set_request_method))
     return;
   struct_->set_request_method(struct_, method);
 }
 
 std::wstring request_ctocpp::get_request_method()
 {
-  if (_MEMBER_MISSING(struct_, get_request_method))
+  if (_CTOCPP_MISSING(get_request_method))
     return L"";
   std::wstring method;
   _string_t _methond = struct_->get_request_method(struct_);
@@ -36,14 +76,14 @@ std::wstring request_ctocpp::get_request_method()
 
 void request_ctocpp::set_request_url(const wchar_t* url)
 {
-  if (_MEMBER_MISSING(struct_, set_request_url))
+  if (_CTOCPP_MISSING(set_request_url))
     return;
   struct_->set_request_url(struct_, url);
 }
 
 std::wstring request_ctocpp::get_request_url()
 {
-  if (_MEMBER_MISSING(struct_, get_request_url))
+  if (_CTOCPP_MISSING(get_request_url))
     return L"";
   std::wstring name;
   _string_t _name = struct_->get_request_url(struct_);
@@ -58,79 +98,65 @@ std::wstring request_ctocpp::get_request_url()
 
 void request_ctocpp::set_request_header(si_stringmap& header)
 {
-  if (_MEMBER_MISSING(struct_, set_request_header))
+  if (_CTOCPP_MISSING(set_request_header))
     return;
   struct_->set_request_header(struct_, reinterpret_cast<_stringmap_t*>(&header));
 }
 
 sinet::si_stringmap request_ctocpp::get_request_header()
 {
-  if (_MEMBER_MISSING(struct_, get_request_header))
-    return *(new sinet::si_stringmap);
-  _stringmap_t _header = struct_->get_request_header(struct_);
-  if (_header)
-  {
-    sinet::si_stringmap header;
-    sinet::si_stringmap* _header_stl = reinterpret_cast<si_stringmap*>(_header);
-    for (si_stringmap::iterator it = _header_stl->begin();
-         it != _header_stl->end(); it++)
-      header[it->first] = it->second;
-    _stringmap_free(_header);
-    return header;
-  }
-  return *(new sinet::si_stringmap);
+  if (_CTOCPP_MISSING(get_request_header))
+    return si_stringmap();
+  return adopt_map<si_stringmap>(struct_->get_request_header(struct_), _stringmap_free);
 }
 
-void request_ctocpp::set_postdata(refptr<postdata> postdata)
+void request_ctocpp::set_postdata(const refptr<postdata>& postdata)
 {
-  if (_MEMBER_MISSING(struct_, set_postdata))
+  if (_CTOCPP_MISSING(set_postdata))
     return;
   struct_->set_postdata(struct_, postdata_ctocpp::Unwrap(postdata));
 }
 
 refptr<postdata> request_ctocpp::get_postdata()
 {
-  if (_MEMBER_MISSING(struct_, get_postdata))
+  if (_CTOCPP_MISSING(get_postdata))
     return NULL;
   return postdata_ctocpp::Wrap(struct_->get_postdata(struct_));
 }
 
 void request_ctocpp::set_response_header(si_stringmap& header)
 {
-  if (_MEMBER_MISSING(struct_, set_response_header))
+  if (_CTOCPP_MISSING(set_response_header))
     return;
   struct_->set_response_header(struct_, reinterpret_cast<_stringmap_t*>(&header));
 }
 
 sinet::si_stringmap request_ctocpp::get_response_header()
 {
-  if (_MEMBER_MISSING(struct_, get_response_header))
-    return *(new sinet::si_stringmap);
-  _stringmap_t _header = struct_->get_response_header(struct_);
-  if (_header)
-  {
-    sinet::si_stringmap header;
-    sinet::si_stringmap* _header_stl = reinterpret_cast<si_stringmap*>(_header);
-    for (si_stringmap::iterator it = _header_stl->begin();
-         it != _header_stl->end(); it++)
-      header[it->first] = it->second;
-    _stringmap_free(_header);
-    return header;
-  }
-  return *(new sinet::si_stringmap);
+  if (_CTOCPP_MISSING(get_response_header))
+    return si_stringmap();
+  return adopt_map<si_stringmap>(struct_->get_response_header(struct_), _stringmap_free);
 }
 
 void request_ctocpp::set_response_buffer(si_buffer& buffer)
 {
-  if (_MEMBER_MISSING(struct_, set_response_buffer))
+  if (_CTOCPP_MISSING(set_response_buffer))
     return;
   struct_->set_response_buffer(struct_, reinterpret_cast<_buffer_t*>(&buffer));
 }
 
 sinet::si_buffer request_ctocpp::get_response_buffer()
 {
-  if (_MEMBER_MISSING(struct_, get_response_buffer))
-    return *(new sinet::si_buffer);
+  // copy straight out of the lent body, once
+  if (!_CTOCPP_MISSING(lease_response_buffer))
+  {
+    refptr<shared_buffer> body = lease_response_buffer();
+    if (body->get_size() == 0)
+      return si_buffer();
+    return si_buffer(body->get_data(), body->get_data() + body->get_size());
+  }
+  if (_CTOCPP_MISSING(get_response_buffer))
+    return si_buffer();
   si_buffer buffer;
   _buffer_t _buffer = struct_->get_response_buffer(struct_);
   if (_buffer)
@@ -140,75 +166,85 @@ sinet::si_buffer request_ctocpp::get_response_buffer()
     _buffer_free(_buffer);
     return buffer;
   }
-  return *(new sinet::si_buffer);
+  return si_buffer();
+}
+
+refptr<shared_buffer> request_ctocpp::lease_response_buffer()
+{
+  if (_CTOCPP_MISSING(lease_response_buffer))
+    return new buffer_lease_ctocpp(get_response_buffer());
+  _buffer_lease_t lease = struct_->lease_response_buffer(struct_);
+  if (!lease)
+    return new buffer_lease_ctocpp(si_buffer());
+  return new buffer_lease_ctocpp(lease);
 }
 
 void request_ctocpp::set_response_size(size_t size_in)
 {
-  if (_MEMBER_MISSING(struct_, set_response_size))
+  if (_CTOCPP_MISSING(set_response_size))
     return;
   struct_->set_response_size(struct_, size_in);
 }
 
 size_t request_ctocpp::get_response_size()
 {
-  if (_MEMBER_MISSING(struct_, get_response_size))
+  if (_CTOCPP_MISSING(get_response_size))
     return 0;
   return struct_->get_response_size(struct_);
 }
 
 void request_ctocpp::set_retrieved_size(size_t size_in)
 {
-  if (_MEMBER_MISSING(struct_, set_retrieved_size))
+  if (_CTOCPP_MISSING(set_retrieved_size))
     return;
   struct_->set_retrieved_size(struct_, size_in);
 }
 
 size_t request_ctocpp::get_retrieved_size()
 {
-  if (_MEMBER_MISSING(struct_, get_retrieved_size))
+  if (_CTOCPP_MISSING(get_retrieved_size))
     return 0;
   return struct_->get_retrieved_size(struct_);
 }
 
 void request_ctocpp::set_response_errcode(int errcode)
 {
-  if (_MEMBER_MISSING(struct_, set_response_errcode))
+  if (_CTOCPP_MISSING(set_response_errcode))
     return;
   struct_->set_response_errcode(struct_, errcode);
 }
 
 int request_ctocpp::get_response_errcode()
 {
-  if (_MEMBER_MISSING(struct_, get_response_errcode))
+  if (_CTOCPP_MISSING(get_response_errcode))
     return 0;
   return struct_->get_response_errcode(struct_);
 }
 
 void request_ctocpp::set_request_outmode(int outmode)
 {
-  if (_MEMBER_MISSING(struct_, set_request_outmode))
+  if (_CTOCPP_MISSING(set_request_outmode))
     return;
   struct_->set_request_outmode(struct_, outmode);
 }
 
 int request_ctocpp::get_request_outmode()
 {
-  if (_MEMBER_MISSING(struct_, get_request_outmode))
+  if (_CTOCPP_MISSING(get_request_outmode))
     return 0;
   return struct_->get_request_outmode(struct_);
 }
 
 void request_ctocpp::set_outfile(const wchar_t* file)
 {
-  if (_MEMBER_MISSING(struct_, set_outfile))
+  if (_CTOCPP_MISSING(set_outfile))
     return;
   struct_->set_outfile(struct_, file);
 }
 
 std::wstring request_ctocpp::get_outfile()
 {
-  if (_MEMBER_MISSING(struct_, get_outfile))
+  if (_CTOCPP_MISSING(get_outfile))
     return L"";
   std::wstring outfile;
   _string_t _outfile = struct_->get_outfile(struct_);
@@ -223,14 +259,345 @@ std::wstring request_ctocpp::get_outfile()
 
 void request_ctocpp::close_outfile()
 {
-  if (_MEMBER_MISSING(struct_, close_outfile))
+  if (_CTOCPP_MISSING(close_outfile))
     return;
   struct_->close_outfile(struct_);
 }
 
 void request_ctocpp::set_appendbuffer(const void* data, size_t size)
 {
-  if (_MEMBER_MISSING(struct_, set_appendbuffer))
+  if (_CTOCPP_MISSING(set_appendbuffer))
     return;
   struct_->set_appendbuffer(struct_, data, size);
-}
\ No newline at end of file
+}
+
+void request_ctocpp::set_request_method_utf8(const char* method)
+{
+  if (_CTOCPP_MISSING(set_request_method_utf8))
+    return;
+  struct_->set_request_method_utf8(struct_, method);
+}
+
+std::string request_ctocpp::get_request_method_utf8()
+{
+  if (!_CTOCPP_MISSING(copy_request_method_utf8))
+    return copy_utf8(struct_, struct_->copy_request_method_utf8);
+  if (_CTOCPP_MISSING(get_request_method_utf8))
+    return "";
+  std::string method;
+  _utf8string_t _method = struct_->get_request_method_utf8(struct_);
+  if (_method)
+  {
+    method.assign(_method, _utf8string_length(_method));
+    _utf8string_free(_method);
+  }
+  return method;
+}
+
+void request_ctocpp::set_request_url_utf8(const char* url)
+{
+  if (_CTOCPP_MISSING(set_request_url_utf8))
+    return;
+  struct_->set_request_url_utf8(struct_, url);
+}
+
+std::string request_ctocpp::get_request_url_utf8()
+{
+  if (!_CTOCPP_MISSING(copy_request_url_utf8))
+    return copy_utf8(struct_, struct_->copy_request_url_utf8);
+  if (_CTOCPP_MISSING(get_request_url_utf8))
+    return "";
+  std::string url;
+  _utf8string_t _url = struct_->get_request_url_utf8(struct_);
+  if (_url)
+  {
+    url.assign(_url, _utf8string_length(_url));
+    _utf8string_free(_url);
+  }
+  return url;
+}
+
+// the parsed form does not cross the C ABI, it travels as UTF-8 and is
+// parsed again on this side
+void request_ctocpp::set_request_url(const url& request_url)
+{
+  set_request_url_utf8(request_url.get_spec().c_str());
+}
+
+void request_ctocpp::get_request_url(url& request_url)
+{
+  request_url.parse(get_request_url_utf8());
+}
+
+void request_ctocpp::set_request_header_utf8(si_stringmap_utf8& header)
+{
+  if (_CTOCPP_MISSING(set_request_header_utf8))
+    return;
+  struct_->set_request_header_utf8(struct_, reinterpret_cast<_utf8stringmap_t*>(&header));
+}
+
+si_stringmap_utf8 request_ctocpp::get_request_header_utf8()
+{
+  if (_CTOCPP_MISSING(get_request_header_utf8))
+    return si_stringmap_utf8();
+  return adopt_map<si_stringmap_utf8>(struct_->get_request_header_utf8(struct_),
+                                      _utf8stringmap_free);
+}
+
+void request_ctocpp::set_response_header_utf8(si_stringmap_utf8& header)
+{
+  if (_CTOCPP_MISSING(set_response_header_utf8))
+    return;
+  struct_->set_response_header_utf8(struct_, reinterpret_cast<_utf8stringmap_t*>(&header));
+}
+
+void request_ctocpp::add_response_header_utf8(const std::string& key,
+                                              const std::string& value)
+{
+  // the library adds headers on its side, this only serves callers
+  // of the wrapper
+  si_stringmap_utf8 header = get_response_header_utf8();
+  header[key] = value;
+  set_response_header_utf8(header);
+}
+
+si_stringmap_utf8 request_ctocpp::get_response_header_utf8()
+{
+  if (_CTOCPP_MISSING(get_response_header_utf8))
+    return si_stringmap_utf8();
+  return adopt_map<si_stringmap_utf8>(struct_->get_response_header_utf8(struct_),
+                                      _utf8stringmap_free);
+}
+
+void request_ctocpp::set_outfile_utf8(const char* file)
+{
+  if (_CTOCPP_MISSING(set_outfile_utf8))
+    return;
+  struct_->set_outfile_utf8(struct_, file);
+}
+
+std::string request_ctocpp::get_outfile_utf8()
+{
+  if (!_CTOCPP_MISSING(copy_outfile_utf8))
+    return copy_utf8(struct_, struct_->copy_outfile_utf8);
+  if (_CTOCPP_MISSING(get_outfile_utf8))
+    return "";
+  std::string outfile;
+  _utf8string_t _outfile = struct_->get_outfile_utf8(struct_);
+  if (_outfile)
+  {
+    outfile.assign(_outfile, _utf8string_length(_outfile));
+    _utf8string_free(_outfile);
+  }
+  return outfile;
+}
+
+void request_ctocpp::set_request_error(int error)
+{
+  if (_CTOCPP_MISSING(set_request_error))
+    return;
+  struct_->set_request_error(struct_, error);
+}
+
+int request_ctocpp::get_request_error()
+{
+  if (_CTOCPP_MISSING(get_request_error))
+    return REQ_ERR_NONE;
+  return struct_->get_request_error(struct_);
+}
+
+void request_ctocpp::set_retry_policy(int max_attempts, int base_delay_ms,
+                                      int max_delay_ms, int retry_errors)
+{
+  if (_CTOCPP_MISSING(set_retry_policy))
+    return;
+  struct_->set_retry_policy(struct_, max_attempts, base_delay_ms,
+    max_delay_ms, retry_errors);
+}
+
+void request_ctocpp::get_retry_policy(int& max_attempts, int& base_delay_ms,
+                                      int& max_delay_ms, int& retry_errors)
+{
+  max_attempts = 1;
+  base_delay_ms = REQ_RETRY_DEFAULT_BASE_DELAY;
+  max_delay_ms = REQ_RETRY_DEFAULT_MAX_DELAY;
+  retry_errors = REQ_RETRY_DEFAULT_ERRORS;
+  if (_CTOCPP_MISSING(get_retry_policy))
+    return;
+  struct_->get_retry_policy(struct_, &max_attempts, &base_delay_ms,
+    &max_delay_ms, &retry_errors);
+}
+
+void request_ctocpp::set_retry_status(const std::vector<int>& statuses)
+{
+  if (_CTOCPP_MISSING(set_retry_status))
+    return;
+  struct_->set_retry_status(struct_, statuses.empty() ? NULL : &statuses[0],
+    statuses.size());
+}
+
+void request_ctocpp::get_retry_status(std::vector<int>& statuses)
+{
+  statuses.clear();
+  if (_CTOCPP_MISSING(get_retry_status))
+    return;
+  _intlist_t _statuses = NULL;
+  struct_->get_retry_status(struct_, &_statuses);
+  if (_statuses)
+  {
+    size_t size = _intlist_size(_statuses);
+    if (size > 0)
+      statuses.assign(_intlist_get(_statuses), _intlist_get(_statuses) + size);
+    _intlist_free(_statuses);
+  }
+}
+
+void request_ctocpp::set_attempts(int attempts)
+{
+  if (_CTOCPP_MISSING(set_attempts))
+    return;
+  struct_->set_attempts(struct_, attempts);
+}
+
+int request_ctocpp::get_attempts()
+{
+  if (_CTOCPP_MISSING(get_attempts))
+    return 0;
+  return struct_->get_attempts(struct_);
+}
+
+void request_ctocpp::reset_response()
+{
+  if (_CTOCPP_MISSING(reset_response))
+    return;
+  struct_->reset_response(struct_);
+}
+
+void request_ctocpp::set_timeouts(int deadline_ms, int connect_ms, int first_byte_ms)
+{
+  if (_CTOCPP_MISSING(set_timeouts))
+    return;
+  struct_->set_timeouts(struct_, deadline_ms, connect_ms, first_byte_ms);
+}
+
+void request_ctocpp::get_timeouts(int& deadline_ms, int& connect_ms, int& first_byte_ms)
+{
+  deadline_ms = connect_ms = first_byte_ms = 0;
+  if (_CTOCPP_MISSING(get_timeouts))
+    return;
+  struct_->get_timeouts(struct_, &deadline_ms, &connect_ms, &first_byte_ms);
+}
+
+void request_ctocpp::set_low_speed(int limit_bytes, int time_sec)
+{
+  if (_CTOCPP_MISSING(set_low_speed))
+    return;
+  struct_->set_low_speed(struct_, limit_bytes, time_sec);
+}
+
+void request_ctocpp::get_low_speed(int& limit_bytes, int& time_sec)
+{
+  limit_bytes = time_sec = 0;
+  if (_CTOCPP_MISSING(get_low_speed))
+    return;
+  struct_->get_low_speed(struct_, &limit_bytes, &time_sec);
+}
+
+void request_ctocpp::set_hedge_policy(int percentile, int delay_ms)
+{
+  if (_CTOCPP_MISSING(set_hedge_policy))
+    return;
+  struct_->set_hedge_policy(struct_, percentile, delay_ms);
+}
+
+void request_ctocpp::get_hedge_policy(int& percentile, int& delay_ms)
+{
+  percentile = delay_ms = 0;
+  if (_CTOCPP_MISSING(get_hedge_policy))
+    return;
+  struct_->get_hedge_policy(struct_, &percentile, &delay_ms);
+}
+
+void request_ctocpp::set_mirrors(const std::vector<std::string>& urls)
+{
+  if (_CTOCPP_MISSING(set_mirrors))
+    return;
+  std::vector<const char*> _urls;
+  for (std::vector<std::string>::const_iterator it = urls.begin(); it != urls.end(); it++)
+    _urls.push_back(it->c_str());
+  struct_->set_mirrors(struct_, _urls.empty() ? NULL : &_urls[0], _urls.size());
+}
+
+void request_ctocpp::get_mirrors(std::vector<std::string>& urls)
+{
+  urls.clear();
+  if (_CTOCPP_MISSING(get_mirror_count) || _CTOCPP_MISSING(get_mirror))
+    return;
+  size_t count = struct_->get_mirror_count(struct_);
+  for (size_t i = 0; i < count; i++)
+  {
+    std::string mirror;
+    _utf8string_t _mirror = struct_->get_mirror(struct_, i);
+    if (_mirror)
+    {
+      mirror.assign(_mirror, _utf8string_length(_mirror));
+      _utf8string_free(_mirror);
+    }
+    urls.push_back(mirror);
+  }
+}
+
+void request_ctocpp::set_timing(const request_timing& timing)
+{
+  if (_CTOCPP_MISSING(set_timing))
+    return;
+  _request_timing_t _timing;
+  _timing.queued_ms = timing.queued_ms;
+  _timing.started_ms = timing.started_ms;
+  _timing.namelookup = timing.namelookup;
+  _timing.connect = timing.connect;
+  _timing.appconnect = timing.appconnect;
+  _timing.pretransfer = timing.pretransfer;
+  _timing.starttransfer = timing.starttransfer;
+  _timing.total = timing.total;
+  _timing.redirects = timing.redirects;
+  _timing.reused = timing.reused;
+  memcpy(_timing.primary_ip, timing.primary_ip, sizeof(_timing.primary_ip));
+  struct_->set_timing(struct_, &_timing, sizeof(_timing));
+}
+
+void request_ctocpp::get_timing(request_timing& timing)
+{
+  memset(&timing, 0, sizeof(timing));
+  if (_CTOCPP_MISSING(get_timing))
+    return;
+  _request_timing_t _timing;
+  memset(&_timing, 0, sizeof(_timing));
+  struct_->get_timing(struct_, &_timing, sizeof(_timing));
+  timing.queued_ms = _timing.queued_ms;
+  timing.started_ms = _timing.started_ms;
+  timing.namelookup = _timing.namelookup;
+  timing.connect = _timing.connect;
+  timing.appconnect = _timing.appconnect;
+  timing.pretransfer = _timing.pretransfer;
+  timing.starttransfer = _timing.starttransfer;
+  timing.total = _timing.total;
+  timing.redirects = _timing.redirects;
+  timing.reused = _timing.reused;
+  memcpy(timing.primary_ip, _timing.primary_ip, sizeof(timing.primary_ip));
+  timing.primary_ip[sizeof(timing.primary_ip) - 1] = 0;
+}
+
+void request_ctocpp::set_effective_url_utf8(const char* url)
+{
+  if (_CTOCPP_MISSING(set_effective_url_utf8))
+    return;
+  struct_->set_effective_url_utf8(struct_, url);
+}
+
+std::string request_ctocpp::get_effective_url_utf8()
+{
+  if (_CTOCPP_MISSING(copy_effective_url_utf8))
+    return "";
+  return copy_utf8(struct_, struct_->copy_effective_url_utf8);
+}
@@ -22,7 +22,7 @@ public:
   virtual void set_request_header(si_stringmap& header);
   virtual si_stringmap get_request_header();
 
-  virtual void set_postdata(refptr<postdata> postdata);
+  virtual void set_postdata(const refptr<postdata>& postdata);
   virtual refptr<postdata> get_postdata();
 
   virtual void set_response_header(si_stringmap& header);
@@ -30,6 +30,7 @@ public:
 
   virtual void set_response_buffer(si_buffer& buffer);
   virtual si_buffer get_response_buffer();
+  virtual refptr<shared_buffer> lease_response_buffer();
 
   virtual void set_response_size(size_t size_in);
   virtual size_t get_response_size();
@@ -49,6 +50,44 @@ public:
   virtual void close_outfile();
 
   virtual void set_appendbuffer(const void* data, size_t size);
+
+  virtual void set_request_method_utf8(const char* method);
+  virtual std::string get_request_method_utf8();
+  virtual void set_request_url_utf8(const char* url);
+  virtual std::string get_request_url_utf8();
+  virtual void set_request_url(const url& request_url);
+  virtual void get_request_url(url& request_url);
+  virtual void set_request_header_utf8(si_stringmap_utf8& header);
+  virtual si_stringmap_utf8 get_request_header_utf8();
+  virtual void set_response_header_utf8(si_stringmap_utf8& header);
+  virtual si_stringmap_utf8 get_response_header_utf8();
+  virtual void add_response_header_utf8(const std::string& key,
+                                        const std::string& value);
+  virtual void set_outfile_utf8(const char* file);
+  virtual std::string get_outfile_utf8();
+  virtual void set_request_error(int error);
+  virtual int get_request_error();
+  virtual void set_retry_policy(int max_attempts, int base_delay_ms,
+                                int max_delay_ms, int retry_errors);
+  virtual void get_retry_policy(int& max_attempts, int& base_delay_ms,
+                                int& max_delay_ms, int& retry_errors);
+  virtual void set_retry_status(const std::vector<int>& statuses);
+  virtual void get_retry_status(std::vector<int>& statuses);
+  virtual void set_attempts(int attempts);
+  virtual int get_attempts();
+  virtual void reset_response();
+  virtual void set_timeouts(int deadline_ms, int connect_ms, int first_byte_ms);
+  virtual void get_timeouts(int& deadline_ms, int& connect_ms, int& first_byte_ms);
+  virtual void set_low_speed(int limit_bytes, int time_sec);
+  virtual void get_low_speed(int& limit_bytes, int& time_sec);
+  virtual void set_hedge_policy(int percentile, int delay_ms);
+  virtual void get_hedge_policy(int& percentile, int& delay_ms);
+  virtual void set_mirrors(const std::vector<std::string>& urls);
+  virtual void get_mirrors(std::vector<std::string>& urls);
+  virtual void set_timing(const request_timing& timing);
+  virtual void get_timing(request_timing& timing);
+  virtual void set_effective_url_utf8(const char* url);
+  virtual std::string get_effective_url_utf8();
 };
 
 #endif // REQUEST_CTOCPP_H
\ No newline at end of file
@@ -13,37 +13,37 @@ refptr<task> task::create_instance()
   return NULL;
 }
 
-void task_ctocpp::append_request(refptr<request> request_in)
+void task_ctocpp::append_request(const refptr<request>& request_in)
 {
-  if (_MEMBER_MISSING(struct_, append_request))
+  if (_CTOCPP_MISSING(append_request))
     return;
   struct_->append_request(struct_, request_ctocpp::Unwrap(request_in));
 }
 
 int task_ctocpp::erase_request(int request_id)
 {
-  if (_MEMBER_MISSING(struct_, erase_request))
+  if (_CTOCPP_MISSING(erase_request))
     return 0;
   return struct_->erase_request(struct_, request_id);
 }
 
 void task_ctocpp::clearall_requests()
 {
-  if (_MEMBER_MISSING(struct_, clearall_requests))
+  if (_CTOCPP_MISSING(clearall_requests))
     return;
   struct_->clearall_requests(struct_);
 }
 
 int task_ctocpp::get_request_count()
 {
-  if (_MEMBER_MISSING(struct_, get_request_count))
+  if (_CTOCPP_MISSING(get_request_count))
     return 0;
   return struct_->get_request_count(struct_);
 }
 
 void task_ctocpp::get_request_ids(std::vector<int>& ids_out)
 {
-  if (_MEMBER_MISSING(struct_, get_request_ids))
+  if (_CTOCPP_MISSING(get_request_ids))
     return;
   _intlist_t _ids_out;
   struct_->get_request_ids(struct_, &_ids_out);
@@ -58,56 +58,81 @@ void task_ctocpp::get_request_ids(std::vector<int>& ids_out)
 
 refptr<request> task_ctocpp::get_request(int request_id)
 {
-  if (_MEMBER_MISSING(struct_, get_request))
+  if (_CTOCPP_MISSING(get_request))
     return NULL;
   return request_ctocpp::Wrap(struct_->get_request(struct_, request_id));
 }
 
 void task_ctocpp::set_status(int status)
 {
-  if (_MEMBER_MISSING(struct_, set_status))
+  if (_CTOCPP_MISSING(set_status))
     return;
   struct_->set_status(struct_, status);
 }
 
 int task_ctocpp::get_status()
 {
-  if (_MEMBER_MISSING(struct_, get_status))
+  if (_CTOCPP_MISSING(get_status))
     return 0;
   return struct_->get_status(struct_);
 }
 
 void task_ctocpp::attach_observer(itask_observer* observer_in)
 {
-  if (_MEMBER_MISSING(struct_, attach_observer))
+  if (_CTOCPP_MISSING(attach_observer))
     return;
   struct_->attach_observer(struct_, observer_in);
 }
 
 void task_ctocpp::detach_observer()
 {
-  if (_MEMBER_MISSING(struct_, detach_observer))
+  if (_CTOCPP_MISSING(detach_observer))
     return;
   struct_->detach_observer(struct_);
 }
 
 itask_observer* task_ctocpp::get_observer()
 {
-  if (_MEMBER_MISSING(struct_, get_observer))
+  if (_CTOCPP_MISSING(get_observer))
     return NULL;
   return struct_->get_observer(struct_);
 }
 
-void task_ctocpp::use_config(refptr<config> config)
+void task_ctocpp::set_callbacks(const task_callbacks& callbacks)
 {
-  if (_MEMBER_MISSING(struct_, use_config))
+  if (_CTOCPP_MISSING(set_callbacks))
+    return;
+  _task_callbacks_t callbacks_in;
+  callbacks_in.on_status = callbacks.on_status;
+  callbacks_in.on_progress = callbacks.on_progress;
+  callbacks_in.on_data = callbacks.on_data;
+  callbacks_in.user = callbacks.user;
+  struct_->set_callbacks(struct_, &callbacks_in);
+}
+
+void task_ctocpp::get_callbacks(task_callbacks& callbacks)
+{
+  memset(&callbacks, 0, sizeof(callbacks));
+  if (_CTOCPP_MISSING(get_callbacks))
+    return;
+  _task_callbacks_t callbacks_out;
+  struct_->get_callbacks(struct_, &callbacks_out);
+  callbacks.on_status = callbacks_out.on_status;
+  callbacks.on_progress = callbacks_out.on_progress;
+  callbacks.on_data = callbacks_out.on_data;
+  callbacks.user = callbacks_out.user;
+}
+
+void task_ctocpp::use_config(const refptr<config>& config)
+{
+  if (_CTOCPP_MISSING(use_config))
     return;
   struct_->use_config(struct_, config_ctocpp::Unwrap(config));
 }
 
 refptr<config> task_ctocpp::get_config()
 {
-  if (_MEMBER_MISSING(struct_, get_config))
+  if (_CTOCPP_MISSING(get_config))
     return NULL;
   return config_ctocpp::Wrap(struct_->get_config(struct_));
 }
\ No newline at end of file
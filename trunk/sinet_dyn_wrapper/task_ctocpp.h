@@ -13,7 +13,7 @@ public:
     : ctocpp<task_ctocpp, task, _task_t>(tsk) {}
   virtual ~task_ctocpp() {}
 
-  virtual void append_request(refptr<request> request_in);
+  virtual void append_request(const refptr<request>& request_in);
   virtual int erase_request(int request_id);
   virtual void clearall_requests();
   virtual int get_request_count();
@@ -26,8 +26,10 @@ public:
   virtual void attach_observer(itask_observer* observer_in);
   virtual void detach_observer();
   virtual itask_observer* get_observer();
+  virtual void set_callbacks(const task_callbacks& callbacks);
+  virtual void get_callbacks(task_callbacks& callbacks);
 
-  virtual void use_config(refptr<config> config);
+  virtual void use_config(const refptr<config>& config);
   virtual refptr<config> get_config();
 };
 
@@ -18,6 +18,7 @@
 #endif // WIN32
 #ifdef __linux__
 #include <pthread.h>
+#include <unistd.h>
 #include <time.h>
 #include <errno.h>
 #include <string.h>
@@ -3,8 +3,16 @@
 #include "pch.h"
 #include "../../sinet/sinet.h"
 #include "../../sinet/pool_impl.h"
+#include "../../sinet/strings.h"
+#include "../../sinet/urls.h"
+#include "../../sinet/object_pool.h"
+#include "../../sinet/config_impl.h"
+#include "../../sinet/task_impl.h"
+#include "../../sinet/postdata_impl.h"
+#include "../../sinet/postdataelem_impl.h"
 #include <time.h>
 #include <fstream>
+#include <algorithm>
 
 #include <string>
 #include <cwchar>
@@ -17,12 +25,16 @@ using namespace sinet;
 
 #if defined(_WINDOWS_)
 #include <Shlwapi.h>
+#include <process.h>
 #define CLOCKS_PER_SECOND CLOCKS_PER_SEC
 #define _SLEEP(secs) ::Sleep(secs*1000);
+#define _MSLEEP(ms) ::Sleep(ms);
 
 #elif defined(_MAC_) || defined(__linux__)
 #define CLOCKS_PER_SECOND 10000
+#include <sys/time.h>
 #define _SLEEP(secs) sleep(secs);
+#define _MSLEEP(ms) usleep((ms)*1000);
 
 #endif
 
@@ -129,6 +141,1145 @@ void testcase_poolcreation()
   //_SLEEP(20);
 }
 
+// @returns 1 if |in| decodes to |expected| and is_valid_utf8 agrees
+// with |valid|
+static int strings_decodes_to(const std::string& in, const std::wstring& expected, int valid)
+{
+  std::wstring out;
+  strings::utf8_to_wide(in.data(), in.size(), out);
+  return (out == expected) && (strings::is_valid_utf8(in.data(), in.size()) == valid);
+}
+
+// @returns 1 if |in| encodes to |expected|
+static int strings_encodes_to(const std::wstring& in, const std::string& expected)
+{
+  std::string out;
+  strings::wide_to_utf8(in.data(), in.size(), out);
+  return out == expected;
+}
+
+// @returns |cp| as wchar_t, a surrogate pair where wchar_t is UTF-16
+static std::wstring strings_wide(unsigned int cp)
+{
+  std::wstring wide;
+  if (sizeof(wchar_t) == 2 && cp > 0xFFFF)
+  {
+    wide.push_back((wchar_t)(0xD800 + ((cp - 0x10000) >> 10)));
+    wide.push_back((wchar_t)(0xDC00 + ((cp - 0x10000) & 0x3FF)));
+  }
+  else
+    wide.push_back((wchar_t)cp);
+  return wide;
+}
+
+/*
+  Benchmark UTF-8 <-> wchar_t conversion
+
+  test case:
+    1. convert a typical request url (ASCII with a short CJK query)
+       and a long ASCII header back and forth many times, with
+       sinet::strings and with the utf8_wchar templates from pch.h
+    2. decode 4-byte sequences, UTF-8 encoded surrogates, overlong
+       forms, truncated sequences and values above U+10FFFF
+    3. encode lone and paired surrogates and values above U+10FFFF
+    4. decode and encode ASCII runs of 1 to 80 chars that end in, or
+       have at one position, a non-ASCII char, crossing the 16 and 32
+       byte blocks of the SSE2 and AVX2 paths
+
+  validate:
+    the round trip returns the original strings, each ill-formed
+    sequence turns into U+FFFD per maximal subpart and is reported
+    invalid, well-formed ones decode to their code points
+ */
+void testcase_strings()
+{
+  TEST_ENTER(L"testcase_strings");
+
+  std::wstring url = L"http://webpj.com:8080/misc/test_sinet.php?act=str&p=\x4E2D\x6587\x5B57\x7B26";
+  std::wstring header(1024, L'x');
+  int num_loops = 100000;
+  int roundtrip_ok = 1;
+
+  wprintf(L"start timing for %d conversions ...\n", num_loops);
+  size_t clock_begin = clock();
+  for (int i = 0; i < num_loops; i++)
+  {
+    std::string url_utf8 = strings::wstring_utf8string(url);
+    std::string header_utf8 = strings::wstring_utf8string(header);
+    if (strings::utf8string_wstring(url_utf8) != url ||
+        strings::utf8string_wstring(header_utf8) != header)
+      roundtrip_ok = 0;
+  }
+  size_t clock_strings = clock() - clock_begin;
+
+  clock_begin = clock();
+  for (int i = 0; i < num_loops; i++)
+  {
+    std::string url_utf8 = wchar_utf8(url);
+    std::string header_utf8 = wchar_utf8(header);
+    utf8_wchar(url_utf8);
+    utf8_wchar(header_utf8);
+  }
+  size_t clock_templates = clock() - clock_begin;
+
+  wprintf(L"%d round trips took %d ms (pch.h templates: %d ms)\n", num_loops,
+    (int)(clock_strings * 1000 / CLOCKS_PER_SEC),
+    (int)(clock_templates * 1000 / CLOCKS_PER_SEC));
+  // U+1F600 and U+10FFFF take 4 bytes
+  int valid_ok = strings_decodes_to("\xF0\x9F\x98\x80", strings_wide(0x1F600), 1) &&
+    strings_decodes_to("\xF4\x8F\xBF\xBF", strings_wide(0x10FFFF), 1) &&
+    strings_encodes_to(strings_wide(0x1F600), "\xF0\x9F\x98\x80") &&
+    // U+D800 and U+DFFF encoded as UTF-8
+    strings_decodes_to("\xED\xA0\x80", L"\xFFFD\xFFFD\xFFFD", 0) &&
+    strings_decodes_to("a\xED\xBF\xBF", L"a\xFFFD\xFFFD\xFFFD", 0) &&
+    strings_decodes_to("\xED\x9F\xBF", L"\xD7FF", 1) &&
+    // overlong forms of '/' and U+07FF, U+FFFF
+    strings_decodes_to("\xC0\xAF", L"\xFFFD\xFFFD", 0) &&
+    strings_decodes_to("\xE0\x9F\xBF", L"\xFFFD\xFFFD\xFFFD", 0) &&
+    strings_decodes_to("\xF0\x8F\xBF\xBF", L"\xFFFD\xFFFD\xFFFD\xFFFD", 0) &&
+    // truncated sequences lose only their own bytes
+    strings_decodes_to("\xE4\xB8", L"\xFFFD", 0) &&
+    strings_decodes_to("\xF0\x9F\x98" "a", L"\xFFFD" L"a", 0) &&
+    strings_decodes_to("\xC3", L"\xFFFD", 0) &&
+    strings_decodes_to("\x80" "a", L"\xFFFD" L"a", 0) &&
+    // above U+10FFFF
+    strings_decodes_to("\xF4\x90\x80\x80", L"\xFFFD\xFFFD\xFFFD\xFFFD", 0) &&
+    strings_decodes_to("\xF5\x80\x80\x80", L"\xFFFD\xFFFD\xFFFD\xFFFD", 0) &&
+    strings_decodes_to("\xFF", L"\xFFFD", 0);
+
+  // lone surrogates become U+FFFD. A pair is one code point where
+  // wchar_t is UTF-16, two lone surrogates where it is UTF-32.
+  std::wstring lone(1, (wchar_t)0xD800);
+  lone += L"a";
+  lone.push_back((wchar_t)0xDC00);
+  std::wstring pair;
+  pair.push_back((wchar_t)0xD83D);
+  pair.push_back((wchar_t)0xDE00);
+  valid_ok = valid_ok && strings_encodes_to(lone, "\xEF\xBF\xBD" "a" "\xEF\xBF\xBD") &&
+    strings_encodes_to(pair, sizeof(wchar_t) == 2 ? "\xF0\x9F\x98\x80" :
+                                                    "\xEF\xBF\xBD\xEF\xBF\xBD");
+#if WCHAR_MAX > 0xFFFF
+  valid_ok = valid_ok && strings_encodes_to(std::wstring(1, (wchar_t)0x110000), "\xEF\xBF\xBD");
+#endif
+
+  for (size_t len = 1; len <= 80; len++)
+  {
+    // a 2-byte char after the run
+    std::string run_utf8(len, 'a');
+    std::wstring run(len, L'a');
+    valid_ok = valid_ok && strings_decodes_to(run_utf8 + "\xC3\xA9", run + L"\xE9", 1) &&
+      strings_encodes_to(run + L"\xE9", run_utf8 + "\xC3\xA9");
+    // a stray continuation byte and a CJK char at position |len| - 1
+    run_utf8[len - 1] = '\x80';
+    run[len - 1] = 0xFFFD;
+    valid_ok = valid_ok && strings_decodes_to(run_utf8, run, 0);
+    run[len - 1] = 0x4E2D;
+    valid_ok = valid_ok && strings_encodes_to(run, std::string(len - 1, 'a') + "\xE4\xB8\xAD");
+  }
+
+  TEST_RESULT(L"testcase_strings", roundtrip_ok == 1, roundtrip_ok);
+  TEST_RESULT(L"testcase_strings", valid_ok == 1, valid_ok);
+}
+
+/*
+  Test url encoding
+
+  test case:
+    1. build a query string from a map holding reserved and CJK chars
+    2. decode each encoded value back
+    3. parse, normalize and extend a url
+
+  validate:
+    the query matches the expected string and values round trip,
+    the url components, spec and origin key are as expected
+ */
+void testcase_urls()
+{
+  TEST_ENTER(L"testcase_urls");
+
+  si_stringmap params;
+  params[L"act"] = L"a b&c";
+  params[L"p"] = L"\x4E2D-_.~";
+  std::wstring query = urls::build_query(params);
+  int urls_ok = (query == L"act=a%20b%26c&p=%E4%B8%AD-_.~") &&
+    (urls::decode(urls::encode(params[L"act"])) == params[L"act"]) &&
+    (urls::decode(urls::encode(params[L"p"])) == params[L"p"]);
+
+  url request_url("HTTP://WebPJ.com:80/misc/./x/../test_sinet.php?act=url");
+  urls_ok = urls_ok && request_url.is_valid() &&
+    (request_url.get_origin() == "http://webpj.com:80");
+  request_url.normalize();
+  request_url.append_query("p", "a b");
+  urls_ok = urls_ok &&
+    (request_url.get_spec() == "http://webpj.com/misc/test_sinet.php?act=url&p=a%20b");
+
+  TEST_RESULT(L"testcase_urls", urls_ok == 1, urls_ok);
+}
+
+/*
+  Test leasing the response buffer
+
+  test case:
+    1. fill a response buffer and lease it
+    2. append more data, then reset the response
+
+  validate:
+    the lease keeps the bytes it was given, the request sees the new data
+ */
+void testcase_bufferlease()
+{
+  TEST_ENTER(L"testcase_bufferlease");
+
+  refptr<request> req = request::create_instance();
+  req->set_appendbuffer("lease", 5);
+  refptr<shared_buffer> lease = req->lease_response_buffer();
+  req->set_appendbuffer("d", 1);
+  int lease_ok = (lease->get_size() == 5) &&
+    (memcmp(lease->get_data(), "lease", 5) == 0) &&
+    (req->get_response_buffer().size() == 6);
+  req->reset_response();
+  lease_ok = lease_ok && (lease->get_size() == 5) &&
+    req->get_response_buffer().empty();
+
+  TEST_RESULT(L"testcase_bufferlease", lease_ok == 1, lease_ok);
+}
+
+/*
+  Test task callbacks
+
+  test case:
+    1. set callbacks on a task, execute and cancel it at once
+
+  validate:
+    the callbacks see the task queued first and then canceled, the
+    pool has an event to wait on
+ */
+static int callbacks_statuses[8];
+static int callbacks_count = 0;
+static int callbacks_canceled = 0;
+static void SINET_CALLBACK testcase_taskcallbacks_status(void* user, int status)
+{
+  if (callbacks_count < 8)
+    callbacks_statuses[callbacks_count++] = status;
+  if (status == taskstatus_canceled)
+    callbacks_canceled = 1;
+}
+void testcase_taskcallbacks()
+{
+  TEST_ENTER(L"testcase_taskcallbacks");
+
+  refptr<pool> pool = pool::create_instance();
+  refptr<task> task = task::create_instance();
+  refptr<request> req = request::create_instance();
+  req->set_request_url(L"http://127.0.0.1:1/");
+  task->append_request(req);
+  task_callbacks callbacks;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.on_status = testcase_taskcallbacks_status;
+  task->set_callbacks(callbacks);
+  pool->execute(task);
+  pool->cancel(task);
+  int callbacks_ok = (callbacks_count >= 2) &&
+    (callbacks_statuses[0] == taskstatus_queued) && callbacks_canceled &&
+    (task->get_status() == taskstatus_canceled) &&
+    (pool->get_event_fd() != -1);
+
+  TEST_RESULT(L"testcase_taskcallbacks", callbacks_ok == 1, callbacks_ok);
+}
+
+/*
+  Test pool statistics
+
+  test case:
+    1. record 1 to 1000 in a histogram
+    2. execute a task and cancel it at once
+
+  validate:
+    percentiles are within a bucket of the value, the pool counts the
+    task executed and canceled with nothing left queued or running
+ */
+void testcase_poolstats()
+{
+  TEST_ENTER(L"testcase_poolstats");
+
+  latency_histogram histogram;
+  memset(&histogram, 0, sizeof(histogram));
+  for (int i = 1; i <= 1000; i++)
+    histogram_record(histogram, i);
+  long long p50 = histogram_percentile(histogram, 50);
+  long long p99 = histogram_percentile(histogram, 99);
+
+  refptr<pool> pool = pool::create_instance();
+  refptr<task> task = task::create_instance();
+  refptr<request> req = request::create_instance();
+  req->set_request_url(L"http://127.0.0.1:1/");
+  task->append_request(req);
+  pool->execute(task);
+  pool->cancel(task);
+  // counters are published after each pass of the pool thread
+  _SLEEP(1);
+  pool_stats stats;
+  pool->get_stats(stats);
+  int stats_ok = (histogram.count == 1000) && (histogram.max == 1000) &&
+    (p50 >= 470 && p50 <= 530) && (p99 >= 960 && p99 <= 1000) &&
+    (stats.tasks_executed == 1) && (stats.tasks_canceled == 1) &&
+    (stats.tasks_queued == 0) && (stats.tasks_running == 0);
+
+  TEST_RESULT(L"testcase_poolstats", stats_ok == 1, stats_ok);
+}
+
+/*
+  Test trace dump
+
+  test case:
+    1. dump the trace rings
+
+  validate:
+    the dump is a Chrome trace JSON object, with events only when
+    built with SINET_ENABLE_TRACE
+ */
+void testcase_tracedump()
+{
+  TEST_ENTER(L"testcase_tracedump");
+
+  SINET_TRACE_INSTANT("testcase_tracedump");
+  std::string json;
+  trace_dump(json);
+  int dump_ok = (json.find("{\"traceEvents\":[") == 0) &&
+    (json.find("]}") != std::string::npos);
+#ifdef SINET_ENABLE_TRACE
+  dump_ok = dump_ok && (json.find("\"testcase_tracedump\"") != std::string::npos);
+#endif
+
+  TEST_RESULT(L"testcase_tracedump", dump_ok == 1, dump_ok);
+}
+
+/*
+  Test retry backoff
+
+  test case:
+    1. ask for the delay after each failed attempt of a request allowed
+       5 attempts, 100 ms base and 1000 ms max delay, with many seeds
+    2. ask with an error and a status the policy does not retry
+
+  validate:
+    the n-th delay is between half and all of min(100 * 2^(n-1), 1000)
+    and spreads over that range, there is no retry after the 5th attempt
+    nor for the error and status outside the policy
+ */
+void testcase_retrydelay()
+{
+  TEST_ENTER(L"testcase_retrydelay");
+
+  refptr<request> req = request::create_instance();
+  req->set_retry_policy(5, 100, 1000, REQ_RETRY_DEFAULT_ERRORS);
+  unsigned int seed = 1;
+  int retry_ok = 1;
+  for (int attempts = 1; attempts < 5; attempts++)
+  {
+    int backoff = 100 << (attempts - 1);
+    if (backoff > 1000)
+      backoff = 1000;
+    int shortest = backoff, longest = 0;
+    for (int i = 0; i < 200; i++)
+    {
+      int delay = pool_impl::_retry_delay(req, attempts, REQ_ERR_CONNECT, 0, seed);
+      shortest = delay < shortest ? delay : shortest;
+      longest = delay > longest ? delay : longest;
+    }
+    retry_ok = retry_ok && (shortest >= backoff / 2) && (longest <= backoff) &&
+      (shortest < backoff * 5 / 8) && (longest > backoff * 7 / 8);
+  }
+  retry_ok = retry_ok &&
+    (pool_impl::_retry_delay(req, 5, REQ_ERR_CONNECT, 0, seed) == -1) &&
+    (pool_impl::_retry_delay(req, 1, REQ_ERR_SSL, 0, seed) == -1) &&
+    (pool_impl::_retry_delay(req, 1, REQ_ERR_NONE, 404, seed) == -1) &&
+    (pool_impl::_retry_delay(req, 1, REQ_ERR_NONE, 503, seed) >= 50);
+
+  TEST_RESULT(L"testcase_retrydelay", retry_ok == 1, retry_ok);
+}
+
+/*
+  Test token buckets
+
+  test case:
+    1. consume from a bucket of 10 tokens per second and refill it
+       with a clock that is passed in
+    2. refill after a long pause, overdraw, lower the rate
+
+  validate:
+    the bucket starts full, earns 10 tokens per second, never holds
+    more than one second worth of tokens, pays an overdraft back
+    first, a bucket without a rate has no limit
+ */
+void testcase_tokenbucket()
+{
+  TEST_ENTER(L"testcase_tokenbucket");
+
+  token_bucket unlimited;
+  unlimited.consume(1000);
+  int bucket_ok = !unlimited.is_limited() && unlimited.available(1e9);
+
+  token_bucket bucket;
+  bucket.set_rate(10, 0);
+  bucket_ok = bucket_ok && bucket.is_limited() && bucket.available(10) &&
+    !bucket.available(11);
+  bucket.consume(10);
+  bucket_ok = bucket_ok && !bucket.available(1);
+  bucket.refill(100);
+  bucket_ok = bucket_ok && bucket.available(1) && !bucket.available(2);
+  // a clock going back earns nothing
+  bucket.refill(50);
+  bucket_ok = bucket_ok && !bucket.available(2);
+  // the burst is capped at one second worth
+  bucket.refill(5000);
+  bucket_ok = bucket_ok && bucket.available(10) && !bucket.available(10.5);
+  bucket.consume(15);
+  bucket.refill(6000);
+  bucket_ok = bucket_ok && bucket.available(5) && !bucket.available(6);
+  bucket.set_rate(4, 6000);
+  bucket_ok = bucket_ok && (bucket.get_rate() == 4) && bucket.available(4) &&
+    !bucket.available(4.5);
+
+  TEST_RESULT(L"testcase_tokenbucket", bucket_ok == 1, bucket_ok);
+}
+
+/*
+  Test http cache
+
+  test case:
+    1. parse the same date in RFC 1123, RFC 850 and asctime form, and
+       some invalid ones
+    2. work out the lifetime of responses with max-age, Expires, Age,
+       no-cache and no-store
+    3. collect and match Vary headers
+    4. store 3 responses of 100 bytes in a cache of 250 bytes, using
+       the first one in between
+
+  validate:
+    the 3 forms give the same time and invalid dates are refused,
+    max-age wins over Expires and Age is taken off, no-cache makes a
+    response stale and no-store keeps it out, Vary: * is refused and a
+    different header value does not match, the least recently used
+    response is evicted
+ */
+void testcase_httpcache()
+{
+  TEST_ENTER(L"testcase_httpcache");
+
+  long long now = 784111777, seconds = 0;
+  int cache_ok = http_cache::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", seconds) &&
+    (seconds == now);
+  seconds = 0;
+  cache_ok = cache_ok && http_cache::parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", seconds) &&
+    (seconds == now);
+  seconds = 0;
+  cache_ok = cache_ok && http_cache::parse_http_date("Sun Nov  6 08:49:37 1994", seconds) &&
+    (seconds == now);
+  cache_ok = cache_ok && !http_cache::parse_http_date("", seconds) &&
+    !http_cache::parse_http_date("not a date", seconds) &&
+    !http_cache::parse_http_date("Sun, 32 Nov 1994 08:49:37 GMT", seconds) &&
+    !http_cache::parse_http_date("Sun, 06 Nov 1994 24:49:37 GMT", seconds) &&
+    !http_cache::parse_http_date("Sun, 06 Nov 1994 GMT", seconds);
+
+  si_stringmap_utf8 request_header, response_header;
+  long long lifetime = -1;
+  response_header["Date"] = "Sun, 06 Nov 1994 08:49:37 GMT";
+  response_header["Expires"] = "Sun, 06 Nov 1994 09:49:37 GMT";
+  cache_ok = cache_ok && http_cache::get_lifetime(request_header, response_header, now, lifetime) &&
+    (lifetime == 3600);
+  response_header["Cache-Control"] = "public, max-age=60";
+  cache_ok = cache_ok && http_cache::get_lifetime(request_header, response_header, now, lifetime) &&
+    (lifetime == 60);
+  response_header["Age"] = "20";
+  cache_ok = cache_ok && http_cache::get_lifetime(request_header, response_header, now, lifetime) &&
+    (lifetime == 40);
+  response_header["Cache-Control"] = "no-cache, max-age=60";
+  cache_ok = cache_ok && http_cache::get_lifetime(request_header, response_header, now, lifetime) &&
+    (lifetime == 0);
+  response_header["Cache-Control"] = "max-age=60";
+  request_header["Cache-Control"] = "no-cache";
+  cache_ok = cache_ok && http_cache::get_lifetime(request_header, response_header, now, lifetime) &&
+    (lifetime == 0);
+  request_header["Cache-Control"] = "no-store";
+  cache_ok = cache_ok && !http_cache::get_lifetime(request_header, response_header, now, lifetime);
+  request_header.clear();
+  response_header["Cache-Control"] = "no-store, max-age=60";
+  cache_ok = cache_ok && !http_cache::get_lifetime(request_header, response_header, now, lifetime);
+
+  si_stringmap_utf8 vary, gzip_header, br_header;
+  gzip_header["Accept-Encoding"] = "gzip";
+  br_header["accept-encoding"] = "br";
+  response_header.clear();
+  cache_ok = cache_ok && http_cache::get_vary(gzip_header, response_header, vary) &&
+    vary.empty() && http_cache::vary_matches(vary, br_header);
+  response_header["Vary"] = "Accept-Encoding";
+  cache_ok = cache_ok && http_cache::get_vary(gzip_header, response_header, vary) &&
+    (vary.size() == 1) && (vary["accept-encoding"] == "gzip") &&
+    http_cache::vary_matches(vary, gzip_header) &&
+    !http_cache::vary_matches(vary, br_header) &&
+    !http_cache::vary_matches(vary, request_header);
+  response_header["Vary"] = "Accept-Language, *";
+  cache_ok = cache_ok && !http_cache::get_vary(gzip_header, response_header, vary);
+
+  // each entry is 10 bytes of url, 23 of headers and 67 of body
+  http_cache cache;
+  cache.set_capacity(250);
+  response_header.clear();
+  response_header["Cache-Control"] = "max-age=60";
+  si_buffer body(67, 'x');
+  cache.store("http://a/1", request_header, 200, response_header, body, now);
+  cache.store("http://a/2", request_header, 200, response_header, body, now);
+  cache_ok = cache_ok && cache.lookup("http://a/1", request_header, now);
+  cache.store("http://a/3", request_header, 200, response_header, body, now);
+  // not 200, and larger than the cache
+  cache.store("http://a/4", request_header, 404, response_header, body, now);
+  cache.store("http://a/5", request_header, 200, response_header, si_buffer(300, 'x'), now);
+  cache_stats stats;
+  cache.get_stats(stats);
+  cache_ok = cache_ok && (stats.entries == 2) && (stats.bytes == 200) &&
+    (stats.evictions == 1) && (stats.stores == 3) &&
+    !cache.lookup("http://a/2", request_header, now) &&
+    cache.lookup("http://a/1", request_header, now) &&
+    cache.lookup("http://a/3", request_header, now) &&
+    !cache.lookup("http://a/4", request_header, now) &&
+    !cache.lookup("http://a/1", request_header, now + 60);
+
+  TEST_RESULT(L"testcase_httpcache", cache_ok == 1, cache_ok);
+}
+
+/*
+  Test disk cache
+
+  test case:
+    1. store 3 responses in a new directory, two with the same body,
+       and a stale one with Last-Modified
+    2. close and open the directory again
+    3. refresh the stale one as a 304 would
+    4. shrink the cache to a byte
+
+  validate:
+    the entries and bodies come back from the index, the shared body
+    is counted once, the validators carry the ETag and Last-Modified,
+    a stale response without them is not kept, the 304 headers and
+    lifetime replace the stored ones but not the body, nothing is left
+    once the cache is shrunk
+ */
+static std::string testcase_diskcache_dir()
+{
+#if defined(_WINDOWS_)
+  char temp[MAX_PATH];
+  ::GetTempPathA(MAX_PATH, temp);
+  char dir[MAX_PATH + 32];
+  sprintf(dir, "%ssinet_test_%lu", temp, (unsigned long)::GetTickCount());
+  return dir;
+#elif defined(_MAC_) || defined(__linux__)
+  char dir[] = "/tmp/sinet_test_XXXXXX";
+  return mkdtemp(dir) ? dir : "";
+#endif
+}
+void testcase_diskcache()
+{
+  TEST_ENTER(L"testcase_diskcache");
+
+  long long now = 784111777;
+  std::string dir = testcase_diskcache_dir();
+  disk_cache cache;
+  int disk_ok = cache.open(dir);
+  cache.set_capacity(1 << 20);
+
+  si_stringmap_utf8 request_header, response_header, stale_header;
+  response_header["Cache-Control"] = "max-age=60";
+  response_header["ETag"] = "\"v1\"";
+  stale_header["Cache-Control"] = "max-age=0";
+  si_buffer body(1000, 'a'), other(500, 'b');
+  cache.store("http://a/1", request_header, response_header, &body, "", now);
+  cache.store("http://a/2", request_header, response_header, &body, "", now);
+  cache.store("http://a/3", request_header, response_header, &other, "", now);
+  // stale and nothing to revalidate with
+  cache.store("http://a/4", request_header, stale_header, &body, "", now);
+  stale_header["Last-Modified"] = "Sun, 06 Nov 1994 08:49:37 GMT";
+  cache.store("http://a/5", request_header, stale_header, &body, "", now);
+
+  cache.open("");
+  disk_ok = disk_ok && cache.open(dir);
+  long long entries = 0, bytes = 0;
+  cache.get_stats(entries, bytes);
+  disk_ok = disk_ok && (entries == 4) && (bytes == 1500);
+
+  disk_cache::entry cached;
+  std::vector<std::string> validators;
+  refptr<request> req = request::create_instance();
+  disk_ok = disk_ok && cache.lookup("http://a/1", request_header, cached) &&
+    (cached.body_size == 1000) && (cached.expires == now + 60) &&
+    disk_cache::read_body(cached, req) && (req->get_response_buffer() == body) &&
+    disk_cache::get_validators(cached, validators) && (validators.size() == 1) &&
+    (validators[0] == "If-None-Match: \"v1\"");
+  disk_ok = disk_ok && cache.lookup("http://a/3", request_header, cached) &&
+    (cached.body_size == 500) && !cache.lookup("http://a/4", request_header, cached);
+  disk_ok = disk_ok && cache.lookup("http://a/5", request_header, cached) &&
+    (cached.expires == now) && disk_cache::get_validators(cached, validators) &&
+    (validators.size() == 1) &&
+    (validators[0] == "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT");
+
+  si_stringmap_utf8 not_modified;
+  not_modified["Cache-Control"] = "max-age=120";
+  not_modified["Content-Length"] = "0";
+  disk_ok = disk_ok &&
+    cache.refresh("http://a/5", request_header, not_modified, now + 100, cached) &&
+    (cached.expires == now + 220) && (cached.body_size == 1000) &&
+    (cached.header["Cache-Control"] == "max-age=120") &&
+    (cached.header.find("Content-Length") == cached.header.end()) &&
+    (cached.header["Last-Modified"] == stale_header["Last-Modified"]) &&
+    cache.lookup("http://a/5", request_header, cached) && (cached.expires == now + 220) &&
+    !cache.refresh("http://a/6", request_header, not_modified, now, cached);
+
+  cache.set_capacity(1);
+  cache.get_stats(entries, bytes);
+  disk_ok = disk_ok && (entries == 0) && (bytes == 0);
+  cache.open("");
+  remove((dir + "/index").c_str());
+#if defined(_WINDOWS_)
+  ::RemoveDirectoryA(dir.c_str());
+#else
+  remove(dir.c_str());
+#endif
+
+  TEST_RESULT(L"testcase_diskcache", disk_ok == 1, disk_ok);
+}
+
+/*
+  Test object pool
+
+  test case:
+    1. create, delete and create again objects of a class pooled 4 to
+       a slab
+    2. create an object of a larger class derived from it
+    3. allocate and release 128 blocks on another thread, then allocate
+       128 once the thread exited
+
+  validate:
+    deleted objects are handed out again, the derived object comes
+    from the heap and not from the pool, the blocks the thread cached
+    are used again after it exited
+ */
+class objectpool_item
+{
+public:
+  SINET_POOLED_NEW(objectpool_item)
+  double values[3];
+};
+class objectpool_derived:
+  public objectpool_item
+{
+public:
+  double more_values[8];
+};
+SINET_POOLED_NEW_IMPL(objectpool_item, 4)
+
+static std::vector<void*> objectpool_blocks;
+#if defined(_WINDOWS_)
+static unsigned __stdcall testcase_objectpool_thread(void* param)
+#elif defined(_MAC_) || defined(__linux__)
+static void* testcase_objectpool_thread(void* param)
+#endif
+{
+  object_pool* pool = (object_pool*)param;
+  for (int i = 0; i < 128; i++)
+    objectpool_blocks.push_back(pool->allocate(24));
+  for (int i = 0; i < 128; i++)
+    pool->deallocate(objectpool_blocks[i], 24);
+  return 0;
+}
+void testcase_objectpool()
+{
+  TEST_ENTER(L"testcase_objectpool");
+
+  objectpool_item* item = new objectpool_item;
+  delete item;
+  objectpool_item* again = new objectpool_item;
+  int pool_ok = (again == item);
+  delete again;
+
+  std::vector<objectpool_item*> items, items_again;
+  for (int i = 0; i < 10; i++)
+    items.push_back(new objectpool_item);
+  for (int i = 0; i < 10; i++)
+    delete items[i];
+  for (int i = 0; i < 10; i++)
+    items_again.push_back(new objectpool_item);
+  std::sort(items.begin(), items.end());
+  std::sort(items_again.begin(), items_again.end());
+  pool_ok = pool_ok && (std::unique(items.begin(), items.end()) == items.end()) &&
+    (items == items_again);
+
+  objectpool_derived* derived = new objectpool_derived;
+  pool_ok = pool_ok && !std::binary_search(items.begin(), items.end(),
+    (objectpool_item*)derived);
+  delete derived;
+  // a deleted derived object does not join the free blocks
+  for (int i = 0; i < 10; i++)
+    delete items_again[i];
+  for (int i = 0; i < 10; i++)
+  {
+    items_again[i] = new objectpool_item;
+    pool_ok = pool_ok && (items_again[i] != derived);
+  }
+  for (int i = 0; i < 10; i++)
+    delete items_again[i];
+
+  object_pool block_pool(24, 4);
+#if defined(_WINDOWS_)
+  HANDLE thread = (HANDLE)::_beginthreadex(NULL, 0, testcase_objectpool_thread, &block_pool, 0, NULL);
+  ::WaitForSingleObject(thread, INFINITE);
+  ::CloseHandle(thread);
+#elif defined(_MAC_) || defined(__linux__)
+  pthread_t thread;
+  ::pthread_create(&thread, NULL, testcase_objectpool_thread, &block_pool);
+  ::pthread_join(thread, NULL);
+#endif
+  std::sort(objectpool_blocks.begin(), objectpool_blocks.end());
+  int reused = 0;
+  for (int i = 0; i < 128; i++)
+  {
+    void* block = block_pool.allocate(24);
+    if (std::binary_search(objectpool_blocks.begin(), objectpool_blocks.end(), block))
+      reused++;
+  }
+  pool_ok = pool_ok && (reused == 128);
+
+  TEST_RESULT(L"testcase_objectpool", pool_ok == 1, reused);
+}
+
+/*
+  Test publishing of objects
+
+  test case:
+    1. count references to a new config, then publish it
+    2. publish a task holding a config and a request with post data
+    3. attach a config, post data and an element to published objects
+    4. give a config to a pool, execute an empty task
+    5. add and release references to a published config on 2 threads
+
+  validate:
+    nothing is published until publish() is called, publishing reaches
+    everything attached before and after, the pool publishes its config
+    and the tasks it executes, the count is right on both sides of
+    publish()
+ */
+class config_probe:
+  public config_impl
+{
+public:
+  int published() const { return is_published(); }
+};
+class task_probe:
+  public task_impl
+{
+public:
+  int published() const { return is_published(); }
+};
+class postdata_probe:
+  public postdata_impl
+{
+public:
+  int published() const { return is_published(); }
+};
+class postdataelem_probe:
+  public postdataelem_impl
+{
+public:
+  int published() const { return is_published(); }
+};
+
+#if defined(_WINDOWS_)
+static unsigned __stdcall testcase_publish_thread(void* param)
+#elif defined(_MAC_) || defined(__linux__)
+static void* testcase_publish_thread(void* param)
+#endif
+{
+  config* cfg = (config*)param;
+  for (int i = 0; i < 100000; i++)
+  {
+    cfg->AddRef();
+    cfg->Release();
+  }
+  return 0;
+}
+void testcase_publish()
+{
+  TEST_ENTER(L"testcase_publish");
+
+  config_probe* cfg = new config_probe;
+  refptr<config> cfg_ref(cfg);
+  int publish_ok = !cfg->published() && (cfg->GetRefCt() == 1) &&
+    (cfg->AddRef() == 2) && (cfg->Release() == 1);
+
+  task_probe* tsk = new task_probe;
+  refptr<task> tsk_ref(tsk);
+  postdata_probe* data = new postdata_probe;
+  refptr<postdata> data_ref(data);
+  postdataelem_probe* elem = new postdataelem_probe;
+  data->add_elem(elem);
+  refptr<request> req = request::create_instance();
+  req->set_postdata(data);
+  tsk->append_request(req);
+  tsk->use_config(cfg);
+  publish_ok = publish_ok && !tsk->published() && !cfg->published() &&
+    !data->published() && !elem->published();
+  tsk->publish();
+  publish_ok = publish_ok && tsk->published() && cfg->published() &&
+    data->published() && elem->published();
+
+  config_probe* later_cfg = new config_probe;
+  tsk->use_config(later_cfg);
+  postdataelem_probe* later_elem = new postdataelem_probe;
+  data->add_elem(later_elem);
+  postdata_probe* later_data = new postdata_probe;
+  req->set_postdata(later_data);
+  publish_ok = publish_ok && later_cfg->published() && later_elem->published() &&
+    later_data->published();
+
+  refptr<pool> pool = pool::create_instance();
+  config_probe* pool_cfg = new config_probe;
+  pool->use_config(pool_cfg);
+  task_probe* empty_tsk = new task_probe;
+  refptr<task> empty_ref(empty_tsk);
+  pool->execute(empty_tsk);
+  publish_ok = publish_ok && pool_cfg->published() && empty_tsk->published();
+  while (pool->is_running_or_queued(empty_tsk))
+    _MSLEEP(20);
+
+#if defined(_WINDOWS_)
+  HANDLE threads[2];
+  for (int i = 0; i < 2; i++)
+    threads[i] = (HANDLE)::_beginthreadex(NULL, 0, testcase_publish_thread, cfg, 0, NULL);
+  ::WaitForMultipleObjects(2, threads, TRUE, INFINITE);
+  for (int i = 0; i < 2; i++)
+    ::CloseHandle(threads[i]);
+#elif defined(_MAC_) || defined(__linux__)
+  pthread_t threads[2];
+  for (int i = 0; i < 2; i++)
+    ::pthread_create(&threads[i], NULL, testcase_publish_thread, cfg);
+  for (int i = 0; i < 2; i++)
+    ::pthread_join(threads[i], NULL);
+#endif
+  // the task let go of it for |later_cfg|
+  publish_ok = publish_ok && (cfg->GetRefCt() == 1);
+
+  TEST_RESULT(L"testcase_publish", publish_ok == 1, publish_ok);
+}
+
+/*
+  Test request deadlines
+
+  test case:
+    1. request an unroutable address with a 1 second deadline, and
+       again with a 1 second connect timeout
+
+  validate:
+    both fail after about a second, with REQ_ERR_DEADLINE and
+    REQ_ERR_CONNECT_TIMEOUT
+ */
+static long long testcase_deadline_now_ms()
+{
+#if defined(_WINDOWS_)
+  return (long long)::GetTickCount();
+#elif defined(_MAC_) || defined(__linux__)
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (long long)now.tv_sec * 1000 + now.tv_usec / 1000;
+#endif
+}
+void testcase_deadline()
+{
+  TEST_ENTER(L"testcase_deadline");
+
+  refptr<pool> pool = pool::create_instance();
+  refptr<task> task = task::create_instance();
+  refptr<request> deadline_req = request::create_instance();
+  deadline_req->set_request_url(L"http://10.255.255.1/");
+  deadline_req->set_timeouts(1000, -1, -1);
+  task->append_request(deadline_req);
+  refptr<request> connect_req = request::create_instance();
+  connect_req->set_request_url(L"http://10.255.255.1/");
+  connect_req->set_timeouts(-1, 1000, -1);
+  task->append_request(connect_req);
+
+  long long time_begin = testcase_deadline_now_ms();
+  pool->execute(task);
+  while (pool->is_running_or_queued(task))
+    _MSLEEP(20);
+  int elapsed = (int)(testcase_deadline_now_ms() - time_begin);
+  wprintf(L"errors: %d %d after %d ms\n", deadline_req->get_request_error(),
+    connect_req->get_request_error(), elapsed);
+
+  TEST_RESULT(L"testcase_deadline", deadline_req->get_request_error() == REQ_ERR_DEADLINE,
+    deadline_req->get_request_error());
+  TEST_RESULT(L"testcase_deadline", connect_req->get_request_error() == REQ_ERR_CONNECT_TIMEOUT,
+    connect_req->get_request_error());
+  TEST_RESULT(L"testcase_deadline", elapsed >= 900 && elapsed < 3000, elapsed);
+}
+
+/*
+  Test hedged GETs
+
+  test case:
+    1. GET a body whose first half comes after 1 s and the rest 3 s
+       later, hedged after 500 ms to a mirror that sends all of it
+       after 1.5 s
+
+  validate:
+    the hedge wins after the request streamed the first half, on_data
+    gets each byte of the body once and in order
+ */
+static std::string hedge_body;
+static int hedge_offsets_ok = 1;
+static void SINET_CALLBACK testcase_hedge_data(void* user, int request_id, size_t offset,
+                                               const void* data, size_t size)
+{
+  if (offset != hedge_body.size())
+    hedge_offsets_ok = 0;
+  hedge_body.append((const char*)data, size);
+}
+void testcase_hedge()
+{
+  TEST_ENTER(L"testcase_hedge");
+
+  refptr<pool> pool = pool::create_instance();
+  refptr<task> task = task::create_instance();
+  refptr<request> req = request::create_instance();
+  req->set_request_url(L"http://webpj.com:8080/misc/test_sinet.php?act=slowbody&first=1000&rest=3000");
+  req->set_request_method(REQ_GET);
+  req->set_hedge_policy(0, 500);
+  std::vector<std::string> mirrors;
+  mirrors.push_back("http://webpj.com:8080/misc/test_sinet.php?act=slowbody&first=1500&rest=0");
+  req->set_mirrors(mirrors);
+  task->append_request(req);
+  task_callbacks callbacks;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.on_data = testcase_hedge_data;
+  task->set_callbacks(callbacks);
+
+  time_t time_begin = time(NULL);
+  pool->execute(task);
+  while (pool->is_running_or_queued(task))
+    _MSLEEP(50);
+  int elapsed = (int)(time(NULL) - time_begin);
+
+  std::string expected;
+  for (int i = 0; i < 100; i++)
+    expected.append("0123456789");
+  int hedge_ok = hedge_offsets_ok && (hedge_body == expected) &&
+    (req->get_request_error() == REQ_ERR_NONE) && (elapsed < 4);
+
+  TEST_RESULT(L"testcase_hedge", hedge_ok == 1, hedge_ok);
+}
+
+/*
+  Test coalesced GETs
+
+  test case:
+    1. run a task with two identical GETs on a pool with
+       CFG_INT_COALESCE_GETS set, and on a pool with the default config
+
+  validate:
+    both requests get the response, the first pool makes one transfer
+    for them and the second one two
+ */
+void testcase_coalesce()
+{
+  TEST_ENTER(L"testcase_coalesce");
+
+  refptr<pool> pools[2];
+  refptr<task> tasks[2];
+  for (int i = 0; i < 2; i++)
+  {
+    pools[i] = pool::create_instance();
+    tasks[i] = task::create_instance();
+    for (int j = 0; j < 2; j++)
+    {
+      refptr<request> req = request::create_instance();
+      req->set_request_url(L"http://webpj.com:8080/misc/test_sinet.php?act=sleep");
+      req->set_request_method(REQ_GET);
+      tasks[i]->append_request(req);
+    }
+  }
+  refptr<config> cfg = config::create_instance();
+  cfg->set_intvar(CFG_INT_COALESCE_GETS, 1);
+  pools[0]->use_config(cfg);
+  pools[0]->execute(tasks[0]);
+  pools[1]->execute(tasks[1]);
+  while (pools[0]->is_running_or_queued(tasks[0]) || pools[1]->is_running_or_queued(tasks[1]))
+    _MSLEEP(50);
+  // counters are published after each pass of the pool thread
+  _MSLEEP(200);
+
+  int coalesce_ok = 1;
+  for (int i = 0; i < 2; i++)
+  {
+    std::vector<int> ids;
+    tasks[i]->get_request_ids(ids);
+    for (std::vector<int>::iterator it = ids.begin(); it != ids.end(); it++)
+    {
+      refptr<request> req = tasks[i]->get_request(*it);
+      si_buffer buffer = req->get_response_buffer();
+      coalesce_ok = coalesce_ok && (req->get_request_error() == REQ_ERR_NONE) &&
+        (buffer.size() == 5) && (memcmp(&buffer[0], "slept", 5) == 0);
+    }
+  }
+  pool_stats stats[2];
+  pools[0]->get_stats(stats[0]);
+  pools[1]->get_stats(stats[1]);
+  wprintf(L"transfers: %d coalesced, %d by default\n", (int)stats[0].transfers,
+    (int)stats[1].transfers);
+
+  TEST_RESULT(L"testcase_coalesce", coalesce_ok == 1, coalesce_ok);
+  TEST_RESULT(L"testcase_coalesce", stats[0].transfers == 1 && stats[1].transfers == 2,
+    (int)stats[0].transfers);
+}
+
+/*
+  Test bodies reported from out files
+
+  test case:
+    1. run two identical GETs on a pool with CFG_INT_COALESCE_GETS set,
+       the first into a buffer, the second into a file
+
+  validate:
+    one transfer serves both, on_data gets the whole body of the file
+    request from offset 0, and the file holds it
+ */
+static std::string outfile_data[2];
+static int outfile_first_id = 0;
+static void SINET_CALLBACK testcase_outfiledata_data(void* user, int request_id,
+                                                     size_t offset, const void* data,
+                                                     size_t size)
+{
+  std::string& body = outfile_data[request_id == outfile_first_id ? 0 : 1];
+  if (offset == body.size())
+    body.append((const char*)data, size);
+}
+void testcase_outfiledata()
+{
+  TEST_ENTER(L"testcase_outfiledata");
+
+  refptr<pool> pool = pool::create_instance();
+  refptr<task> task = task::create_instance();
+  refptr<request> reqs[2];
+  for (int i = 0; i < 2; i++)
+  {
+    reqs[i] = request::create_instance();
+    reqs[i]->set_request_url(L"http://webpj.com:8080/misc/test_sinet.php?act=sleep");
+    reqs[i]->set_request_method(REQ_GET);
+  }
+  SINET_APPPATH(std::wstring file);
+#ifdef WIN32
+  std::wstring filepath = file + L"\\outfiledata.txt";
+#else
+  std::wstring filepath = file + L"/outfiledata.txt";
+#endif
+  reqs[1]->set_request_outmode(REQ_OUTFILE);
+  reqs[1]->set_outfile(filepath.c_str());
+  task->append_request(reqs[0]);
+  task->append_request(reqs[1]);
+  std::vector<int> ids;
+  task->get_request_ids(ids);
+  outfile_first_id = (task->get_request(ids[0]) == reqs[0]) ? ids[0] : ids[1];
+  task_callbacks callbacks;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.on_data = testcase_outfiledata_data;
+  task->set_callbacks(callbacks);
+
+  refptr<config> cfg = config::create_instance();
+  cfg->set_intvar(CFG_INT_COALESCE_GETS, 1);
+  pool->use_config(cfg);
+  pool->execute(task);
+  while (pool->is_running_or_queued(task))
+    _MSLEEP(50);
+  // counters are published after each pass of the pool thread
+  _MSLEEP(200);
+  pool_stats stats;
+  pool->get_stats(stats);
+
+  std::ifstream fs;
+#ifdef _MAC_
+  fs.open(Utf8(filepath.c_str()), std::ios::binary|std::ios::in);
+#elif WIN32
+  fs.open(filepath.c_str(), std::ios::binary|std::ios::in);
+#elif __linux__
+  fs.open((wchar_utf8(filepath)).c_str(), std::ios::binary|std::ios::in);
+#endif
+  std::string written;
+  std::getline(fs, written);
+  fs.close();
+
+  int outfile_ok = (stats.transfers == 1) && (outfile_data[0] == "slept") &&
+    (outfile_data[1] == "slept") && (written == "slept") &&
+    (reqs[1]->get_request_error() == REQ_ERR_NONE);
+
+  TEST_RESULT(L"testcase_outfiledata", outfile_ok == 1, outfile_ok);
+}
+
+/*
+  Test request timing
+
+  test case:
+    1. run a GET, then a second task with a GET to the same origin on
+       the same pool
+
+  validate:
+    both requests have a timing record: started after they were
+    queued, the phases that happened end in order and within the
+    total, no redirect and the address of the server. The first
+    request opened its connection, the second one reused it.
+ */
+// @returns 1 if |timing| is that of a completed attempt
+static int testcase_timing_phases(const request_timing& timing)
+{
+  long long phases[] = {timing.namelookup, timing.connect, timing.appconnect,
+    timing.pretransfer, timing.starttransfer, timing.total};
+  int phases_ok = (timing.queued_ms > 0) && (timing.started_ms >= timing.queued_ms) &&
+    (timing.starttransfer > 0) && (timing.redirects == 0) &&
+    (timing.primary_ip[0] != '\0');
+  long long last_end = 0;
+  for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++)
+  {
+    // a phase that did not happen is 0
+    if (phases[i] == 0)
+      continue;
+    phases_ok = phases_ok && (phases[i] >= last_end);
+    last_end = phases[i];
+  }
+  return phases_ok && (last_end == timing.total);
+}
+void testcase_timing()
+{
+  TEST_ENTER(L"testcase_timing");
+
+  refptr<pool> pool = pool::create_instance();
+  request_timing timings[2];
+  for (int i = 0; i < 2; i++)
+  {
+    refptr<task> task = task::create_instance();
+    refptr<request> req = request::create_instance();
+    req->set_request_url(L"http://webpj.com:8080/misc/test_sinet.php?act=get");
+    req->set_request_method(REQ_GET);
+    task->append_request(req);
+    pool->execute(task);
+    while (pool->is_running_or_queued(task))
+      _MSLEEP(50);
+    req->get_timing(timings[i]);
+  }
+  wprintf(L"timing: %lld us, then %lld us on a reused connection\n",
+    timings[0].total, timings[1].total);
+
+  int timing_ok = testcase_timing_phases(timings[0]) && testcase_timing_phases(timings[1]) &&
+    (timings[0].reused == 0) && (timings[1].reused == 1);
+
+  TEST_RESULT(L"testcase_timing", timing_ok == 1, timing_ok);
+}
+
 clock_t last_clock;
 int testcase_canceldownload_feed(refptr<task> task, refptr<request> req)
 {
@@ -240,6 +1391,70 @@ void testcase_httpget(refptr<pool> pool, refptr<task> task, refptr<request> req,
   TEST_RESULT(L"testcase_httpget", (cmpval == 0), cmpval);
 }
 
+/*
+  Test pool connection limits
+
+  test case:
+    1. limit the pool to 2 connections per host
+    2. run a task with 5 requests to the same host, each answered
+       after a second
+    3. sample the pool statistics while the task runs
+
+  validate:
+    all requests complete without a transport error, no more than 2
+    transfers run at once and the others wait their turn, so the task
+    takes 3 rounds
+ */
+void testcase_poollimits()
+{
+  TEST_ENTER(L"testcase_poollimits");
+
+  refptr<pool> pool = pool::create_instance();
+  refptr<config> cfg = config::create_instance();
+  cfg->set_intvar(CFG_INT_MAX_HOST_CONNECTIONS, 2);
+  pool->use_config(cfg);
+
+  refptr<task> task = task::create_instance();
+  for (int i = 0; i < 5; i++)
+  {
+    // distinct urls, identical GETs would share one transfer
+    char request_url[128];
+    sprintf(request_url, "http://webpj.com:8080/misc/test_sinet.php?act=sleep&n=%d", i);
+    refptr<request> req = request::create_instance();
+    req->set_request_url_utf8(request_url);
+    req->set_request_method(REQ_GET);
+    task->append_request(req);
+  }
+  time_t time_begin = time(NULL);
+  pool->execute(task);
+  int peak_active = 0, peak_waiting = 0;
+  while (pool->is_running_or_queued(task))
+  {
+    pool_stats stats;
+    pool->get_stats(stats);
+    peak_active = stats.transfers_active > peak_active ? stats.transfers_active : peak_active;
+    peak_waiting = stats.transfers_waiting > peak_waiting ? stats.transfers_waiting : peak_waiting;
+    _MSLEEP(50);
+  }
+  int elapsed = (int)(time(NULL) - time_begin);
+
+  int completed = 0;
+  std::vector<int> ids;
+  task->get_request_ids(ids);
+  for (std::vector<int>::iterator it = ids.begin(); it != ids.end(); it++)
+  {
+    refptr<request> req = task->get_request(*it);
+    if (req->get_request_error() == REQ_ERR_NONE && req->get_response_errcode() == 0)
+      completed++;
+  }
+  wprintf(L"completed: %d, peak transfers: %d, peak waiting: %d, %d s\n",
+    completed, peak_active, peak_waiting, elapsed);
+
+  TEST_RESULT(L"testcase_poollimits", completed == 5, completed);
+  TEST_RESULT(L"testcase_poollimits", peak_active == 2, peak_active);
+  TEST_RESULT(L"testcase_poollimits", peak_waiting > 0 && elapsed >= 2, elapsed);
+}
+
 /*
   Test HTTP POST method
 
@@ -449,9 +1664,33 @@ int main(int argc, char* argv[])
   header[L"Accept"] = L"text/html";
   testcase_httpheader(pool, task, req7, header);
 
+  // test connection limits
+  testcase_poollimits();
+
+  // test hedged and coalesced requests
+  testcase_hedge();
+  testcase_coalesce();
+  testcase_outfiledata();
+  testcase_timing();
+
   // test create pool
   testcase_poolcreation();
 
+  // test and time string conversion
+  testcase_strings();
+  testcase_urls();
+  testcase_bufferlease();
+  testcase_taskcallbacks();
+  testcase_poolstats();
+  testcase_tracedump();
+  testcase_retrydelay();
+  testcase_tokenbucket();
+  testcase_httpcache();
+  testcase_diskcache();
+  testcase_objectpool();
+  testcase_publish();
+  testcase_deadline();
+
   // test cancel download
   refptr<request> req0 = request::create_instance();
   //req0->set_request_url(L"http://dl.baofeng.com/storm3/Storm2012-3.10.09.05.exe");
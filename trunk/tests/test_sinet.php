@@ -53,6 +53,27 @@
             for ($i=1;$i<11;$i++)
                 echo $i.' - test测试123<br/>';
         }
+        else if ($_REQUEST['act'] == 'sleep')
+        {
+            // a slow response, for tests that need transfers to overlap
+            sleep(isset($_REQUEST['secs']) ? intval($_REQUEST['secs']) : 1);
+            header('Content-type: text/html; charset=utf-8');
+            echo 'slept';
+        }
+        else if ($_REQUEST['act'] == 'slowbody')
+        {
+            // a 1000 byte body, the first half after |first| ms and the
+            // rest after another |rest| ms
+            $body = str_repeat('0123456789', 100);
+            usleep(intval($_REQUEST['first']) * 1000);
+            header('Content-type: text/html; charset=utf-8');
+            header('Content-Length: '.strlen($body));
+            echo substr($body, 0, 500);
+            @ob_flush();
+            flush();
+            usleep(intval($_REQUEST['rest']) * 1000);
+            echo substr($body, 500);
+        }
         else if ($_REQUEST['act'] == 'file')
         {
             if ($_FILES[$filename]['size'] && $_FILES[$filename]['size'] == filesize($file2))